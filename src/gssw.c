@@ -37,12 +37,16 @@
  */
 
 #include <emmintrin.h>
+#include <immintrin.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
 #include <inttypes.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "gssw.h"
 
 #ifdef __GNUC__
@@ -53,6 +57,15 @@
 #define UNLIKELY(x) (x)
 #endif
 
+/* Wider kernels are compiled through function target attributes and picked at runtime,
+   so they need a compiler which understands those (GCC >= 4.9, clang). */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GSSW_HAVE_AVX2
+#if defined(__clang__) || __GNUC__ >= 5
+#define GSSW_HAVE_AVX512
+#endif
+#endif
+
 /* Convert the coordinate in the scoring matrix into the coordinate in one line of the band. */
 #define set_u(u, w, i, j) { int x=(i)-(w); x=x>0?x:0; (u)=(j)-x+1; }
 
@@ -67,34 +80,6 @@
 #define kroundup32(x) (--(x), (x)|=(x)>>1, (x)|=(x)>>2, (x)|=(x)>>4, (x)|=(x)>>8, (x)|=(x)>>16, ++(x))
 
 
-/* Generate query profile rearrange query sequence & calculate the weight of match/mismatch. */
-__m128i* gssw_qP_byte (const int8_t* read_num,
-                       const int8_t* mat,
-                       const int32_t readLen,
-                       const int32_t n,	/* the edge length of the squre matrix mat */
-                       uint8_t bias) {
-
-	int32_t segLen = (readLen + 15) / 16; /* Split the 128 bit register into 16 pieces.
-								     Each piece is 8 bit. Split the read into 16 segments.
-								     Calculat 16 segments in parallel.
-								   */
-	__m128i* vProfile = (__m128i*)malloc(n * segLen * sizeof(__m128i));
-	int8_t* t = (int8_t*)vProfile;
-	int32_t nt, i, j, segNum;
-
-	/* Generate query profile rearrange query sequence & calculate the weight of match/mismatch */
-	for (nt = 0; LIKELY(nt < n); nt ++) {
-		for (i = 0; i < segLen; i ++) {
-			j = i;
-			for (segNum = 0; LIKELY(segNum < 16) ; segNum ++) {
-				*t++ = j>= readLen ? bias : mat[nt * n + read_num[j]] + bias;
-				j += segLen;
-			}
-		}
-	}
-	return vProfile;
-}
-
 /* To determine the maximum values within each vector, rather than between vectors. */
 
 #define m128i_max16(m, vm) \
@@ -102,7 +87,7 @@ __m128i* gssw_qP_byte (const int8_t* read_num,
     (vm) = _mm_max_epu8((vm), _mm_srli_si128((vm), 4)); \
     (vm) = _mm_max_epu8((vm), _mm_srli_si128((vm), 2)); \
     (vm) = _mm_max_epu8((vm), _mm_srli_si128((vm), 1)); \
-    (m) = _mm_extract_epi16((vm), 0)
+    (m) = _mm_extract_epi16((vm), 0) & 0xff
 
 #define m128i_max8(m, vm) \
     (vm) = _mm_max_epi16((vm), _mm_srli_si128((vm), 8)); \
@@ -110,502 +95,770 @@ __m128i* gssw_qP_byte (const int8_t* read_num,
     (vm) = _mm_max_epi16((vm), _mm_srli_si128((vm), 2)); \
     (m) = _mm_extract_epi16((vm), 0)
 
-/* Striped Smith-Waterman
-   Record the highest score of each reference position.
-   Return the alignment score and ending position of the best alignment, 2nd best alignment, etc.
-   Gap begin and gap extension are different.
-   wight_match > 0, all other weights < 0.
-   The returned positions are 0-based.
- */
-gssw_alignment_end* gssw_sw_sse2_byte (const int8_t* ref,
-                                       int8_t ref_dir,	// 0: forward ref; 1: reverse ref
-                                       int32_t refLen,
-                                       int32_t readLen,
-                                       const uint8_t weight_gapO, /* will be used as - */
-                                       const uint8_t weight_gapE, /* will be used as - */
-                                       __m128i* vProfile,
-                                       uint8_t terminate,	/* the best alignment score: used to terminate
-                                                               the matrix calculation when locating the
-                                                               alignment beginning point. If this score
-                                                               is set to 0, it will not be used */
-                                       uint8_t bias,  /* Shift 0 point to a positive value. */
-                                       int32_t maskLen,
-                                       gssw_align* alignment, /* to save seed and matrix */
-                                       const gssw_seed* seed) {     /* to seed the alignment */
-
-	uint8_t max = 0;		                     /* the max alignment score */
-	int32_t end_read = readLen - 1;
-	int32_t end_ref = -1; /* 0_based best alignment ending point; Initialized as isn't aligned -1. */
-	int32_t segLen = (readLen + 15) / 16; /* number of segment */
-
-    /* Initialize buffers used in alignment */
-	__m128i* pvHStore;
-    __m128i* pvHLoad;
-    __m128i* pvHmax;
-    __m128i* pvE;
-    uint8_t* mH; // used to save matrix for external traceback
-    /* Note use of aligned memory.  Return value of 0 means success for posix_memalign. */
-    if (!(!posix_memalign((void**)&pvHStore,     sizeof(__m128i), segLen*sizeof(__m128i)) &&
-          !posix_memalign((void**)&pvHLoad,      sizeof(__m128i), segLen*sizeof(__m128i)) &&
-          !posix_memalign((void**)&pvHmax,       sizeof(__m128i), segLen*sizeof(__m128i)) &&
-          !posix_memalign((void**)&pvE,          sizeof(__m128i), segLen*sizeof(__m128i)) &&
-          !posix_memalign((void**)&alignment->seed.pvE,      sizeof(__m128i), segLen*sizeof(__m128i)) &&
-          !posix_memalign((void**)&alignment->seed.pvHStore, sizeof(__m128i), segLen*sizeof(__m128i)) &&
-          !posix_memalign((void**)&mH,           sizeof(__m128i), segLen*refLen*sizeof(__m128i)))) {
-        fprintf(stderr, "error:[gssw] Could not allocate memory required for alignment buffers.\n");
-        exit(1);
-    }
-
-    /* Workaround because we don't have an aligned calloc */
-    memset(pvHStore,                 0, segLen*sizeof(__m128i));
-    memset(pvHLoad,                  0, segLen*sizeof(__m128i));
-    memset(pvHmax,                   0, segLen*sizeof(__m128i));
-    memset(pvE,                      0, segLen*sizeof(__m128i));
-    memset(alignment->seed.pvE,      0, segLen*sizeof(__m128i));
-    memset(alignment->seed.pvHStore, 0, segLen*sizeof(__m128i));
-    memset(mH,                       0, segLen*refLen*sizeof(__m128i));
-
-    /* if we are running a seeded alignment, copy over the seeds */
-    if (seed) {
-        memcpy(pvE, seed->pvE, segLen*sizeof(__m128i));
-        memcpy(pvHStore, seed->pvHStore, segLen*sizeof(__m128i));
+#define m128i_max4(m, vm) \
+    (vm) = _mm_max_epi32((vm), _mm_srli_si128((vm), 8)); \
+    (vm) = _mm_max_epi32((vm), _mm_srli_si128((vm), 4)); \
+    (m) = _mm_cvtsi128_si32(vm)
+
+/* posix_memalign wrapper for buffers which are released with free(); NULL if the memory cannot be had */
+static void* gssw_aligned_malloc(size_t size, size_t alignment) {
+    void* p = NULL;
+    return posix_memalign(&p, alignment, size) ? NULL : p;
+}
+
+/* cells of profile padding either side of the read in the linear profile of the banded fill, so that the band can
+   hang off the ends of the read without a bounds check per column */
+#define GSSW_BAND_PAD 64
+
+/* Arenas hand out memory from large chunks and take it all back at once.  Every chunk starts with a header linking it
+   to the chunk filled before it.  A reset with more than one chunk frees them all for a single chunk the size of what
+   was handed out since the previous reset, so an arena serving the same work over and over settles on one chunk, and
+   from then on resets in O(1) without calling its allocator. */
+struct gssw_arena {
+    char* chunk;	// current chunk, header included
+    size_t used;	// bytes of the current chunk taken, header included
+    size_t size;
+    size_t total;	// bytes handed out since the last reset, over all chunks
+    gssw_allocator allocator;
+};
+
+#define GSSW_ARENA_ALIGN 64	// widest vector, also the size of the chunk header
+#define GSSW_ARENA_CHUNK (1 << 16)
+
+static void* gssw_heap_alloc (size_t size, void* data) {
+    void* p = NULL;
+    return posix_memalign(&p, GSSW_ARENA_ALIGN, size) ? NULL : p;
+}
+
+static void gssw_heap_free (void* p, void* data) {
+    free(p);
+}
+
+static void gssw_arena_init (gssw_arena* a, const gssw_allocator* allocator) {
+    memset(a, 0, sizeof(gssw_arena));
+    if (allocator) {
+        a->allocator = *allocator;
+    } else {
+        a->allocator.alloc = gssw_heap_alloc;
+        a->allocator.free = gssw_heap_free;
     }
+}
 
-    /* Set external H matrix pointer */
-    alignment->mH = mH;
+/* 0, or -1 leaving a as it was if the allocator has no chunk of size bytes */
+static int32_t gssw_arena_new_chunk (gssw_arena* a, size_t size) {
+    char* c = (char*)a->allocator.alloc(size, a->allocator.data);
+    if (UNLIKELY(!c)) return -1;
+    *(char**)c = a->chunk;
+    a->chunk = c;
+    a->size = size;
+    a->used = GSSW_ARENA_ALIGN;
+    return 0;
+}
 
-    /* Record that we have done a byte-order alignment */
-    alignment->is_byte = 1;
+static void gssw_arena_free_chunks (gssw_arena* a) {
+    char* c = a->chunk;
+    while (c) {
+        char* prev = *(char**)c;
+        a->allocator.free(c, a->allocator.data);
+        c = prev;
+    }
+    a->chunk = NULL;
+    a->used = a->size = 0;
+}
 
-	/* Define 16 byte 0 vector. */
-	__m128i vZero = _mm_set1_epi32(0);
+gssw_arena* gssw_arena_create (const gssw_allocator* allocator) {
+    gssw_arena a;
+    gssw_arena* arena;
+    gssw_arena_init(&a, allocator);
+    arena = (gssw_arena*)a.allocator.alloc(sizeof(gssw_arena), a.allocator.data);
+    if (UNLIKELY(!arena)) return NULL;
+    *arena = a;
+    return arena;
+}
 
-    /* Used for iteration */
-	int32_t i, j;
+void* gssw_arena_alloc (gssw_arena* a, size_t size) {
+    void* p;
+    size = (size + GSSW_ARENA_ALIGN - 1) & ~(size_t)(GSSW_ARENA_ALIGN - 1);
+    if (UNLIKELY(a->used + size > a->size)) {
+        size_t s = 2 * a->size > GSSW_ARENA_ALIGN + size ? 2 * a->size : GSSW_ARENA_ALIGN + size;
+        if (UNLIKELY(gssw_arena_new_chunk(a, s < GSSW_ARENA_CHUNK ? GSSW_ARENA_CHUNK : s))) return NULL;
+    }
+    p = a->chunk + a->used;
+    a->used += size;
+    a->total += size;
+    return p;
+}
 
-    /* 16 byte insertion begin vector */
-	__m128i vGapO = _mm_set1_epi8(weight_gapO);
+/* memory from a, or from the heap without an arena, grown to size bytes keeping the first old_size; NULL, p being
+   left as it was, if there is none */
+static void* gssw_arena_realloc (gssw_arena* a, void* p, size_t old_size, size_t size) {
+    void* q;
+    if (!a) return realloc(p, size);
+    q = gssw_arena_alloc(a, size);
+    if (q && old_size) memcpy(q, p, old_size);
+    return q;
+}
 
-	/* 16 byte insertion extension vector */
-	__m128i vGapE = _mm_set1_epi8(weight_gapE);
+void gssw_arena_reset (gssw_arena* a) {
+    if (a->chunk && *(char**)a->chunk) {
+        size_t total = a->total;
+        gssw_arena_free_chunks(a);
+        gssw_arena_new_chunk(a, GSSW_ARENA_ALIGN + total);	// or none, for the next gssw_arena_alloc to try again
+    }
+    a->used = GSSW_ARENA_ALIGN;
+    a->total = 0;
+}
 
-	/* 16 byte bias vector */
-	__m128i vBias = _mm_set1_epi8(bias);
+void gssw_arena_destroy (gssw_arena* a) {
+    if (!a) return;
+    gssw_arena_free_chunks(a);
+    a->allocator.free(a, a->allocator.data);
+}
 
-	__m128i vMaxScore = vZero; /* Trace the highest score of the whole SW matrix. */
-	__m128i vMaxMark = vZero; /* Trace the highest score till the previous column. */
-	__m128i vTemp;
-	int32_t begin = 0, end = refLen, step = 1;
+/* Reusable memory for the fills (see gssw_workspace_create): a scratch block for the columns of the kernel running, and
+   an arena for what the fills leave behind (matrices, seeds, profiles) until the workspace is reset. */
+struct gssw_workspace {
+    gssw_arena arena;
+    void* scratch;
+    size_t scratch_size;
+    void* masks;	// buffer of gssw_graph_second_best
+    int32_t masks_cap;
+};
+
+/* aligned memory from the arena of ws, or from the heap (released with free) without one */
+static void* gssw_ws_alloc (gssw_workspace* ws, size_t size) {
+    if (!ws) return gssw_aligned_malloc(size, GSSW_ARENA_ALIGN);
+    return gssw_arena_alloc(&ws->arena, size);
+}
 
-	/* outer loop to process the reference sequence */
-	if (ref_dir == 1) {
-		begin = refLen - 1;
-		end = -1;
-		step = -1;
-	}
-	for (i = begin; LIKELY(i != end); i += step) {
-		int32_t cmp;
-		__m128i e = vZero, vF = vZero, vMaxColumn = vZero; /* Initialize F value to 0.
-							   Any errors to vH values will be corrected in the Lazy_F loop.
-							 */
-		//max16(maxColumn[i], vMaxColumn);
-		//fprintf(stderr, "middle[%d]: %d\n", i, maxColumn[i]);
-
-		//__m128i vH = pvHStore[segLen - 1];
-        __m128i vH = _mm_load_si128 (pvHStore + (segLen - 1));
-		vH = _mm_slli_si128 (vH, 1); /* Shift the 128-bit value in vH left by 1 byte. */
-		__m128i* vP = vProfile + ref[i] * segLen; /* Right part of the vProfile */
-
-		/* Swap the 2 H buffers. */
-		__m128i* pv = pvHLoad;
-		pvHLoad = pvHStore;
-		pvHStore = pv;
-
-		/* inner loop to process the query sequence */
-		for (j = 0; LIKELY(j < segLen); ++j) {
-
-			vH = _mm_adds_epu8(vH, _mm_load_si128(vP + j));
-			vH = _mm_subs_epu8(vH, vBias); /* vH will be always > 0 */
-	//	max16(maxColumn[i], vH);
-	//	fprintf(stderr, "H[%d]: %d\n", i, maxColumn[i]);
-            /*
-            int8_t* t;
-            int32_t ti;
-            fprintf(stdout, "%d\n", i);
-            for (t = (int8_t*)&vH, ti = 0; ti < 16; ++ti) fprintf(stdout, "%d\t", *t++);
-            fprintf(stdout, "\n");
-            */
-
-			/* Get max from vH, vE and vF. */
-			e = _mm_load_si128(pvE + j);
-			//_mm_store_si128(vE + j, e);
-
-			vH = _mm_max_epu8(vH, e);
-			vH = _mm_max_epu8(vH, vF);
-			vMaxColumn = _mm_max_epu8(vMaxColumn, vH);
-
-            // max16(maxColumn[i], vMaxColumn);
-            //fprintf(stdout, "middle[%d]: %d\n", i, maxColumn[i]);
-            //fprintf(stdout, "i=%d, j=%d\t", i, j);
-            //for (t = (int8_t*)&vMaxColumn, ti = 0; ti < 16; ++ti) fprintf(stdout, "%d\t", *t++);
-            //fprintf(stdout, "\n");
-
-			/* Save vH values. */
-			_mm_store_si128(pvHStore + j, vH);
-
-			/* Update vE value. */
-			vH = _mm_subs_epu8(vH, vGapO); /* saturation arithmetic, result >= 0 */
-			e = _mm_subs_epu8(e, vGapE);
-			e = _mm_max_epu8(e, vH);
-
-			/* Update vF value. */
-			vF = _mm_subs_epu8(vF, vGapE);
-			vF = _mm_max_epu8(vF, vH);
-
-            /* Save E */
-			_mm_store_si128(pvE + j, e);
-
-			/* Load the next vH. */
-			vH = _mm_load_si128(pvHLoad + j);
-		}
+/* column buffers of a kernel, valid until the next call */
+static void* gssw_ws_scratch (gssw_workspace* ws, size_t size) {
+    if (!ws) return gssw_aligned_malloc(size, GSSW_ARENA_ALIGN);
+    if (size > ws->scratch_size) {
+        free(ws->scratch);
+        ws->scratch = gssw_aligned_malloc(size, GSSW_ARENA_ALIGN);
+        ws->scratch_size = ws->scratch ? size : 0;
+    }
+    return ws->scratch;
+}
 
+/* hand back memory from gssw_ws_alloc or gssw_ws_scratch: only heap memory is freed, the workspace keeps its own */
+static void gssw_ws_free (gssw_workspace* ws, void* p) {
+    if (!ws) free(p);
+}
 
-		/* Lazy_F loop: has been revised to disallow adjecent insertion and then deletion, so don't update E(i, j), learn from SWPS3 */
-        /* reset pointers to the start of the saved data */
-        j = 0;
-        vH = _mm_load_si128 (pvHStore + j);
-
-        /*  the computed vF value is for the given column.  since */
-        /*  we are at the end, we need to shift the vF value over */
-        /*  to the next column. */
-        vF = _mm_slli_si128 (vF, 1);
-
-        vTemp = _mm_subs_epu8 (vH, vGapO);
-		vTemp = _mm_subs_epu8 (vF, vTemp);
-		vTemp = _mm_cmpeq_epi8 (vTemp, vZero);
-		cmp  = _mm_movemask_epi8 (vTemp);
-        while (cmp != 0xffff)
-        {
-            vH = _mm_max_epu8 (vH, vF);
-			vMaxColumn = _mm_max_epu8(vMaxColumn, vH);
-            _mm_store_si128 (pvHStore + j, vH);
-
-            vF = _mm_subs_epu8 (vF, vGapE);
-
-            j++;
-            if (j >= segLen)
-            {
-                j = 0;
-                vF = _mm_slli_si128 (vF, 1);
-            }
+/* Matrices of fills without a workspace from gssw_map_threshold bytes on are mapped rather than taken from the heap:
+   anonymous memory with a transparent huge page hint, or a file in gssw_map_dir, unlinked at once, which the kernel can
+   write back and page out.  A mapping starts with a header holding its length.  Both settings are changed and read
+   under gssw_map_lock, so that fills on other threads see either the old backend or the new one. */
+static size_t gssw_map_threshold = 0; // 0: never
+static char* gssw_map_dir = NULL;
+static pthread_mutex_t gssw_map_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int32_t gssw_matrix_backend_set (size_t threshold, const char* dir) {
+    char* d = NULL;
+    int32_t r = 0;
+    if (dir) {
+        if (access(dir, W_OK)) {
+            threshold = 0;
+            r = -1;
+        } else {
+            d = strdup(dir);
+        }
+    }
+    pthread_mutex_lock(&gssw_map_lock);
+    free(gssw_map_dir);
+    gssw_map_dir = d;
+    gssw_map_threshold = threshold;
+    pthread_mutex_unlock(&gssw_map_lock);
+    return r;
+}
 
-            vH = _mm_load_si128 (pvHStore + j);
-            vTemp = _mm_subs_epu8 (vH, vGapO);
-            vTemp = _mm_subs_epu8 (vF, vTemp);
-            vTemp = _mm_cmpeq_epi8 (vTemp, vZero);
-            cmp  = _mm_movemask_epi8 (vTemp);
+/* a mapping of size bytes, of a file made from the template path (freed here) or anonymous if it is NULL */
+static void* gssw_map_alloc (size_t size, char* path) {
+    size_t length = GSSW_ARENA_ALIGN + size;
+    void* p = MAP_FAILED;
+    if (path) {
+        int fd = mkstemp(path);
+        if (fd >= 0) {
+            unlink(path);
+            if (!ftruncate(fd, length)) p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
         }
+        free(path);
+    } else {
+        p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+        if (p != MAP_FAILED) madvise(p, length, MADV_HUGEPAGE);
+#endif
+    }
+    if (p == MAP_FAILED) return NULL;
+    *(size_t*)p = length;
+    return (char*)p + GSSW_ARENA_ALIGN;
+}
+
+static void gssw_map_free (void* p) {
+    if (!p) return;
+    p = (char*)p - GSSW_ARENA_ALIGN;
+    munmap(p, *(size_t*)p);
+}
 
-		vMaxScore = _mm_max_epu8(vMaxScore, vMaxColumn);
-		vTemp = _mm_cmpeq_epi8(vMaxMark, vMaxScore);
-		cmp = _mm_movemask_epi8(vTemp);
-		if (cmp != 0xffff) {
-			uint8_t temp;
-			vMaxMark = vMaxScore;
-			m128i_max16(temp, vMaxScore);
-			vMaxScore = vMaxMark;
+/* a matrix of size bytes for alignment a: from the arena of ws, else mapped (setting a->in_mapping) or from the heap;
+   NULL if it cannot be had, for the fill to fail rather than the program */
+static void* gssw_matrix_alloc (gssw_workspace* ws, size_t size, gssw_align* a) {
+    void* p = NULL;
+    char* path = NULL;
+    int8_t map;
+    if (ws) return gssw_arena_alloc(&ws->arena, size);
+    pthread_mutex_lock(&gssw_map_lock);
+    map = gssw_map_threshold && size >= gssw_map_threshold;
+    if (map && gssw_map_dir) {
+        path = (char*)malloc(strlen(gssw_map_dir) + 16);
+        if (path) sprintf(path, "%s/gssw.XXXXXX", gssw_map_dir);
+        else map = -1;
+    }
+    pthread_mutex_unlock(&gssw_map_lock);
+    if (UNLIKELY(map < 0)) return NULL;
+    if (map) {
+        p = gssw_map_alloc(size, path);
+        a->in_mapping = p != NULL;
+        return p;
+    }
+    return posix_memalign(&p, GSSW_ARENA_ALIGN, size) ? NULL : p;
+}
+
+/* release a matrix of a fill without a workspace, mapped or not */
+static inline void gssw_matrix_free (void* p, uint8_t mapped) {
+    if (mapped) gssw_map_free(p);
+    else free(p);
+}
 
-			if (LIKELY(temp > max)) {
-				max = temp;
-				if (max + bias >= 255) break;	//overflow
-				end_ref = i;
+/* a seed of two vectors of bytes each, released with gssw_seed_destroy when taken from the heap; NULL if the arena of
+   ws has no room for it */
+static gssw_seed* gssw_seed_alloc (size_t bytes, gssw_workspace* ws) {
+    gssw_seed* seed;
+    if (!ws) {
+        seed = (gssw_seed*)calloc(1, sizeof(gssw_seed));
+    } else {
+        seed = (gssw_seed*)gssw_ws_alloc(ws, sizeof(gssw_seed));
+    }
+    if (UNLIKELY(!seed)) return NULL;
+    seed->pvE = gssw_ws_alloc(ws, bytes);
+    seed->pvHStore = gssw_ws_alloc(ws, bytes);
+    if (UNLIKELY(!seed->pvE || !seed->pvHStore)) {
+        if (!ws) gssw_seed_destroy(seed);
+        return NULL;
+    }
+    return seed;
+}
 
-				/* Store the column with the highest alignment score in order to trace the alignment ending position on read. */
-				for (j = 0; LIKELY(j < segLen); ++j) pvHmax[j] = pvHStore[j];
+gssw_workspace* gssw_workspace_create (void) {
+    gssw_workspace* ws = (gssw_workspace*)calloc(1, sizeof(gssw_workspace));
+    gssw_arena_init(&ws->arena, NULL);
+    return ws;
+}
 
-			}
-		}
+void gssw_workspace_reset (gssw_workspace* ws) {
+    gssw_arena_reset(&ws->arena);
+}
 
-        // save the current column
+void gssw_workspace_destroy (gssw_workspace* ws) {
+    if (!ws) return;
+    gssw_arena_free_chunks(&ws->arena);
+    free(ws->scratch);
+    free(ws->masks);
+    free(ws);
+}
 
-        //fprintf(stdout, "%i %i\n", i, j);
-        for (j = 0; LIKELY(j < segLen); ++j) {
-            uint8_t* t;
-            int32_t ti;
-            vH = pvHStore[j];
-            for (t = (uint8_t*)&vH, ti = 0; ti < 16; ++ti) {
-                //fprintf(stderr, "%d\t", *t);
-                ((uint8_t*)mH)[i*readLen + ti*segLen + j] = *t++;
-            }
-            //fprintf(stderr, "\n");
+/* 2nd best alignment as in SSW: the highest column maximum more than maskLen columns away from the best end */
+static void gssw_second_best (const uint32_t* max_column, int32_t refLen, int32_t end_ref, int32_t maskLen,
+                              gssw_alignment_end* bests) {
+    int32_t i;
+    bests[1].score = 0;
+    bests[1].ref = -1;
+    bests[1].read = -1; // not tracked
+    for (i = 0; i < refLen; ++i) {
+        if (i >= end_ref - maskLen && i <= end_ref + maskLen) continue;
+        if (max_column[i] > bests[1].score) {
+            bests[1].score = max_column[i];
+            bests[1].ref = i;
         }
+    }
+}
+
+/* What a fill runs with: the defaults of gssw_matrix_set, gssw_checkpoint_set and gssw_fcorr_set, read once per fill,
+   or the settings of a graph context (see gssw_graph_context_matrix_set), which start out as those. */
+typedef struct {
+    int8_t matrix;	// GSSW_MATRIX_*
+    int8_t fcorr;	// GSSW_FCORR_*
+    int32_t ckpt;	// reference positions between checkpoints
+} gssw_fill_settings;
+
+/* checkpoints of a fill under GSSW_MATRIX_CKPT (store_mH == 3), every k reference positions, of column bytes per
+   striped column; what a block is recomputed from is left to the caller of the kernel */
+static void gssw_ckpt_init (gssw_checkpoints* c, int32_t k, int32_t refLen, size_t column, gssw_workspace* ws) {
+    c->k = k;
+    c->count = (refLen + c->k - 1) / c->k;
+    c->len = refLen;
+    c->end = refLen;
+    c->pv = gssw_ws_alloc(ws, 2 * (size_t)c->count * column);
+}
 
+/* the H and E columns before reference position b*k */
+static inline void gssw_ckpt_put (gssw_checkpoints* c, int32_t b, const void* pvH, const void* pvE, size_t column) {
+    char* pv = (char*)c->pv + 2 * (size_t)b * column;
+    memcpy(pv, pvH, column);
+    memcpy(pv + column, pvE, column);
+}
 
-		/* Record the max score of current column. */
-		//max16(maxColumn[i], vMaxColumn);
-		//fprintf(stderr, "maxColumn[%d]: %d\n", i, maxColumn[i]);
-		//if (maxColumn[i] == terminate) break;
+#define GSSW_CAT3_(a, b, c) a##_##b##_##c
+#define GSSW_CAT3(a, b, c) GSSW_CAT3_(a, b, c)
+#define GSSW_FN(prefix, suffix) GSSW_CAT3(prefix, GSSW_ISA, suffix)
 
-	}
-        
-    //fprintf(stderr, "%p %p %p %p %p %p\n", *pmH, mH, pvHmax, pvE, pvHLoad, pvHStore);
-    // save the last vH
-    memcpy(alignment->seed.pvE,      pvE,      segLen*sizeof(__m128i));
-    memcpy(alignment->seed.pvHStore, pvHStore, segLen*sizeof(__m128i));
-
-	/* Trace the alignment ending position on read. */
-	uint8_t *t = (uint8_t*)pvHmax;
-	int32_t column_len = segLen * 16;
-	for (i = 0; LIKELY(i < column_len); ++i, ++t) {
-		int32_t temp;
-		if (*t == max) {
-			temp = i / 16 + i % 16 * segLen;
-			if (temp < end_read) end_read = temp;
-		}
-	}
+/* SSE4.1 kernels: 16 x uint8_t, 8 x int16_t or 4 x int32_t per vector */
 
-    //fprintf(stderr, "%p %p %p %p %p %p\n", *pmH, mH, pvHmax, pvE, pvHLoad, pvHStore);
+static inline uint8_t gssw_hmax8u_sse2(__m128i vm) {
+    uint8_t m;
+    m128i_max16(m, vm);
+    return m;
+}
 
-	free(pvE);
-	free(pvHmax);
-	free(pvHLoad);
-    free(pvHStore);
+static inline uint16_t gssw_hmax16_sse2(__m128i vm) {
+    uint16_t m;
+    m128i_max8(m, vm);
+    return m;
+}
 
-	/* Find the most possible 2nd best alignment. */
-	gssw_alignment_end* bests = (gssw_alignment_end*) calloc(2, sizeof(gssw_alignment_end));
-	bests[0].score = max + bias >= 255 ? 255 : max;
-	bests[0].ref = end_ref;
-	bests[0].read = end_read;
+static inline int32_t gssw_hmax32_sse2(__m128i vm) {
+    int32_t m;
+    m128i_max4(m, vm);
+    return m;
+}
 
+/* shift left by n bytes, n a power of 2 below the vector size; constant after unrolling, so the switch folds away */
+static inline __m128i gssw_shl_sse2(__m128i v, int32_t n) {
+    switch (n) {
+    case 1: return _mm_slli_si128(v, 1);
+    case 2: return _mm_slli_si128(v, 2);
+    case 4: return _mm_slli_si128(v, 4);
+    default: return _mm_slli_si128(v, 8);
+    }
+}
 
-	return bests;
+#define GSSW_ISA sse2
+#define GSSW_TARGET
+#define GSSW_VSIZE 16
+#define gssw_v __m128i
+#define vzero() _mm_setzero_si128()
+#define vset8(x) _mm_set1_epi8(x)
+#define vset16(x) _mm_set1_epi16(x)
+#define vset32(x) _mm_set1_epi32(x)
+#define vload(p) _mm_load_si128(p)
+#define vloadu(p) _mm_loadu_si128(p)
+#define vstore(p, v) _mm_store_si128((p), (v))
+#define vadds8u(a, b) _mm_adds_epu8((a), (b))
+#define vsubs8u(a, b) _mm_subs_epu8((a), (b))
+#define vmax8u(a, b) _mm_max_epu8((a), (b))
+#define vadds16(a, b) _mm_adds_epi16((a), (b))
+#define vsubs16u(a, b) _mm_subs_epu16((a), (b))
+#define vmax16(a, b) _mm_max_epi16((a), (b))
+#define vmax16u(a, b) _mm_max_epu16((a), (b))
+#define vadd32(a, b) _mm_add_epi32((a), (b))
+#define vadd8(a, b) _mm_add_epi8((a), (b)) // wrapping, for the packed H deltas
+#define vadd16(a, b) _mm_add_epi16((a), (b))
+#define vsub8(a, b) _mm_sub_epi8((a), (b))
+#define vsub16(a, b) _mm_sub_epi16((a), (b))
+#define vsub32(a, b) _mm_sub_epi32((a), (b))
+#define vsll16(v, n) _mm_sll_epi16((v), _mm_cvtsi32_si128(n)) // bit shifts within every lane
+#define vsrl16(v, n) _mm_srl_epi16((v), _mm_cvtsi32_si128(n))
+#define vsll32(v, n) _mm_sll_epi32((v), _mm_cvtsi32_si128(n))
+#define vsrl32(v, n) _mm_srl_epi32((v), _mm_cvtsi32_si128(n))
+#define vsubs32u(a, b) _mm_max_epi32(_mm_sub_epi32((a), (b)), _mm_setzero_si128()) // no saturating form, clamp at 0
+#define vmax32(a, b) _mm_max_epi32((a), (b))
+#define vand(a, b) _mm_and_si128((a), (b))
+#define vor(a, b) _mm_or_si128((a), (b))
+#define vxor(a, b) _mm_xor_si128((a), (b))
+#define vandnot(a, b) _mm_andnot_si128((a), (b)) // ~a & b
+#define vcmpeq8(a, b) _mm_cmpeq_epi8((a), (b))
+#define vcmpeq16(a, b) _mm_cmpeq_epi16((a), (b))
+#define vcmpeq32(a, b) _mm_cmpeq_epi32((a), (b))
+#define vcmpgt16(a, b) _mm_cmpgt_epi16((a), (b))
+#define vcmpgt32(a, b) _mm_cmpgt_epi32((a), (b))
+#define vmovemask(v) ((uint64_t)(uint32_t)_mm_movemask_epi8(v)) // top bit of every byte
+#define vshl8(v) _mm_slli_si128((v), 1)
+#define vshl16(v) _mm_slli_si128((v), 2)
+#define vshl32(v) _mm_slli_si128((v), 4)
+#define vshl16c(v, c) _mm_alignr_epi8((v), (c), 14) // shift in the top lane of c
+#define vshlb(v, n) gssw_shl_sse2((v), (n))
+#define vequal(a, b) (_mm_movemask_epi8(_mm_cmpeq_epi8((a), (b))) == 0xffff)
+#define vanygt8u(a, b) (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_subs_epu8((a), (b)), _mm_setzero_si128())) != 0xffff)
+#define vanygt16(a, b) (_mm_movemask_epi8(_mm_cmpgt_epi16((a), (b))) != 0)
+#define vanygt32(a, b) (_mm_movemask_epi8(_mm_cmpgt_epi32((a), (b))) != 0)
+#define vhmax8u(v) gssw_hmax8u_sse2(v)
+#define vhmax16(v) gssw_hmax16_sse2(v)
+#define vhmax32(v) gssw_hmax32_sse2(v)
+#include "gssw_kernel.h"
+
+#ifdef GSSW_HAVE_AVX2
+
+/* AVX2 kernels: 32 x uint8_t, 16 x int16_t or 8 x int32_t per vector.  Built with a target attribute so that
+   the library itself only requires SSE4.1, and selected at runtime by gssw_simd_get(). */
+
+#define GSSW_TARGET_AVX2 __attribute__((target("avx2")))
+
+GSSW_TARGET_AVX2
+static inline uint8_t gssw_hmax8u_avx2(__m256i v) {
+    uint8_t m;
+    __m128i vm = _mm_max_epu8(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    m128i_max16(m, vm);
+    return m;
 }
 
-__m128i* gssw_qP_word (const int8_t* read_num,
-				  const int8_t* mat,
-				  const int32_t readLen,
-				  const int32_t n) {
+GSSW_TARGET_AVX2
+static inline uint16_t gssw_hmax16_avx2(__m256i v) {
+    uint16_t m;
+    __m128i vm = _mm_max_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    m128i_max8(m, vm);
+    return m;
+}
 
-	int32_t segLen = (readLen + 7) / 8;
-	__m128i* vProfile = (__m128i*)malloc(n * segLen * sizeof(__m128i));
-	int16_t* t = (int16_t*)vProfile;
-	int32_t nt, i, j;
-	int32_t segNum;
+GSSW_TARGET_AVX2
+static inline int32_t gssw_hmax32_avx2(__m256i v) {
+    int32_t m;
+    __m128i vm = _mm_max_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    m128i_max4(m, vm);
+    return m;
+}
 
-	/* Generate query profile rearrange query sequence & calculate the weight of match/mismatch */
-	for (nt = 0; LIKELY(nt < n); nt ++) {
-		for (i = 0; i < segLen; i ++) {
-			j = i;
-			for (segNum = 0; LIKELY(segNum < 8) ; segNum ++) {
-				*t++ = j>= readLen ? 0 : mat[nt * n + read_num[j]];
-				j += segLen;
-			}
-		}
-	}
-	return vProfile;
+GSSW_TARGET_AVX2
+static inline __m256i gssw_shl_avx2(__m256i v, int32_t n) {
+    __m256i c = _mm256_permute2x128_si256(v, v, 0x08); // low lane moved up, zero below
+    switch (n) {
+    case 1: return _mm256_alignr_epi8(v, c, 15);
+    case 2: return _mm256_alignr_epi8(v, c, 14);
+    case 4: return _mm256_alignr_epi8(v, c, 12);
+    case 8: return _mm256_alignr_epi8(v, c, 8);
+    default: return c;
+    }
 }
 
-gssw_alignment_end* gssw_sw_sse2_word (const int8_t* ref,
-                                       int8_t ref_dir,	// 0: forward ref; 1: reverse ref
-                                       int32_t refLen,
-                                       int32_t readLen,
-                                       const uint8_t weight_gapO, /* will be used as - */
-                                       const uint8_t weight_gapE, /* will be used as - */
-                                       __m128i* vProfile,
-                                       uint16_t terminate,
-                                       int32_t maskLen,
-                                       gssw_align* alignment, /* to save seed and matrix */
-                                       const gssw_seed* seed) {     /* to seed the alignment */
-    
+/* _mm256_slli_si256 shifts within each 128-bit lane, so carry the top of the low lane over by hand */
+#define GSSW_ISA avx2
+#define GSSW_TARGET GSSW_TARGET_AVX2
+#define GSSW_VSIZE 32
+#define gssw_v __m256i
+#define vzero() _mm256_setzero_si256()
+#define vset8(x) _mm256_set1_epi8(x)
+#define vset16(x) _mm256_set1_epi16(x)
+#define vset32(x) _mm256_set1_epi32(x)
+#define vload(p) _mm256_load_si256(p)
+#define vloadu(p) _mm256_loadu_si256(p)
+#define vstore(p, v) _mm256_store_si256((p), (v))
+#define vadds8u(a, b) _mm256_adds_epu8((a), (b))
+#define vsubs8u(a, b) _mm256_subs_epu8((a), (b))
+#define vmax8u(a, b) _mm256_max_epu8((a), (b))
+#define vadds16(a, b) _mm256_adds_epi16((a), (b))
+#define vsubs16u(a, b) _mm256_subs_epu16((a), (b))
+#define vmax16(a, b) _mm256_max_epi16((a), (b))
+#define vmax16u(a, b) _mm256_max_epu16((a), (b))
+#define vadd32(a, b) _mm256_add_epi32((a), (b))
+#define vadd8(a, b) _mm256_add_epi8((a), (b))
+#define vadd16(a, b) _mm256_add_epi16((a), (b))
+#define vsub8(a, b) _mm256_sub_epi8((a), (b))
+#define vsub16(a, b) _mm256_sub_epi16((a), (b))
+#define vsub32(a, b) _mm256_sub_epi32((a), (b))
+#define vsll16(v, n) _mm256_sll_epi16((v), _mm_cvtsi32_si128(n))
+#define vsrl16(v, n) _mm256_srl_epi16((v), _mm_cvtsi32_si128(n))
+#define vsll32(v, n) _mm256_sll_epi32((v), _mm_cvtsi32_si128(n))
+#define vsrl32(v, n) _mm256_srl_epi32((v), _mm_cvtsi32_si128(n))
+#define vsubs32u(a, b) _mm256_max_epi32(_mm256_sub_epi32((a), (b)), _mm256_setzero_si256())
+#define vmax32(a, b) _mm256_max_epi32((a), (b))
+#define vand(a, b) _mm256_and_si256((a), (b))
+#define vor(a, b) _mm256_or_si256((a), (b))
+#define vxor(a, b) _mm256_xor_si256((a), (b))
+#define vandnot(a, b) _mm256_andnot_si256((a), (b))
+#define vcmpeq8(a, b) _mm256_cmpeq_epi8((a), (b))
+#define vcmpeq16(a, b) _mm256_cmpeq_epi16((a), (b))
+#define vcmpeq32(a, b) _mm256_cmpeq_epi32((a), (b))
+#define vcmpgt16(a, b) _mm256_cmpgt_epi16((a), (b))
+#define vcmpgt32(a, b) _mm256_cmpgt_epi32((a), (b))
+#define vmovemask(v) ((uint64_t)(uint32_t)_mm256_movemask_epi8(v))
+#define vshl8(v) _mm256_alignr_epi8((v), _mm256_permute2x128_si256((v), (v), 0x08), 15)
+#define vshl16(v) _mm256_alignr_epi8((v), _mm256_permute2x128_si256((v), (v), 0x08), 14)
+#define vshl32(v) _mm256_alignr_epi8((v), _mm256_permute2x128_si256((v), (v), 0x08), 12)
+#define vshl16c(v, c) _mm256_alignr_epi8((v), _mm256_permute2x128_si256((c), (v), 0x21), 14)
+#define vshlb(v, n) gssw_shl_avx2((v), (n))
+#define vequal(a, b) (_mm256_movemask_epi8(_mm256_cmpeq_epi8((a), (b))) == -1)
+#define vanygt8u(a, b) (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_subs_epu8((a), (b)), _mm256_setzero_si256())) != -1)
+#define vanygt16(a, b) (_mm256_movemask_epi8(_mm256_cmpgt_epi16((a), (b))) != 0)
+#define vanygt32(a, b) (_mm256_movemask_epi8(_mm256_cmpgt_epi32((a), (b))) != 0)
+#define vhmax8u(v) gssw_hmax8u_avx2(v)
+#define vhmax16(v) gssw_hmax16_avx2(v)
+#define vhmax32(v) gssw_hmax32_avx2(v)
+#include "gssw_kernel.h"
+
+#endif // GSSW_HAVE_AVX2
+
+#ifdef GSSW_HAVE_AVX512
+
+/* AVX-512BW kernels: 64 x uint8_t, 32 x int16_t or 16 x int32_t per vector.  Comparisons go straight to mask
+   registers, which replaces the movemask round trips of the Lazy-F and max tracking tests. */
+
+#define GSSW_TARGET_AVX512 __attribute__((target("avx512bw")))
+
+GSSW_TARGET_AVX512
+static inline uint8_t gssw_hmax8u_avx512(__m512i v) {
+    uint8_t m;
+    __m256i h = _mm256_max_epu8(_mm512_castsi512_si256(v), _mm512_extracti64x4_epi64(v, 1));
+    __m128i vm = _mm_max_epu8(_mm256_castsi256_si128(h), _mm256_extracti128_si256(h, 1));
+    m128i_max16(m, vm);
+    return m;
+}
 
-	uint16_t max = 0;		                     /* the max alignment score */
-	int32_t end_read = readLen - 1;
-	int32_t end_ref = 0; /* 1_based best alignment ending point; Initialized as isn't aligned - 0. */
-	int32_t segLen = (readLen + 7) / 8; /* number of segment */
-
-    /* Initialize buffers used in alignment */
-	__m128i* pvHStore;
-    __m128i* pvHLoad;
-    __m128i* pvHmax;
-    __m128i* pvE;
-    uint16_t* mH; // used to save matrix for external traceback
-    /* Note use of aligned memory */
-
-    if (!(!posix_memalign((void**)&pvHStore,     sizeof(__m128i), segLen*sizeof(__m128i)) &&
-          !posix_memalign((void**)&pvHLoad,      sizeof(__m128i), segLen*sizeof(__m128i)) &&
-          !posix_memalign((void**)&pvHmax,       sizeof(__m128i), segLen*sizeof(__m128i)) &&
-          !posix_memalign((void**)&pvE,          sizeof(__m128i), segLen*sizeof(__m128i)) &&
-          !posix_memalign((void**)&alignment->seed.pvE,      sizeof(__m128i), segLen*sizeof(__m128i)) &&
-          !posix_memalign((void**)&alignment->seed.pvHStore, sizeof(__m128i), segLen*sizeof(__m128i)) &&
-          !posix_memalign((void**)&mH,           sizeof(__m128i), segLen*refLen*sizeof(__m128i)))) {
-        fprintf(stderr, "error:[gssw] Could not allocate memory required for alignment buffers.\n");
-        exit(1);
-    }
-
-    /* Workaround because we don't have an aligned calloc */
-    memset(pvHStore,                 0, segLen*sizeof(__m128i));
-    memset(pvHLoad,                  0, segLen*sizeof(__m128i));
-    memset(pvHmax,                   0, segLen*sizeof(__m128i));
-    memset(pvE,                      0, segLen*sizeof(__m128i));
-    memset(alignment->seed.pvE,      0, segLen*sizeof(__m128i));
-    memset(alignment->seed.pvHStore, 0, segLen*sizeof(__m128i));
-    memset(mH,                       0, segLen*refLen*sizeof(__m128i));
-
-    /* if we are running a seeded alignment, copy over the seeds */
-    if (seed) {
-        memcpy(pvE, seed->pvE, segLen*sizeof(__m128i));
-        memcpy(pvHStore, seed->pvHStore, segLen*sizeof(__m128i));
+GSSW_TARGET_AVX512
+static inline uint16_t gssw_hmax16_avx512(__m512i v) {
+    uint16_t m;
+    __m256i h = _mm256_max_epi16(_mm512_castsi512_si256(v), _mm512_extracti64x4_epi64(v, 1));
+    __m128i vm = _mm_max_epi16(_mm256_castsi256_si128(h), _mm256_extracti128_si256(h, 1));
+    m128i_max8(m, vm);
+    return m;
+}
+
+GSSW_TARGET_AVX512
+static inline int32_t gssw_hmax32_avx512(__m512i v) {
+    int32_t m;
+    __m256i h = _mm256_max_epi32(_mm512_castsi512_si256(v), _mm512_extracti64x4_epi64(v, 1));
+    __m128i vm = _mm_max_epi32(_mm256_castsi256_si128(h), _mm256_extracti128_si256(h, 1));
+    m128i_max4(m, vm);
+    return m;
+}
+
+GSSW_TARGET_AVX512
+static inline __m512i gssw_shl_avx512(__m512i v, int32_t n) {
+    __m512i c = _mm512_alignr_epi64(v, _mm512_setzero_si512(), 6); // every 128-bit lane moved up one
+    switch (n) {
+    case 1: return _mm512_alignr_epi8(v, c, 15);
+    case 2: return _mm512_alignr_epi8(v, c, 14);
+    case 4: return _mm512_alignr_epi8(v, c, 12);
+    case 8: return _mm512_alignr_epi8(v, c, 8);
+    case 16: return c;
+    default: return _mm512_alignr_epi64(v, _mm512_setzero_si512(), 4);
     }
+}
 
-    /* Set external H matrix pointer */
-    alignment->mH = mH;
+/* byte shifts are per 128-bit lane here too: move every lane up by one with alignr_epi64 first */
+#define GSSW_ISA avx512
+#define GSSW_TARGET GSSW_TARGET_AVX512
+#define GSSW_VSIZE 64
+#define gssw_v __m512i
+#define vzero() _mm512_setzero_si512()
+#define vset8(x) _mm512_set1_epi8(x)
+#define vset16(x) _mm512_set1_epi16(x)
+#define vset32(x) _mm512_set1_epi32(x)
+#define vload(p) _mm512_load_si512(p)
+#define vloadu(p) _mm512_loadu_si512(p)
+#define vstore(p, v) _mm512_store_si512((p), (v))
+#define vadds8u(a, b) _mm512_adds_epu8((a), (b))
+#define vsubs8u(a, b) _mm512_subs_epu8((a), (b))
+#define vmax8u(a, b) _mm512_max_epu8((a), (b))
+#define vadds16(a, b) _mm512_adds_epi16((a), (b))
+#define vsubs16u(a, b) _mm512_subs_epu16((a), (b))
+#define vmax16(a, b) _mm512_max_epi16((a), (b))
+#define vmax16u(a, b) _mm512_max_epu16((a), (b))
+#define vadd32(a, b) _mm512_add_epi32((a), (b))
+#define vadd8(a, b) _mm512_add_epi8((a), (b))
+#define vadd16(a, b) _mm512_add_epi16((a), (b))
+#define vsub8(a, b) _mm512_sub_epi8((a), (b))
+#define vsub16(a, b) _mm512_sub_epi16((a), (b))
+#define vsub32(a, b) _mm512_sub_epi32((a), (b))
+#define vsll16(v, n) _mm512_sll_epi16((v), _mm_cvtsi32_si128(n))
+#define vsrl16(v, n) _mm512_srl_epi16((v), _mm_cvtsi32_si128(n))
+#define vsll32(v, n) _mm512_sll_epi32((v), _mm_cvtsi32_si128(n))
+#define vsrl32(v, n) _mm512_srl_epi32((v), _mm_cvtsi32_si128(n))
+#define vsubs32u(a, b) _mm512_max_epi32(_mm512_sub_epi32((a), (b)), _mm512_setzero_si512())
+#define vmax32(a, b) _mm512_max_epi32((a), (b))
+#define vand(a, b) _mm512_and_si512((a), (b))
+#define vor(a, b) _mm512_or_si512((a), (b))
+#define vxor(a, b) _mm512_xor_si512((a), (b))
+#define vandnot(a, b) _mm512_andnot_si512((a), (b))
+#define vcmpeq8(a, b) _mm512_maskz_set1_epi8(_mm512_cmpeq_epi8_mask((a), (b)), -1) // masks widened back to vectors
+#define vcmpeq16(a, b) _mm512_maskz_set1_epi16(_mm512_cmpeq_epi16_mask((a), (b)), -1)
+#define vcmpeq32(a, b) _mm512_maskz_set1_epi32(_mm512_cmpeq_epi32_mask((a), (b)), -1)
+#define vcmpgt16(a, b) _mm512_maskz_set1_epi16(_mm512_cmpgt_epi16_mask((a), (b)), -1)
+#define vcmpgt32(a, b) _mm512_maskz_set1_epi32(_mm512_cmpgt_epi32_mask((a), (b)), -1)
+#define vmovemask(v) ((uint64_t)_mm512_movepi8_mask(v))
+#define vshl8(v) _mm512_alignr_epi8((v), _mm512_alignr_epi64((v), _mm512_setzero_si512(), 6), 15)
+#define vshl16(v) _mm512_alignr_epi8((v), _mm512_alignr_epi64((v), _mm512_setzero_si512(), 6), 14)
+#define vshl32(v) _mm512_alignr_epi8((v), _mm512_alignr_epi64((v), _mm512_setzero_si512(), 6), 12)
+#define vshl16c(v, c) _mm512_alignr_epi8((v), _mm512_alignr_epi64((v), (c), 6), 14)
+#define vshlb(v, n) gssw_shl_avx512((v), (n))
+#define vequal(a, b) (_mm512_cmpneq_epi8_mask((a), (b)) == 0)
+#define vanygt8u(a, b) (_mm512_cmpgt_epu8_mask((a), (b)) != 0)
+#define vanygt16(a, b) (_mm512_cmpgt_epi16_mask((a), (b)) != 0)
+#define vanygt32(a, b) (_mm512_cmpgt_epi32_mask((a), (b)) != 0)
+#define vhmax8u(v) gssw_hmax8u_avx512(v)
+#define vhmax16(v) gssw_hmax16_avx512(v)
+#define vhmax32(v) gssw_hmax32_avx512(v)
+#include "gssw_kernel.h"
+
+#endif // GSSW_HAVE_AVX512
+
+/* Runtime dispatch: one entry per instruction set tier, indexed by GSSW_SIMD_* */
+
+typedef struct {
+    const char* name;
+    int32_t vsize; // bytes per vector, fixes the stripe layout of profiles and seeds
+    void* (*qP_byte) (const int8_t*, const int8_t*, const int32_t, const int32_t, uint8_t, gssw_workspace*);
+    void* (*qP_word) (const int8_t*, const int8_t*, const int32_t, const int32_t, gssw_workspace*);
+    void* (*qP_dword) (const int8_t*, const int8_t*, const int32_t, const int32_t, gssw_workspace*);
+    gssw_alignment_end* (*sw_byte) (const int8_t*, int8_t, int32_t, int32_t, const uint8_t, const uint8_t,
+                                    const void*, uint8_t, uint8_t, int32_t, int32_t, uint32_t, int8_t,
+                                    gssw_fill_settings, gssw_align*, const gssw_seed*, gssw_workspace*);
+    gssw_alignment_end* (*sw_word) (const int8_t*, int8_t, int32_t, int32_t, const uint8_t, const uint8_t,
+                                    const void*, uint16_t, int32_t, int32_t, uint32_t, int8_t,
+                                    gssw_fill_settings, gssw_align*, const gssw_seed*, gssw_workspace*);
+    gssw_alignment_end* (*sw_dword) (const int8_t*, int8_t, int32_t, int32_t, const uint8_t, const uint8_t,
+                                     const void*, uint32_t, int32_t, int32_t, uint32_t, int8_t,
+                                     gssw_fill_settings, gssw_align*, const gssw_seed*, gssw_workspace*);
+    gssw_seed* (*create_seed_byte) (int32_t, gssw_align**, int32_t, gssw_workspace*);
+    gssw_seed* (*create_seed_word) (int32_t, gssw_align**, int32_t, gssw_workspace*);
+    gssw_seed* (*create_seed_dword) (int32_t, gssw_align**, int32_t, gssw_workspace*);
+    void* (*qP_batch_byte) (const int8_t**, const int32_t*, const int32_t, const int32_t, const int8_t*, const int32_t,
+                            uint8_t);
+    void* (*qP_batch_word) (const int8_t**, const int32_t*, const int32_t, const int32_t, const int8_t*, const int32_t);
+    gssw_alignment_end* (*sw_batch_byte) (const int8_t*, int32_t, const int32_t*, const int32_t, const int32_t,
+                                          const uint8_t, const uint8_t, const void*, uint8_t, gssw_align*,
+                                          const gssw_seed*);
+    gssw_alignment_end* (*sw_batch_word) (const int8_t*, int32_t, const int32_t*, const int32_t, const int32_t,
+                                          const uint8_t, const uint8_t, const void*, gssw_align*, const gssw_seed*);
+    gssw_alignment_end* (*sw_band_word) (const int8_t*, int32_t, int32_t, const uint8_t, const uint8_t, const int16_t*,
+                                         int32_t, int32_t, gssw_align*, const gssw_seed*);
+} gssw_kernels;
+
+#define GSSW_KERNELS(isa, vsize) { #isa, vsize,                                 \
+            gssw_qP_##isa##_byte, gssw_qP_##isa##_word, gssw_qP_##isa##_dword,  \
+            gssw_sw_##isa##_byte, gssw_sw_##isa##_word, gssw_sw_##isa##_dword,  \
+            gssw_create_seed_##isa##_byte, gssw_create_seed_##isa##_word,       \
+            gssw_create_seed_##isa##_dword,                                     \
+            gssw_qP_batch_##isa##_byte, gssw_qP_batch_##isa##_word,             \
+            gssw_sw_batch_##isa##_byte, gssw_sw_batch_##isa##_word,             \
+            gssw_sw_band_##isa##_word }
+
+static const gssw_kernels gssw_kernel_table[] = {
+    { NULL }, // GSSW_SIMD_AUTO is resolved before lookup
+    GSSW_KERNELS(sse2, 16),
+#ifdef GSSW_HAVE_AVX2
+    GSSW_KERNELS(avx2, 32),
+#endif
+#ifdef GSSW_HAVE_AVX512
+    GSSW_KERNELS(avx512, 64),
+#endif
+};
+
+/* The settings below are process-wide defaults, stored and loaded atomically so that threads may change them while
+   others fill; a fill reads them once, when it starts (see gssw_fill_settings). */
+static int8_t gssw_simd_level = GSSW_SIMD_AUTO;
+static int8_t gssw_simd_best;	// what gssw_simd_detect found, once
+static pthread_once_t gssw_simd_once = PTHREAD_ONCE_INIT;
+
+/* best tier supported by both this build and the running CPU */
+static int8_t gssw_simd_detect (void) {
+#ifdef GSSW_HAVE_AVX2
+    __builtin_cpu_init();
+#ifdef GSSW_HAVE_AVX512
+    if (__builtin_cpu_supports("avx512bw")) return GSSW_SIMD_AVX512;
+#endif
+    if (__builtin_cpu_supports("avx2")) return GSSW_SIMD_AVX2;
+#endif
+    return GSSW_SIMD_SSE41;
+}
 
-    /* Record that we have done a word-order alignment */
-    alignment->is_byte = 0;
+static void gssw_simd_resolve (void) {
+    gssw_simd_best = gssw_simd_detect();
+}
 
-	/* Define 16 byte 0 vector. */
-	__m128i vZero = _mm_set1_epi32(0);
+static inline int8_t gssw_simd_supported (void) {
+    pthread_once(&gssw_simd_once, gssw_simd_resolve);
+    return gssw_simd_best;
+}
 
-    /* Used for iteration */
-	int32_t i, j, k;
+int8_t gssw_simd_set (int8_t level) {
+    int8_t best = gssw_simd_supported();
+    level = (level == GSSW_SIMD_AUTO || level > best) ? best : level;
+    __atomic_store_n(&gssw_simd_level, level, __ATOMIC_RELAXED);
+    return level;
+}
 
-	/* 16 byte insertion begin vector */
-	__m128i vGapO = _mm_set1_epi16(weight_gapO);
+int8_t gssw_simd_get (void) {
+    int8_t level = __atomic_load_n(&gssw_simd_level, __ATOMIC_RELAXED);
+    return level == GSSW_SIMD_AUTO ? gssw_simd_supported() : level;
+}
 
-	/* 16 byte insertion extension vector */
-	__m128i vGapE = _mm_set1_epi16(weight_gapE);
+const char* gssw_simd_name (int8_t level) {
+    if (level == GSSW_SIMD_AUTO) level = gssw_simd_get();
+    return gssw_kernel_table[level].name;
+}
 
-	/* 16 byte bias vector */
-	__m128i vMaxScore = vZero; /* Trace the highest score of the whole SW matrix. */
-	__m128i vMaxMark = vZero; /* Trace the highest score till the previous column. */
-	__m128i vTemp;
-	int32_t begin = 0, end = refLen, step = 1;
+static int8_t gssw_fcorr_mode = GSSW_FCORR_SCAN;
 
-	/* outer loop to process the reference sequence */
-	if (ref_dir == 1) {
-		begin = refLen - 1;
-		end = -1;
-		step = -1;
-	}
-	for (i = begin; LIKELY(i != end); i += step) {
-		int32_t cmp;
-		__m128i e = vZero, vF = vZero; /* Initialize F value to 0.
-							   Any errors to vH values will be corrected in the Lazy_F loop.
-							 */
-		__m128i vH = pvHStore[segLen - 1];
-		vH = _mm_slli_si128 (vH, 2); /* Shift the 128-bit value in vH left by 2 byte. */
-
-		/* Swap the 2 H buffers. */
-		__m128i* pv = pvHLoad;
-
-		__m128i vMaxColumn = vZero; /* vMaxColumn is used to record the max values of column i. */
-
-		__m128i* vP = vProfile + ref[i] * segLen; /* Right part of the vProfile */
-		pvHLoad = pvHStore;
-		pvHStore = pv;
-
-		/* inner loop to process the query sequence */
-		for (j = 0; LIKELY(j < segLen); j ++) {
-			vH = _mm_adds_epi16(vH, _mm_load_si128(vP + j));
-
-			/* Get max from vH, vE and vF. */
-			e = _mm_load_si128(pvE + j);
-			vH = _mm_max_epi16(vH, e);
-			vH = _mm_max_epi16(vH, vF);
-			vMaxColumn = _mm_max_epi16(vMaxColumn, vH);
-
-			/* Save vH values. */
-			_mm_store_si128(pvHStore + j, vH);
-
-			/* Update vE value. */
-			vH = _mm_subs_epu16(vH, vGapO); /* saturation arithmetic, result >= 0 */
-			e = _mm_subs_epu16(e, vGapE);
-			e = _mm_max_epi16(e, vH);
-			_mm_store_si128(pvE + j, e);
-
-			/* Update vF value. */
-			vF = _mm_subs_epu16(vF, vGapE);
-			vF = _mm_max_epi16(vF, vH);
-
-			/* Load the next vH. */
-			vH = _mm_load_si128(pvHLoad + j);
-		}
+static inline int8_t gssw_fcorr_valid (int8_t mode) {
+    return mode == GSSW_FCORR_LAZY ? GSSW_FCORR_LAZY : GSSW_FCORR_SCAN;
+}
 
-		/* Lazy_F loop: has been revised to disallow adjecent insertion and then deletion, so don't update E(i, j), learn from SWPS3 */
-		for (k = 0; LIKELY(k < 8); ++k) {
-			vF = _mm_slli_si128 (vF, 2);
-			for (j = 0; LIKELY(j < segLen); ++j) {
-				vH = _mm_load_si128(pvHStore + j);
-				vH = _mm_max_epi16(vH, vF);
-				_mm_store_si128(pvHStore + j, vH);
-				vH = _mm_subs_epu16(vH, vGapO);
-				vF = _mm_subs_epu16(vF, vGapE);
-				if (UNLIKELY(! _mm_movemask_epi8(_mm_cmpgt_epi16(vF, vH)))) goto end;
-			}
-		}
+int8_t gssw_fcorr_set (int8_t mode) {
+    mode = gssw_fcorr_valid(mode);
+    __atomic_store_n(&gssw_fcorr_mode, mode, __ATOMIC_RELAXED);
+    return mode;
+}
 
-end:
-		vMaxScore = _mm_max_epi16(vMaxScore, vMaxColumn);
-		vTemp = _mm_cmpeq_epi16(vMaxMark, vMaxScore);
-		cmp = _mm_movemask_epi8(vTemp);
-		if (cmp != 0xffff) {
-			uint16_t temp;
-			vMaxMark = vMaxScore;
-			m128i_max8(temp, vMaxScore);
-			vMaxScore = vMaxMark;
-
-			if (LIKELY(temp > max)) {
-				max = temp;
-				end_ref = i;
-				for (j = 0; LIKELY(j < segLen); ++j) pvHmax[j] = pvHStore[j];
-			}
-		}
+int8_t gssw_fcorr_get (void) {
+    return __atomic_load_n(&gssw_fcorr_mode, __ATOMIC_RELAXED);
+}
 
-        /* save current column */
-        for (j = 0; LIKELY(j < segLen); ++j) {
-            uint16_t* t;
-            int32_t ti;
-            vH = pvHStore[j];
-            for (t = (uint16_t*)&vH, ti = 0; ti < 8; ++ti) {
-                //fprintf(stdout, "%d\t", *t++);
-                ((uint16_t*)mH)[i*readLen + ti*segLen + j] = *t++;
-            }
-            //fprintf(stdout, "\n");
-        }
+static int8_t gssw_matrix_mode = GSSW_MATRIX_H;
 
-		/* Record the max score of current column. */
-		//max8(maxColumn[i], vMaxColumn);
-		//if (maxColumn[i] == terminate) break;
+static inline int8_t gssw_matrix_valid (int8_t mode) {
+    return mode == GSSW_MATRIX_DIR || mode == GSSW_MATRIX_CKPT || mode == GSSW_MATRIX_DELTA ? mode : GSSW_MATRIX_H;
+}
 
-	}
+int8_t gssw_matrix_set (int8_t mode) {
+    mode = gssw_matrix_valid(mode);
+    __atomic_store_n(&gssw_matrix_mode, mode, __ATOMIC_RELAXED);
+    return mode;
+}
 
-    memcpy(alignment->seed.pvE,      pvE,      segLen*sizeof(__m128i));
-    memcpy(alignment->seed.pvHStore, pvHStore, segLen*sizeof(__m128i));
+int8_t gssw_matrix_get (void) {
+    return __atomic_load_n(&gssw_matrix_mode, __ATOMIC_RELAXED);
+}
 
+static int32_t gssw_ckpt_interval = 64;
 
-	/* Trace the alignment ending position on read. */
-	uint16_t *t = (uint16_t*)pvHmax;
-	int32_t column_len = segLen * 8;
-	for (i = 0; LIKELY(i < column_len); ++i, ++t) {
-		int32_t temp;
-		if (*t == max) {
-			temp = i / 8 + i % 8 * segLen;
-			if (temp < end_read) end_read = temp;
-		}
-	}
+int32_t gssw_checkpoint_set (int32_t k) {
+    k = k < 1 ? 1 : k;
+    __atomic_store_n(&gssw_ckpt_interval, k, __ATOMIC_RELAXED);
+    return k;
+}
 
-	free(pvE);
-	free(pvHmax);
-	free(pvHLoad);
-    free(pvHStore);
+int32_t gssw_checkpoint_get (void) {
+    return __atomic_load_n(&gssw_ckpt_interval, __ATOMIC_RELAXED);
+}
 
-	/* Find the most possible 2nd best alignment. */
-	gssw_alignment_end* bests = (gssw_alignment_end*) calloc(2, sizeof(gssw_alignment_end));
-	bests[0].score = max;
-	bests[0].ref = end_ref;
-	bests[0].read = end_read;
+/* the settings of a fill without a context */
+static inline gssw_fill_settings gssw_fill_defaults (void) {
+    gssw_fill_settings s = { gssw_matrix_get(), gssw_fcorr_get(), gssw_checkpoint_get() };
+    return s;
+}
 
-	return bests;
+/* store_mH argument of the kernels for a fill with prof and gap open gapO which is to be traced back under matrix
+   mode mode.  Packed H needs the differences down the read, -gapO ... max_match + gapO (0 past the end of the read),
+   in 4 signed bits. */
+static inline int8_t gssw_matrix_store (const gssw_profile* prof, uint8_t gapO, int8_t mode) {
+    int32_t i, max_match = 0;
+    if (mode == GSSW_MATRIX_DIR) return 2;
+    if (mode == GSSW_MATRIX_CKPT) return 3;
+    if (mode != GSSW_MATRIX_DELTA || gapO > 8) return 1;
+    for (i = 0; i < prof->n * prof->n; ++i) if (prof->mat[i] > max_match) max_match = prof->mat[i];
+    return max_match + gapO <= 7 ? 4 : 1;
 }
 
 int8_t* gssw_seq_reverse(const int8_t* seq, int32_t end)	/* end is 0-based alignment ending position */
@@ -621,11 +874,20 @@ int8_t* gssw_seq_reverse(const int8_t* seq, int32_t end)	/* end is 0-based align
 	return reverse;
 }
 
-gssw_profile* gssw_init (const int8_t* read, const int32_t readLen, const int8_t* mat, const int32_t n, const int8_t score_size) {
-	gssw_profile* p = (gssw_profile*)calloc(1, sizeof(struct gssw_profile));
+/* gssw_init, with the profile taken from the arena of ws when there is one (and then not to be destroyed); NULL if the
+   arena has no room for it */
+static gssw_profile* gssw_init_ws (const int8_t* read, const int32_t readLen, const int8_t* mat, const int32_t n,
+                                   const int8_t score_size, gssw_workspace* ws) {
+	gssw_profile* p = ws ? (gssw_profile*)gssw_ws_alloc(ws, sizeof(struct gssw_profile))
+	                     : (gssw_profile*)calloc(1, sizeof(struct gssw_profile));
+	const gssw_kernels* k = &gssw_kernel_table[gssw_simd_get()];
+	if (UNLIKELY(!p)) return NULL;
 	p->profile_byte = 0;
 	p->profile_word = 0;
+	p->profile_dword = 0;
+	p->profile_band = 0;
 	p->bias = 0;
+	p->simd = gssw_simd_get();
 
 	if (score_size == 0 || score_size == 2) {
 		/* Find the bias to use in the substitution matrix */
@@ -634,9 +896,13 @@ gssw_profile* gssw_init (const int8_t* read, const int32_t readLen, const int8_t
 		bias = abs(bias);
 
 		p->bias = bias;
-		p->profile_byte = gssw_qP_byte (read, mat, readLen, n, bias);
+		p->profile_byte = k->qP_byte (read, mat, readLen, n, bias, ws);
+	}
+	if (score_size == 1 || score_size == 2) p->profile_word = k->qP_word (read, mat, readLen, n, ws);
+	if (UNLIKELY((score_size != 1 && !p->profile_byte) || (score_size >= 1 && !p->profile_word))) {
+		if (!ws) gssw_init_destroy(p);
+		return NULL;
 	}
-	if (score_size == 1 || score_size == 2) p->profile_word = gssw_qP_word (read, mat, readLen, n);
 	p->read = read;
 	p->mat = mat;
 	p->readLen = readLen;
@@ -644,49 +910,80 @@ gssw_profile* gssw_init (const int8_t* read, const int32_t readLen, const int8_t
 	return p;
 }
 
+gssw_profile* gssw_init (const int8_t* read, const int32_t readLen, const int8_t* mat, const int32_t n, const int8_t score_size) {
+	return gssw_init_ws(read, readLen, mat, n, score_size, NULL);
+}
+
 void gssw_init_destroy (gssw_profile* p) {
 	free(p->profile_byte);
 	free(p->profile_word);
+	free(p->profile_dword);
+	free(p->profile_band);
 	free(p);
 }
 
-gssw_align* gssw_fill (const gssw_profile* prof,
-                       const int8_t* ref,
-                       const int32_t refLen,
-                       const uint8_t weight_gapO,
-                       const uint8_t weight_gapE,
-                       const int32_t maskLen,
-                       gssw_seed* seed) {
+/* gssw_fill keeping what store_mH says of the matrix, 0 for the score-only pass of gssw_ssw_align, with settings
+   set; NULL if there is no memory for the matrix */
+static gssw_align* gssw_fill_store (const gssw_profile* prof,
+                                    const int8_t* ref,
+                                    const int32_t refLen,
+                                    const uint8_t weight_gapO,
+                                    const uint8_t weight_gapE,
+                                    const int32_t maskLen,
+                                    gssw_seed* seed,
+                                    const int8_t store,
+                                    gssw_fill_settings set) {
 
 	gssw_alignment_end* bests = 0;
 	int32_t readLen = prof->readLen;
+	const gssw_kernels* k = &gssw_kernel_table[prof->simd];
     gssw_align* alignment = gssw_align_create();
 
-	if (maskLen < 15) {
-		fprintf(stderr, "When maskLen < 15, the function ssw_align doesn't return 2nd best alignment information.\n");
-	}
-
 	// Find the alignment scores and ending positions
 	if (prof->profile_byte) {
-		bests = gssw_sw_sse2_byte(ref, 0, refLen, readLen, weight_gapO, weight_gapE, prof->profile_byte, -1, prof->bias, maskLen,
-                             alignment, seed);
+		bests = k->sw_byte(ref, 0, refLen, readLen, weight_gapO, weight_gapE, prof->profile_byte, -1, prof->bias, maskLen,
+                           -1, 0, store, set, alignment, seed, NULL);
 
-		if (prof->profile_word && bests[0].score == 255) {
+		if (!bests) {
+			gssw_align_destroy(alignment);
+			return 0;
+		} else if (prof->profile_word && bests[0].score == 255) {
 			free(bests);
             gssw_align_clear_matrix_and_seed(alignment);
-            bests = gssw_sw_sse2_word(ref, 0, refLen, readLen, weight_gapO, weight_gapE, prof->profile_byte, -1, maskLen,
-                                      alignment, seed);
+            bests = k->sw_word(ref, 0, refLen, readLen, weight_gapO, weight_gapE, prof->profile_word, -1, maskLen,
+                               -1, 0, store, set, alignment, seed, NULL);
         } else if (bests[0].score == 255) {
 			fprintf(stderr, "Please set 2 to the score_size parameter of the function ssw_init, otherwise the alignment results will be incorrect.\n");
 			return 0;
 		}
 	} else if (prof->profile_word) {
-		bests = gssw_sw_sse2_word(ref, 0, refLen, readLen, weight_gapO, weight_gapE, prof->profile_word, -1, maskLen,
-                                  alignment, seed);
+		bests = k->sw_word(ref, 0, refLen, readLen, weight_gapO, weight_gapE, prof->profile_word, -1, maskLen,
+                           -1, 0, store, set, alignment, seed, NULL);
     } else {
 		fprintf(stderr, "Please call the function ssw_init before ssw_align.\n");
 		return 0;
 	}
+	if (bests && !alignment->is_byte && bests[0].score == INT16_MAX) {
+		// 16 bits saturated too, redo with 32-bit scores; a word seed is widened through a stand-in predecessor
+		void* profile_dword = prof->profile_dword ? prof->profile_dword
+		                                          : k->qP_dword(prof->read, prof->mat, readLen, prof->n, NULL);
+		gssw_seed* dseed = NULL;
+		if (seed) {
+			gssw_align pa = { .score_width = 2, .seed = *seed };
+			gssw_align* pap = &pa;
+			dseed = k->create_seed_dword(readLen, &pap, 1, NULL);
+		}
+		free(bests);
+		gssw_align_clear_matrix_and_seed(alignment);
+		bests = k->sw_dword(ref, 0, refLen, readLen, weight_gapO, weight_gapE, profile_dword, -1, maskLen,
+		                    -1, 0, store, set, alignment, dseed, NULL);
+		if (dseed) gssw_seed_destroy(dseed);
+		if (profile_dword != prof->profile_dword) free(profile_dword);
+	}
+	if (!bests) {
+		gssw_align_destroy(alignment);
+		return 0;
+	}
 	alignment->score1 = bests[0].score;
 	alignment->ref_end1 = bests[0].ref;
 	alignment->read_end1 = bests[0].read;
@@ -702,11 +999,35 @@ gssw_align* gssw_fill (const gssw_profile* prof,
 	return alignment;
 }
 
+gssw_align* gssw_fill (const gssw_profile* prof,
+                       const int8_t* ref,
+                       const int32_t refLen,
+                       const uint8_t weight_gapO,
+                       const uint8_t weight_gapE,
+                       const int32_t maskLen,
+                       gssw_seed* seed) {
+	if (maskLen < 15) {
+		fprintf(stderr, "When maskLen < 15, the function ssw_align doesn't return 2nd best alignment information.\n");
+	}
+	// no checkpoints, a dword profile may not outlive the fill
+	gssw_fill_settings set = gssw_fill_defaults();
+	int8_t store = gssw_matrix_store(prof, weight_gapO, set.matrix);
+	gssw_align* a = gssw_fill_store(prof, ref, refLen, weight_gapO, weight_gapE, maskLen, seed, store == 3 ? 1 : store,
+	                                set);
+	if (a && a->packed.overflow) {
+		// H did not pack after all
+		gssw_align_destroy(a);
+		a = gssw_fill_store(prof, ref, refLen, weight_gapO, weight_gapE, maskLen, seed, 1, set);
+	}
+	return a;
+}
+
 gssw_align* gssw_align_create (void) {
     gssw_align* a = (gssw_align*)calloc(1, sizeof(gssw_align));
     a->seed.pvHStore = NULL;
     a->seed.pvE = NULL;
     a->mH = NULL;
+    a->mH_lanes = 1;
 	a->ref_begin1 = -1;
 	a->read_begin1 = -1;
     return a;
@@ -714,205 +1035,750 @@ gssw_align* gssw_align_create (void) {
 
 void gssw_align_destroy (gssw_align* a) {
     gssw_align_clear_matrix_and_seed(a);
+    free(a->cigar);
 	free(a);
 }
 
 void gssw_align_clear_matrix_and_seed (gssw_align* a) {
-    free(a->mH);
+    if (!a->in_workspace) {
+        gssw_matrix_free(a->mH, a->in_mapping);
+        gssw_matrix_free(a->mD, a->in_mapping);
+        free(a->seed.pvHStore);
+        free(a->seed.pvE);
+        free(a->max_column);
+        free(a->ckpt.pv);
+        gssw_matrix_free(a->packed.m, a->in_mapping);
+    }
+    memset(&a->ckpt, 0, sizeof(gssw_checkpoints));
+    memset(&a->packed, 0, sizeof(gssw_packed));
     a->mH = NULL;
-    free(a->seed.pvHStore);
+    a->mD = NULL;
     a->seed.pvHStore = NULL;
-    free(a->seed.pvE);
     a->seed.pvE = NULL;
+    a->max_column = NULL;
+    a->in_workspace = 0;
+    a->in_mapping = 0;
 }
 
-void gssw_print_score_matrix (const char* ref,
-                              int32_t refLen,
-                              const char* read,
-                              int32_t readLen,
-                              gssw_align* alignment,
-                              FILE* out) {
+/* a fresh alignment in slot (see gssw_node_slot), recycling the one of an earlier fill */
+static gssw_align* gssw_node_reset_alignment (gssw_align** slot) {
+    gssw_align* a = *slot;
+    if (!a) return *slot = gssw_align_create();
+    gssw_align_clear_matrix_and_seed(a);
+    memset(a, 0, sizeof(gssw_align));
+    a->mH_lanes = 1;
+    a->ref_begin1 = -1;
+    a->read_begin1 = -1;
+    return a;
+}
 
-    int32_t i, j;
+/* a node of a graph and where it is in graph->nodes, sorted by node to find the latter from the former */
+typedef struct {
+    const gssw_node* node;
+    uint32_t i;
+} gssw_node_index;
 
-    fprintf(out, "\t");
-    for (i = 0; LIKELY(i < refLen); ++i) {
-        fprintf(out, "%c\t\t", ref[i]);
+static int gssw_node_index_cmp (const void* a, const void* b) {
+    uintptr_t x = (uintptr_t)((const gssw_node_index*)a)->node, y = (uintptr_t)((const gssw_node_index*)b)->node;
+    return x < y ? -1 : x > y;
+}
+
+/* What a fill of a graph leaves for its traceback, kept apart from the graph (see gssw_graph_context_create): the
+   alignment of every node, in the order of graph->nodes, and what the graph would hold itself. */
+struct gssw_graph_context {
+    const gssw_graph* graph;
+    gssw_node_index* index;
+    gssw_align** alignment;
+    gssw_node* max_node;
+    gssw_node_alignment_end second_best;
+    gssw_profile* profile;
+    const gssw_graph_compiled* compiled;	// graph is compiled->graph, filled off the index arrays; 0 if not compiled
+    gssw_align** prev;	// the predecessor alignments of the node being filled, compiled->max_prev of them
+    gssw_align* outside;	// what nodes outside a compiled graph read as, no scores
+    gssw_fill_settings settings;	// what its fills run with, the defaults when it was created
+};
+
+/* the alignment of the nodes outside a compiled graph */
+static gssw_align gssw_align_outside;
+
+/* where the alignment of node n of a fill goes: into context c, unless there is none or n is not in its graph (a
+   predecessor filled beforehand), into n */
+static inline gssw_align** gssw_node_slot (gssw_graph_context* c, const gssw_node* n) {
+    if (c) {
+        gssw_node_index key = { n, 0 };
+        const gssw_node_index* p = (const gssw_node_index*)bsearch(&key, c->index, c->graph->size,
+                                                                   sizeof(gssw_node_index), gssw_node_index_cmp);
+        if (p) return &c->alignment[p->i];
+        if (c->compiled) return &c->outside;
     }
-    fprintf(out, "\n");
+    return (gssw_align**)&n->alignment;
+}
 
-    if (gssw_is_byte(alignment)) {
-        uint8_t* mH = alignment->mH;
-        for (j = 0; LIKELY(j < readLen); ++j) {
-            fprintf(out, "%c\t", read[j]);
-            for (i = 0; LIKELY(i < refLen); ++i) {
-                fprintf(out, "(%u, %u) %u\t", i, j,
-                        ((uint8_t*)mH)[i*readLen + j]);
-            }
-            fprintf(out, "\n");
-        }
-    } else {
-        uint16_t* mH = alignment->mH;
-        for (j = 0; LIKELY(j < readLen); ++j) {
-            fprintf(out, "%c\t", read[j]);
-            for (i = 0; LIKELY(i < refLen); ++i) {
-                fprintf(out, "(%u, %u) %u\t", i, j,
-                        ((uint16_t*)mH)[i*readLen + j]);
-            }
-            fprintf(out, "\n");
+static inline gssw_align* gssw_node_align (gssw_graph_context* c, const gssw_node* n) {
+    return *gssw_node_slot(c, n);
+}
+
+/* the alignments the predecessors of node n have in context c, into prev (n->count_prev of them); 0, or -2 if one of
+   them has not been filled, the nodes not being in topological order */
+static int8_t gssw_node_prev_aligns (gssw_graph_context* c, const gssw_node* n, gssw_align** prev) {
+    int32_t j;
+    for (j = 0; j < n->count_prev; ++j) {
+        prev[j] = gssw_node_align(c, n->prev[j]);
+        if (UNLIKELY(!prev[j])) {
+            fprintf(stderr, "cannot align because node predecessors cannot provide seed\n");
+            fprintf(stderr, "failing is node %u\n", n->prev[j]->id);
+            fprintf(stderr, "error:[gssw] The nodes of a graph must be filled in topological order, see gssw_graph_sort.\n");
+            return -2;
         }
     }
+    return 0;
+}
 
-    fprintf(out, "\n");
+/* the seed of a node of the given width, merged from the alignments of its count predecessors */
+static gssw_seed* gssw_seed_merge (const gssw_kernels* k, uint8_t width, int32_t readLen, gssw_align** prev,
+                                   int32_t count, gssw_workspace* ws) {
+    if (width == 1) return k->create_seed_byte(readLen, prev, count, ws);
+    if (width == 2) return k->create_seed_word(readLen, prev, count, ws);
+    return k->create_seed_dword(readLen, prev, count, ws);
+}
 
+/* the seed of node n, of the given width, merged from the alignments its predecessors have in context c; NULL if
+   some predecessor is not filled or the seed cannot be had */
+static gssw_seed* gssw_node_seed (const gssw_kernels* k, uint8_t width, int32_t readLen, gssw_graph_context* c,
+                                  const gssw_node* n, gssw_workspace* ws) {
+    gssw_align* stack[16];
+    gssw_align** prev = n->count_prev > 16 ? (gssw_align**)malloc(n->count_prev * sizeof(gssw_align*)) : stack;
+    gssw_seed* seed = NULL;
+    if (gssw_node_prev_aligns(c, n, prev) == 0) seed = gssw_seed_merge(k, width, readLen, prev, n->count_prev, ws);
+    if (prev != stack) free(prev);
+    return seed;
 }
 
-void gssw_graph_print(gssw_graph* graph) {
-    uint32_t i = 0, gs = graph->size;
-    gssw_node** npp = graph->nodes;
-    fprintf(stdout, "GRAPH digraph variants {\n");
-    for (i=0; i<gs; ++i, ++npp) {
-        gssw_node* n = *npp;
-        fprintf(stdout, "GRAPH // node %u %u %s\n", n->id, n->len, n->seq);
-        uint32_t k;
-        for (k=0; k<n->count_prev; ++k) {
-            //fprintf(stdout, "GRAPH %u -> %u;\n", n->prev[k]->id, n->id);
-            fprintf(stdout, "GRAPH \"%u %s\" -> \"%u %s\";\n", n->prev[k]->id, n->prev[k]->seq, n->id, n->seq);
-        }
+gssw_graph_context* gssw_graph_context_create (const gssw_graph* graph) {
+    gssw_graph_context* c = (gssw_graph_context*)calloc(1, sizeof(gssw_graph_context));
+    uint32_t i;
+    c->graph = graph;
+    c->index = (gssw_node_index*)malloc((graph->size ? graph->size : 1) * sizeof(gssw_node_index));
+    c->alignment = (gssw_align**)calloc(graph->size ? graph->size : 1, sizeof(gssw_align*));
+    for (i = 0; i < graph->size; ++i) {
+        c->index[i].node = graph->nodes[i];
+        c->index[i].i = i;
     }
-    fprintf(stdout, "GRAPH }\n");
+    qsort(c->index, graph->size, sizeof(gssw_node_index), gssw_node_index_cmp);
+    c->second_best.end.ref = -1;
+    c->settings = gssw_fill_defaults();
+    return c;
 }
 
-void gssw_graph_print_stderr(gssw_graph* graph) {
-    uint32_t i = 0, gs = graph->size;
-    gssw_node** npp = graph->nodes;
-    fprintf(stderr, "GRAPH digraph variants {\n");
-    for (i=0; i<gs; ++i, ++npp) {
-        gssw_node* n = *npp;
-        fprintf(stderr, "GRAPH // node %u %u %s\n", n->id, n->len, n->seq);
-        uint32_t k;
-        for (k=0; k<n->count_prev; ++k) {
-            //fprintf(stdout, "GRAPH %u -> %u;\n", n->prev[k]->id, n->id);
-            fprintf(stderr, "GRAPH \"%u %s\" -> \"%u %s\";\n", n->prev[k]->id, n->prev[k]->seq, n->id, n->seq);
-        }
-    }
-    fprintf(stderr, "GRAPH }\n");
+void gssw_graph_context_destroy (gssw_graph_context* c) {
+    uint32_t i;
+    if (!c) return;
+    for (i = 0; i < c->graph->size; ++i) if (c->alignment[i]) gssw_align_destroy(c->alignment[i]);
+    if (c->profile) gssw_profile_destroy(c->profile);
+    free(c->prev);
+    free(c->alignment);
+    free(c->index);
+    free(c);
 }
 
-void gssw_graph_print_score_matrices(gssw_graph* graph, const char* read, int32_t readLen, FILE* out) {
-    uint32_t i = 0, gs = graph->size;
-    gssw_node** npp = graph->nodes;
-    for (i=0; i<gs; ++i, ++npp) {
-        gssw_node* n = *npp;
-        fprintf(out, "node %u\n", n->id);
-        gssw_print_score_matrix(n->seq, n->len, read, readLen, n->alignment, out);
-    }
+int8_t gssw_graph_context_matrix_set (gssw_graph_context* c, int8_t mode) {
+    return c->settings.matrix = gssw_matrix_valid(mode);
 }
 
-inline int gssw_is_byte (gssw_align* alignment) {
-    if (alignment->is_byte) {
-        return 1;
-    } else {
-        return 0;
-    }
+int32_t gssw_graph_context_checkpoint_set (gssw_graph_context* c, int32_t k) {
+    return c->settings.ckpt = k < 1 ? 1 : k;
 }
 
-gssw_cigar* gssw_alignment_trace_back (gssw_align* alignment,
-                                       uint16_t* score,
-                                       int32_t* refEnd,
-                                       int32_t* readEnd,
-                                       const char* ref,
-                                       int32_t refLen,
-                                       const char* read,
-                                       int32_t readLen,
-                                       int32_t match,
-                                       int32_t mismatch,
-                                       int32_t gap_open,
-                                       int32_t gap_extension) {
-    if (LIKELY(gssw_is_byte(alignment))) {
-        return gssw_alignment_trace_back_byte(alignment,
-                                              score,
-                                              refEnd,
-                                              readEnd,
-                                              ref,
-                                              refLen,
-                                              read,
-                                              readLen,
-                                              match,
-                                              mismatch,
-                                              gap_open,
-                                              gap_extension);
-    } else {
-        return gssw_alignment_trace_back_word(alignment,
-                                              score,
-                                              refEnd,
-                                              readEnd,
-                                              ref,
-                                              refLen,
-                                              read,
-                                              readLen,
-                                              match,
-                                              mismatch,
-                                              gap_open,
-                                              gap_extension);
-    }
+int8_t gssw_graph_context_fcorr_set (gssw_graph_context* c, int8_t mode) {
+    return c->settings.fcorr = gssw_fcorr_valid(mode);
 }
 
-gssw_cigar* gssw_alignment_trace_back_byte (gssw_align* alignment,
-                                            uint16_t* score,
-                                            int32_t* refEnd,
-                                            int32_t* readEnd,
-                                            const char* ref,
-                                            int32_t refLen,
-                                            const char* read,
-                                            int32_t readLen,
-                                            int32_t match,
-                                            int32_t mismatch,
-                                            int32_t gap_open,
-                                            int32_t gap_extension) {
+gssw_node* gssw_graph_context_best (const gssw_graph_context* c) {
+    return c->max_node;
+}
+
+const gssw_align* gssw_graph_context_alignment (gssw_graph_context* c, const gssw_node* n) {
+    return gssw_node_align(c, n);
+}
+
+gssw_graph_context* gssw_graph_context_compiled (const gssw_graph_compiled* cg) {
+    gssw_graph_context* c = gssw_graph_context_create(&cg->graph);
+    c->compiled = cg;
+    c->prev = (gssw_align**)malloc((cg->max_prev ? cg->max_prev : 1) * sizeof(gssw_align*));
+    c->outside = &gssw_align_outside;
+    return c;
+}
+
+/* The nodes of graph in a topological order, node order[k] going k-th: Kahn's algorithm taking the newest ready node
+   first, so that the order runs down one branch of a bubble, then the next, then on to the node joining them.  Edges
+   from and to nodes outside the graph are left out.  0 if the edges within the graph have a cycle. */
+static uint32_t* gssw_graph_order (const gssw_graph* graph) {
+    uint32_t size = graph->size, i, k = 0, top = 0;
+    int32_t j;
+    gssw_node_index* index = (gssw_node_index*)malloc((size ? size : 1) * sizeof(gssw_node_index));
+    uint32_t* pending = (uint32_t*)calloc(size ? size : 1, sizeof(uint32_t));
+    uint32_t* stack = (uint32_t*)malloc((size ? size : 1) * sizeof(uint32_t));
+    uint32_t* order = (uint32_t*)malloc((size ? size : 1) * sizeof(uint32_t));
+    gssw_node_index* q;
+    for (i = 0; i < size; ++i) {
+        index[i].node = graph->nodes[i];
+        index[i].i = i;
+    }
+    qsort(index, size, sizeof(gssw_node_index), gssw_node_index_cmp);
+    for (i = 0; i < size; ++i) {
+        gssw_node* n = graph->nodes[i];
+        for (j = 0; j < n->count_next; ++j) {
+            gssw_node_index key = { n->next[j], 0 };
+            q = (gssw_node_index*)bsearch(&key, index, size, sizeof(gssw_node_index), gssw_node_index_cmp);
+            if (q) ++pending[q->i];
+        }
+    }
+
+    // sources and successors are pushed last first, to come out in the order they are listed in
+    for (i = size; i-- > 0;) if (!pending[i]) stack[top++] = i;
+    while (top) {
+        gssw_node* n;
+        i = stack[--top];
+        order[k++] = i;
+        n = graph->nodes[i];
+        for (j = n->count_next; j-- > 0;) {
+            gssw_node_index key = { n->next[j], 0 };
+            q = (gssw_node_index*)bsearch(&key, index, size, sizeof(gssw_node_index), gssw_node_index_cmp);
+            if (q && --pending[q->i] == 0) stack[top++] = q->i;
+        }
+    }
+    if (k < size) {
+        for (i = 0; !pending[i]; ++i) ;
+        fprintf(stderr, "error:[gssw] The graph has a cycle, node %u is on or after it.\n", graph->nodes[i]->id);
+        free(order);
+        order = NULL;
+    }
+    free(index);
+    free(pending);
+    free(stack);
+    return order;
+}
+
+int32_t gssw_graph_sort (gssw_graph* graph) {
+    uint32_t* order = gssw_graph_order(graph);
+    gssw_node** nodes;
+    uint32_t i;
+    if (!order) return -1;
+    nodes = (gssw_node**)malloc((graph->size ? graph->size : 1) * sizeof(gssw_node*));
+    for (i = 0; i < graph->size; ++i) nodes[i] = graph->nodes[order[i]];
+    memcpy(graph->nodes, nodes, graph->size * sizeof(gssw_node*));
+    free(nodes);
+    free(order);
+    return 0;
+}
+
+/* room for n items of size bytes in a compiled graph, at offset *at of its block, 64-byte aligned */
+static size_t gssw_compiled_take (size_t* at, size_t n, size_t size) {
+    size_t x = *at;
+    *at = (x + n * size + 63) & ~(size_t)63;
+    return x;
+}
+
+gssw_graph_compiled* gssw_graph_compile (const gssw_graph* graph) {
+    uint32_t size = graph->size, i, edges = 0, max_prev = 0, x;
+    uint64_t len = 0;
+    int32_t j;
+    uint32_t* order = gssw_graph_order(graph);
+    if (!order) return NULL;
+    // the nodes and their places in the compiled order
+    gssw_node_index* index = (gssw_node_index*)malloc((size ? size : 1) * sizeof(gssw_node_index));
+    gssw_node_index* q;
+    for (i = 0; i < size; ++i) {
+        index[i].node = graph->nodes[order[i]];
+        index[i].i = i;
+    }
+    qsort(index, size, sizeof(gssw_node_index), gssw_node_index_cmp);
+
+    for (i = 0; i < size; ++i) {
+        gssw_node* n = graph->nodes[order[i]];
+        uint32_t count = 0;
+        for (j = 0; j < n->count_prev; ++j) {
+            gssw_node_index key = { n->prev[j], 0 };
+            if (bsearch(&key, index, size, sizeof(gssw_node_index), gssw_node_index_cmp)) ++count;
+        }
+        edges += count;
+        if (count > max_prev) max_prev = count;
+        len += n->len;
+    }
+
+    // everything in one block
+    size_t at = (sizeof(gssw_graph_compiled) + 63) & ~(size_t)63, nodes_at, prev_at, prev, next_at, next, num_at, num;
+    nodes_at = gssw_compiled_take(&at, size, sizeof(gssw_node*));
+    prev_at = gssw_compiled_take(&at, size + 1, sizeof(uint32_t));
+    prev = gssw_compiled_take(&at, edges, sizeof(uint32_t));
+    next_at = gssw_compiled_take(&at, size + 2, sizeof(uint32_t));
+    next = gssw_compiled_take(&at, edges, sizeof(uint32_t));
+    num_at = gssw_compiled_take(&at, size + 1, sizeof(uint64_t));
+    num = gssw_compiled_take(&at, len, sizeof(int8_t));
+    char* block = (char*)gssw_aligned_malloc(at, 64);
+    if (!block) {
+        free(index);
+        free(order);
+        return NULL;
+    }
+    gssw_graph_compiled* cg = (gssw_graph_compiled*)block;
+    memset(cg, 0, sizeof(gssw_graph_compiled));
+    cg->graph.size = size;
+    cg->graph.nodes = (gssw_node**)(block + nodes_at);
+    cg->graph.second_best.end.ref = -1;
+    cg->prev_at = (uint32_t*)(block + prev_at);
+    cg->prev = (uint32_t*)(block + prev);
+    cg->next_at = (uint32_t*)(block + next_at);
+    cg->next = (uint32_t*)(block + next);
+    cg->num_at = (uint64_t*)(block + num_at);
+    cg->num = (int8_t*)(block + num);
+    cg->max_prev = max_prev;
+    memset(cg->next_at, 0, (size + 2) * sizeof(uint32_t));
+
+    cg->prev_at[0] = 0;
+    cg->num_at[0] = 0;
+    for (i = 0, x = 0; i < size; ++i) {
+        gssw_node* n = graph->nodes[order[i]];
+        cg->graph.nodes[i] = n;
+        for (j = 0; j < n->count_prev; ++j) {
+            gssw_node_index key = { n->prev[j], 0 };
+            q = (gssw_node_index*)bsearch(&key, index, size, sizeof(gssw_node_index), gssw_node_index_cmp);
+            if (!q) continue;
+            cg->prev[x++] = q->i;
+            ++cg->next_at[q->i + 2];
+        }
+        cg->prev_at[i + 1] = x;
+        memcpy(cg->num + cg->num_at[i], n->num, n->len);
+        cg->num_at[i + 1] = cg->num_at[i] + n->len;
+    }
+    // successors by counting sort of the predecessor lists, as the parallel fill does
+    for (i = 0; i < size; ++i) cg->next_at[i + 2] += cg->next_at[i + 1];
+    for (i = 0; i < size; ++i) {
+        for (x = cg->prev_at[i]; x < cg->prev_at[i + 1]; ++x) cg->next[cg->next_at[cg->prev[x] + 1]++] = i;
+    }
+    free(index);
+    free(order);
+    return cg;
+}
+
+void gssw_graph_compiled_destroy (gssw_graph_compiled* cg) {
+    free(cg);
+}
+
+/* What a traceback recomputes of the fills it reads: the block of a checkpointed fill it is in, the columns decoded
+   from a packed one.  It belongs to the traceback, the fills are only read, and goes with gssw_matrix_release once
+   the traceback is done with the fill. */
+typedef struct {
+    const gssw_align* a;	// the fill of block
+    int32_t block;	// block recomputed last, in mH (mapped if mapped is 1); -1 for none
+    void* mH;
+    uint8_t mapped;
+    const gssw_align* p;	// the fill of the columns of cache
+    int32_t col[2];	// columns decoded last, into cache (always from the heap); -1 for none
+    int32_t last;	// which of them was read last
+    void* cache;
+    int8_t failed;	// 1 once a block could not be recomputed, its cells reading as 0
+} gssw_tb_cache;
+
+#define GSSW_TB_CACHE_INIT { NULL, -1, NULL, 0, NULL, { -1, -1 }, 0, NULL, 0 }
+
+static uint32_t gssw_ckpt_cell (gssw_tb_cache* t, const gssw_align* a, int32_t i, int32_t j);
+static uint32_t gssw_packed_cell (gssw_tb_cache* t, const gssw_align* a, int32_t i, int32_t j);
+
+/* score of cell (i, j) of a fill, whatever its width, with what has to be recomputed for it kept in t; nodes skipped
+   by X-drop have no matrix and score 0, and so do the cells outside the band of a banded fill */
+static inline uint32_t gssw_mH_cell (gssw_tb_cache* t, const gssw_align* a, int32_t i, int32_t j) {
+    size_t x;
+    if (UNLIKELY(a->ckpt.pv != NULL)) return gssw_ckpt_cell(t, a, i, j);
+    if (UNLIKELY(a->packed.m != NULL)) return gssw_packed_cell(t, a, i, j);
+    if (UNLIKELY(!a->mH)) return 0;
+    if (a->band_w) {
+        int32_t k = j - a->band_lo - i;
+        if (k < 0 || k >= a->band_w) return 0;
+        x = (size_t)i * a->mH_stride + k;
+    } else {
+        x = gssw_mH_index(a, i, j);
+    }
+    switch (a->score_width) {
+    case 1: return ((uint8_t*)a->mH)[x];
+    case 2: return ((uint16_t*)a->mH)[x];
+    default: return ((uint32_t*)a->mH)[x];
+    }
+}
+
+/* direction bits of cell (i, j) of a fill under GSSW_MATRIX_DIR, plane p in bit p (see gssw_dir_put in gssw_kernel.h):
+   where H came from in the low two bits, then whether the E leaving the cell and the F of the cell were opened */
+#define GSSW_DIR_F      0
+#define GSSW_DIR_E      1
+#define GSSW_DIR_DIAG   2
+#define GSSW_DIR_NONE   3
+#define GSSW_DIR_E_OPEN 4
+#define GSSW_DIR_F_OPEN 8
+
+static inline uint32_t gssw_mD_cell (const gssw_align* a, int32_t i, int32_t j) {
+    int32_t w = a->score_width, p;
+    size_t base = ((size_t)i * a->mH_seg + j % a->mH_seg) * 4 * a->mH_lanes + (size_t)(j / a->mH_seg) * w;
+    uint32_t d = 0;
+    for (p = 0; p < 4; ++p) {
+        size_t bit = base + (size_t)(p / w) * a->mH_lanes * w + p % w;
+        d |= ((a->mD[bit >> 3] >> (bit & 7)) & 1) << p;
+    }
+    return d;
+}
+
+/* cell j of the H (or E) column a fill hands on to its successors, whatever its width; 0 for nodes skipped by X-drop */
+static inline uint32_t gssw_seed_cell (const gssw_align* a, const void* v, int32_t j) {
+    size_t x;
+    if (UNLIKELY(!v)) return 0;
+    x = (size_t)(j % a->mH_seg) * a->mH_lanes + j / a->mH_seg;
+    switch (a->score_width) {
+    case 1: return ((uint8_t*)v)[x];
+    case 2: return ((uint16_t*)v)[x];
+    default: return ((uint32_t*)v)[x];
+    }
+}
+
+/* mH of block b of a checkpointed fill, refilled from its checkpoint into t unless it is the one refilled last.  The
+   fill is rerun as it was, from the H and E columns it had before the block, so the scores are the same.  NULL, with
+   t->failed set, if there is no memory for the block. */
+static const void* gssw_ckpt_block (gssw_tb_cache* t, const gssw_align* a, int32_t b) {
+    const gssw_checkpoints* c = &a->ckpt;
+    if (t->a != a || t->block != b) {
+        const gssw_kernels* k = &gssw_kernel_table[c->simd];
+        size_t column = (size_t)a->mH_stride * a->score_width;
+        int32_t begin = b * c->k, len = c->end - begin < c->k ? c->end - begin : c->k;
+        gssw_seed seed = { (char*)c->pv + (2 * (size_t)b + 1) * column, (char*)c->pv + 2 * (size_t)b * column };
+        gssw_fill_settings set = { GSSW_MATRIX_H, GSSW_FCORR_SCAN, c->k };	// either correction leaves the same H
+        gssw_align f;
+        gssw_alignment_end* bests;
+        memset(&f, 0, sizeof(gssw_align));
+        gssw_matrix_free(t->mH, t->mapped);
+        t->mH = NULL;
+        t->a = NULL;
+        switch (a->score_width) {
+        case 1:
+            bests = k->sw_byte(c->ref + begin, 0, len, c->readLen, c->gapO, c->gapE, c->profile, -1, c->bias, 0,
+                               -1, 0, 1, set, &f, &seed, NULL);
+            break;
+        case 2:
+            bests = k->sw_word(c->ref + begin, 0, len, c->readLen, c->gapO, c->gapE, c->profile, -1, 0,
+                               -1, 0, 1, set, &f, &seed, NULL);
+            break;
+        default:
+            bests = k->sw_dword(c->ref + begin, 0, len, c->readLen, c->gapO, c->gapE, c->profile, -1, 0,
+                                -1, 0, 1, set, &f, &seed, NULL);
+            break;
+        }
+        if (UNLIKELY(!bests)) {
+            gssw_align_clear_matrix_and_seed(&f);
+            t->failed = 1;
+            return NULL;
+        }
+        free(bests);
+        t->a = a;
+        t->block = b;
+        t->mH = f.mH;
+        t->mapped = f.in_mapping;
+        f.mH = NULL;
+        f.in_mapping = 0;
+        gssw_align_clear_matrix_and_seed(&f);
+    }
+    return t->mH;
+}
+
+/* gssw_mH_cell of a checkpointed fill: the last column is the seed, the one before every other checkpoint is in it,
+   the rest are refilled a block at a time */
+static uint32_t gssw_ckpt_cell (gssw_tb_cache* t, const gssw_align* a, int32_t i, int32_t j) {
+    const gssw_checkpoints* c = &a->ckpt;
+    size_t column = (size_t)a->mH_stride * a->score_width;
+    if (i >= c->end) return 0;
+    if (i == c->len - 1) return gssw_seed_cell(a, a->seed.pvHStore, j);
+    if ((i + 1) % c->k == 0) return gssw_seed_cell(a, (const char*)c->pv + 2 * (size_t)((i + 1) / c->k) * column, j);
+    const char* mH = (const char*)gssw_ckpt_block(t, a, i / c->k);
+    return mH ? gssw_seed_cell(a, mH + (size_t)(i % c->k) * column, j) : 0;
+}
+
+/* gssw_mH_cell of a packed fill: column i is decoded into one of the two columns of t->cache, that not read last,
+   unless it is there already.  The tracebacks read columns i and i - 1 by turns, so each column is decoded about
+   once. */
+static uint32_t gssw_packed_cell (gssw_tb_cache* t, const gssw_align* a, int32_t i, int32_t j) {
+    const gssw_packed* p = &a->packed;
+    size_t column = (size_t)a->mH_stride * a->score_width;
+    int32_t c = t->p != a ? -1 : t->col[0] == i ? 0 : t->col[1] == i ? 1 : -1;
+    if (c < 0) {
+        if (t->p != a) {
+            // the columns of another fill, which may be wider
+            free(t->cache);
+            t->cache = gssw_aligned_malloc(2 * column, 64);
+            t->p = NULL;
+            t->col[0] = t->col[1] = -1;
+            if (UNLIKELY(!t->cache)) {
+                t->failed = 1;
+                return 0;
+            }
+            t->p = a;
+        }
+        c = !t->last;
+        p->unpack((const char*)p->m + (size_t)i * p->stride, a->mH_seg, (char*)t->cache + c * column);
+        t->col[c] = i;
+    }
+    t->last = c;
+    return gssw_seed_cell(a, (const char*)t->cache + c * column, j);
+}
+
+/* let go of what a traceback recomputed of the matrices into t, once it is done with the node; a failure stays */
+static inline void gssw_matrix_release (gssw_tb_cache* t) {
+    int8_t failed = t->failed;
+    gssw_matrix_free(t->mH, t->mapped);
+    free(t->cache);
+    *t = (gssw_tb_cache)GSSW_TB_CACHE_INIT;
+    t->failed = failed;
+}
+
+void gssw_print_score_matrix (const char* ref,
+                              int32_t refLen,
+                              const char* read,
+                              int32_t readLen,
+                              gssw_align* alignment,
+                              FILE* out) {
+
+    int32_t i, j;
+    gssw_tb_cache t = GSSW_TB_CACHE_INIT;
+
+    fprintf(out, "\t");
+    for (i = 0; LIKELY(i < refLen); ++i) {
+        fprintf(out, "%c\t\t", ref[i]);
+    }
+    fprintf(out, "\n");
+
+    for (j = 0; LIKELY(j < readLen); ++j) {
+        fprintf(out, "%c\t", read[j]);
+        for (i = 0; LIKELY(i < refLen); ++i) {
+            fprintf(out, "(%u, %u) %u\t", i, j, gssw_mH_cell(&t, alignment, i, j));
+        }
+        fprintf(out, "\n");
+    }
+
+    fprintf(out, "\n");
+    gssw_matrix_release(&t);
+
+}
+
+void gssw_graph_print(gssw_graph* graph) {
+    uint32_t i = 0, gs = graph->size;
+    gssw_node** npp = graph->nodes;
+    fprintf(stdout, "GRAPH digraph variants {\n");
+    for (i=0; i<gs; ++i, ++npp) {
+        gssw_node* n = *npp;
+        fprintf(stdout, "GRAPH // node %u %u %s\n", n->id, n->len, n->seq);
+        uint32_t k;
+        for (k=0; k<n->count_prev; ++k) {
+            //fprintf(stdout, "GRAPH %u -> %u;\n", n->prev[k]->id, n->id);
+            fprintf(stdout, "GRAPH \"%u %s\" -> \"%u %s\";\n", n->prev[k]->id, n->prev[k]->seq, n->id, n->seq);
+        }
+    }
+    fprintf(stdout, "GRAPH }\n");
+}
+
+void gssw_graph_print_stderr(gssw_graph* graph) {
+    uint32_t i = 0, gs = graph->size;
+    gssw_node** npp = graph->nodes;
+    fprintf(stderr, "GRAPH digraph variants {\n");
+    for (i=0; i<gs; ++i, ++npp) {
+        gssw_node* n = *npp;
+        fprintf(stderr, "GRAPH // node %u %u %s\n", n->id, n->len, n->seq);
+        uint32_t k;
+        for (k=0; k<n->count_prev; ++k) {
+            //fprintf(stdout, "GRAPH %u -> %u;\n", n->prev[k]->id, n->id);
+            fprintf(stderr, "GRAPH \"%u %s\" -> \"%u %s\";\n", n->prev[k]->id, n->prev[k]->seq, n->id, n->seq);
+        }
+    }
+    fprintf(stderr, "GRAPH }\n");
+}
+
+void gssw_graph_print_score_matrices(gssw_graph* graph, const char* read, int32_t readLen, FILE* out) {
+    uint32_t i = 0, gs = graph->size;
+    gssw_node** npp = graph->nodes;
+    for (i=0; i<gs; ++i, ++npp) {
+        gssw_node* n = *npp;
+        fprintf(out, "node %u\n", n->id);
+        gssw_print_score_matrix(n->seq, n->len, read, readLen, n->alignment, out);
+    }
+}
+
+inline int gssw_is_byte (gssw_align* alignment) {
+    if (alignment->is_byte) {
+        return 1;
+    } else {
+        return 0;
+    }
+}
+
+/* A cigar under construction. Tracebacks find operations last to first, so they are written back to front into
+   buf[begin, cap), merged with the run at begin when the type matches; buf doubles when full, keeping its contents
+   at the back. Finishing moves the elements to the front of buf, which the cigar takes over, so no reverse pass or
+   per-operation realloc is needed.  Once buf cannot grow the builder fails, and drops what is prepended to it. */
+typedef struct {
+    gssw_cigar_element* buf;
+    int32_t begin;
+    int32_t cap;
+    gssw_arena* arena;
+    int8_t failed;
+} gssw_cigar_builder;
+
+static void gssw_cigar_builder_grow (gssw_cigar_builder* b) {
+    int32_t n = b->cap - b->begin;
+    int32_t cap = b->cap ? 2 * b->cap : 8;
+    size_t bytes = cap * sizeof(gssw_cigar_element);
+    gssw_cigar_element* buf = b->arena ? (gssw_cigar_element*)gssw_arena_alloc(b->arena, bytes)
+                                       : (gssw_cigar_element*)malloc(bytes);
+    if (UNLIKELY(!buf)) {
+        b->failed = 1;
+        return;
+    }
+    if (n) memcpy(buf + cap - n, b->buf + b->begin, n * sizeof(gssw_cigar_element));
+    if (!b->arena) free(b->buf);
+    b->buf = buf;
+    b->begin = cap - n;
+    b->cap = cap;
+}
+
+static inline void gssw_cigar_builder_prepend (gssw_cigar_builder* b, char type, uint32_t length) {
+    if (b->begin < b->cap && b->buf[b->begin].type == type) {
+        b->buf[b->begin].length += length;
+        return;
+    }
+    if (UNLIKELY(b->begin == 0)) {
+        gssw_cigar_builder_grow(b);
+        if (UNLIKELY(b->failed)) return;
+    }
+    --b->begin;
+    b->buf[b->begin].type = type;
+    b->buf[b->begin].length = length;
+}
+
+/* hands the buffer over to a new cigar and leaves the builder empty for the next one; NULL if it failed, or there is
+   no memory for the cigar */
+static gssw_cigar* gssw_cigar_builder_finish (gssw_cigar_builder* b) {
+    gssw_cigar* c = b->failed ? NULL
+                  : b->arena ? (gssw_cigar*)gssw_arena_alloc(b->arena, sizeof(gssw_cigar))
+                             : (gssw_cigar*)malloc(sizeof(gssw_cigar));
+    if (UNLIKELY(!c)) {
+        if (!b->arena) free(b->buf);
+        b->buf = NULL;
+        b->begin = b->cap = 0;
+        b->failed = 0;
+        return NULL;
+    }
+    c->length = b->cap - b->begin;
+    if (c->length && b->begin) memmove(b->buf, b->buf + b->begin, c->length * sizeof(gssw_cigar_element));
+    c->elements = b->buf;
+    c->capacity = b->cap;
+    b->buf = NULL;
+    b->begin = b->cap = 0;
+    return c;
+}
+
+/* Trace back through the fill matrix from (*refEnd, *readEnd), whatever the width of its scores,
+   prepending the operations found to b */
+#define GSSW_TB_H 0	// states of the traceback over direction bits: in H, in a deletion (E), in an insertion (F)
+#define GSSW_TB_E 1
+#define GSSW_TB_F 2
+
+/* Follow the direction bits of a fill back from cell (*i, *j) in *state, prepending the operations to b.  Returns 0
+   where the alignment begins, (*i, *j) being the cell before its first one, or the move out of the matrix, GSSW_DIR_DIAG
+   or GSSW_DIR_E, that cell (0, *j) takes, which is left to the caller. */
+static int32_t gssw_dir_trace_back (const gssw_align* a, int32_t* i, int32_t* j, int32_t* state, gssw_cigar_builder* b) {
+    int32_t x = *i, y = *j, s = *state, out = 0;
+    uint32_t d = gssw_mD_cell(a, x, y);
+    for (;;) {
+        if (s == GSSW_TB_H) {
+            uint32_t from = d & 3;
+            if (from == GSSW_DIR_NONE) break;
+            if (from == GSSW_DIR_E) { s = GSSW_TB_E; continue; }
+            if (from == GSSW_DIR_F) { s = GSSW_TB_F; continue; }
+            if (x == 0 && y > 0) { out = GSSW_DIR_DIAG; break; }
+            gssw_cigar_builder_prepend(b, 'M', 1);
+            --x; --y;
+            if (x < 0 || y < 0) break;
+        } else if (s == GSSW_TB_E) {
+            if (x == 0) { out = GSSW_DIR_E; break; }
+            gssw_cigar_builder_prepend(b, 'D', 1);
+            d = gssw_mD_cell(a, --x, y);
+            s = d & GSSW_DIR_E_OPEN ? GSSW_TB_H : GSSW_TB_E;
+            continue;
+        } else {
+            gssw_cigar_builder_prepend(b, 'I', 1);
+            s = d & GSSW_DIR_F_OPEN ? GSSW_TB_H : GSSW_TB_F;
+            if (--y < 0) break;
+        }
+        d = gssw_mD_cell(a, x, y);
+    }
+    *i = x;
+    *j = y;
+    *state = s;
+    return out;
+}
+
+static void gssw_alignment_trace_back_cells (gssw_align* alignment,
+                                             uint32_t* score,
+                                             int32_t* refEnd,
+                                             int32_t* readEnd,
+                                             const char* ref,
+                                             const char* read,
+                                             int32_t match,
+                                             int32_t mismatch,
+                                             int32_t gap_open,
+                                             int32_t gap_extension,
+                                             gssw_tb_cache* t,
+                                             gssw_cigar_builder* b) {
 
-    uint8_t* mH = (uint8_t*)alignment->mH;
     int32_t i = *refEnd;
     int32_t j = *readEnd;
+    if (alignment->mD) {
+        int32_t state = GSSW_TB_H;
+        *score = gssw_dir_trace_back(alignment, &i, &j, &state, b) ? alignment->score1 : 0;
+        *refEnd = i;
+        *readEnd = j;
+        return;
+    }
     // find maximum
-    uint8_t h = mH[readLen*i + j];
-	gssw_cigar* result = (gssw_cigar*)calloc(1, sizeof(gssw_cigar));
-    result->length = 0;
+    int64_t h = gssw_mH_cell(t, alignment, i, j);
 
     while (LIKELY(h != 0 && i >= 0 && j >= 0)) {
         // look at neighbors
-        int32_t d = 0, l = 0, u = 0;
+        int64_t d = 0, l = 0, u = 0;
         if (i > 0 && j > 0) {
-            d = mH[readLen*(i-1) + (j-1)];
+            d = gssw_mH_cell(t, alignment, i-1, j-1);
         }
         if (i > 0) {
-            l = mH[readLen*(i-1) + j];
+            l = gssw_mH_cell(t, alignment, i-1, j);
         }
         if (j > 0) {
-            u = mH[readLen*i + (j-1)];
+            u = gssw_mH_cell(t, alignment, i, j-1);
         }
 
         // get the max of the three directions
-        int32_t n = (l > u ? l : u);
+        int64_t n = (l > u ? l : u);
         n = (h > n ? h : n);
-        //fprintf(stderr, "byte (%i, %i) h=%i d=%i l=%i u=%i n=%i\n", i, j, h, d, l, u, n);
+        //fprintf(stderr, "(%i, %i) h=%li d=%li l=%li u=%li n=%li\n", i, j, h, d, l, u, n);
 
         if (h == n &&
             ((d + match == h && ref[i] == read[j])
              || (d == h && (ref[i] == 'N' || read[j] == 'N'))
              || (d - mismatch == h && ref[i] != read[j]))) {
             //fprintf(stderr, "(%i, %i) M %c %c\n", i, j, ref[i], read[j]);
-            gssw_cigar_push_back(result, 'M', 1);
+            gssw_cigar_builder_prepend(b, 'M', 1);
             h = d;
             --i; --j;
         } else if (l == n && (l - gap_open == h || l - gap_extension == h)) {
             //fprintf(stderr, "(%i, %i) D\n", i, j);
-            gssw_cigar_push_back(result, 'D', 1);
+            gssw_cigar_builder_prepend(b, 'D', 1);
             h = l;
             --i;
         } else if (u == n && (u - gap_open == h || u - gap_extension == h)) {
             //fprintf(stderr, "(%i, %i) I\n", i, j);
-            gssw_cigar_push_back(result, 'I', 1);
+            gssw_cigar_builder_prepend(b, 'I', 1);
             h = u;
             --j;
         } else {
@@ -921,19 +1787,65 @@ gssw_cigar* gssw_alignment_trace_back_byte (gssw_align* alignment,
     }
 
     *score = h;
-
-    gssw_reverse_cigar(result);
     *refEnd = i;
     *readEnd = j;
-    return result;
 }
 
+static gssw_cigar* gssw_alignment_trace_back_new (gssw_align* alignment,
+                                                  uint32_t* score,
+                                                  int32_t* refEnd,
+                                                  int32_t* readEnd,
+                                                  const char* ref,
+                                                  const char* read,
+                                                  int32_t match,
+                                                  int32_t mismatch,
+                                                  int32_t gap_open,
+                                                  int32_t gap_extension) {
+    gssw_cigar_builder b = { NULL, 0, 0, NULL, 0 };
+    gssw_tb_cache t = GSSW_TB_CACHE_INIT;
+    gssw_alignment_trace_back_cells(alignment, score, refEnd, readEnd, ref, read,
+                                    match, mismatch, gap_open, gap_extension, &t, &b);
+    if (UNLIKELY(t.failed)) b.failed = 1;
+    gssw_matrix_release(&t);
+    return gssw_cigar_builder_finish(&b);
+}
+
+gssw_cigar* gssw_alignment_trace_back (gssw_align* alignment,
+                                       uint32_t* score,
+                                       int32_t* refEnd,
+                                       int32_t* readEnd,
+                                       const char* ref,
+                                       int32_t refLen,
+                                       const char* read,
+                                       int32_t readLen,
+                                       int32_t match,
+                                       int32_t mismatch,
+                                       int32_t gap_open,
+                                       int32_t gap_extension) {
+    return gssw_alignment_trace_back_new(alignment, score, refEnd, readEnd, ref, read,
+                                         match, mismatch, gap_open, gap_extension);
+}
+
+// the width specific entry points are kept for existing callers, the cell reads dispatch on the width anyway
 
-// copy of the above but for 16 bit ints
-// sometimes there are good reasons for C++'s templates... sigh
+gssw_cigar* gssw_alignment_trace_back_byte (gssw_align* alignment,
+                                            uint32_t* score,
+                                            int32_t* refEnd,
+                                            int32_t* readEnd,
+                                            const char* ref,
+                                            int32_t refLen,
+                                            const char* read,
+                                            int32_t readLen,
+                                            int32_t match,
+                                            int32_t mismatch,
+                                            int32_t gap_open,
+                                            int32_t gap_extension) {
+    return gssw_alignment_trace_back_new(alignment, score, refEnd, readEnd, ref, read,
+                                         match, mismatch, gap_open, gap_extension);
+}
 
 gssw_cigar* gssw_alignment_trace_back_word (gssw_align* alignment,
-                                            uint16_t* score,
+                                            uint32_t* score,
                                             int32_t* refEnd,
                                             int32_t* readEnd,
                                             const char* ref,
@@ -944,60 +1856,118 @@ gssw_cigar* gssw_alignment_trace_back_word (gssw_align* alignment,
                                             int32_t mismatch,
                                             int32_t gap_open,
                                             int32_t gap_extension) {
+    return gssw_alignment_trace_back_new(alignment, score, refEnd, readEnd, ref, read,
+                                         match, mismatch, gap_open, gap_extension);
+}
 
-    uint16_t* mH = (uint16_t*)alignment->mH;
-    int32_t i = *refEnd;
-    int32_t j = *readEnd;
-    // find maximum
-    uint16_t h = mH[readLen*i + j];
-	gssw_cigar* result = (gssw_cigar*)calloc(1, sizeof(gssw_cigar));
-    result->length = 0;
+gssw_cigar* gssw_alignment_trace_back_dword (gssw_align* alignment,
+                                             uint32_t* score,
+                                             int32_t* refEnd,
+                                             int32_t* readEnd,
+                                             const char* ref,
+                                             int32_t refLen,
+                                             const char* read,
+                                             int32_t readLen,
+                                             int32_t match,
+                                             int32_t mismatch,
+                                             int32_t gap_open,
+                                             int32_t gap_extension) {
+    return gssw_alignment_trace_back_new(alignment, score, refEnd, readEnd, ref, read,
+                                         match, mismatch, gap_open, gap_extension);
+}
 
-    while (LIKELY(h != 0 && i >= 0 && j >= 0)) {
-        // look at neighbors
-        int32_t d = 0, l = 0, u = 0;
-        if (i > 0 && j > 0) {
-            d = mH[readLen*(i-1) + (j-1)];
-        }
-        if (i > 0) {
-            l = mH[readLen*(i-1) + j];
-        }
-        if (j > 0) {
-            u = mH[readLen*i + (j-1)];
-        }
-        // get the max of the three directions
-        int32_t n = (l > u ? l : u);
-        n = (h > n ? h : n);
-        //fprintf(stderr, "word (%i, %i) h=%i d=%i l=%i u=%i n=%i\n", i, j, h, d, l, u, n);
-        if (h == n &&
-            ((d + match == h && ref[i] == read[j])
-             || (d == h && (ref[i] == 'N' || read[j] == 'N'))
-             || (d - mismatch == h && ref[i] != read[j]))) {
-            //fprintf(stderr, "(%i, %i) M %c %c\n", i, j, ref[i], read[j]);
-            gssw_cigar_push_back(result, 'M', 1);
-            h = d;
-            --i; --j;
-        } else if (l == n && (l - gap_open == h || l - gap_extension == h)) {
-            //fprintf(stderr, "(%i, %i) D\n", i, j);
-            gssw_cigar_push_back(result, 'D', 1);
-            h = l;
-            --i;
-        } else if (u == n && (u - gap_open == h || u - gap_extension == h)) {
-            //fprintf(stderr, "(%i, %i) I\n", i, j);
-            gssw_cigar_push_back(result, 'I', 1);
-            h = u;
-            --j;
-        } else {
-            break;
-        }
-    }
+/* SSW's strategy for long references: a score-only pass for the end, a pass backwards from it for the beginning, and
+   the cigar from a full fill of the window between them, so that the memory goes with the alignment rather than the
+   reference. */
+gssw_align* gssw_ssw_align (const gssw_profile* prof,
+                            const int8_t* ref,
+                            int32_t refLen,
+                            const uint8_t weight_gapO,
+                            const uint8_t weight_gapE,
+                            const uint8_t flag,
+                            const uint16_t filters,
+                            const int32_t filterd,
+                            const int32_t maskLen) {
+
+	const gssw_kernels* k = &gssw_kernel_table[prof->simd];
+	gssw_fill_settings set = gssw_fill_defaults();
+	gssw_alignment_end* bests;
+	gssw_align t;
+	void* profile;
+	int32_t readLen;
 
-    *score = h;
+	if (maskLen < 15) {
+		fprintf(stderr, "When maskLen < 15, the function ssw_align doesn't return 2nd best alignment information.\n");
+	}
 
-    gssw_reverse_cigar(result);
-    *refEnd = i;
-    *readEnd = j;
-    return result;
+	// the end, keeping only the rolling columns however long the reference
+	gssw_align* r = gssw_fill_store(prof, ref, refLen, weight_gapO, weight_gapE, maskLen, NULL, 0, set);
+	if (!r || r->score1 == 0 || flag == 0 || (flag == 2 && r->score1 < filters)) return r;
+
+	// the beginning: the read reversed from its end against the reference backwards from its end, until the best score
+	// is reached again, at the same score width
+	readLen = r->read_end1 + 1;
+	int8_t* read_reverse = gssw_seq_reverse(prof->read, r->read_end1);
+	memset(&t, 0, sizeof(gssw_align));
+	profile = !read_reverse ? NULL
+	        : r->score_width == 1 ? k->qP_byte(read_reverse, prof->mat, readLen, prof->n, prof->bias, NULL)
+	        : r->score_width == 2 ? k->qP_word(read_reverse, prof->mat, readLen, prof->n, NULL)
+	        : k->qP_dword(read_reverse, prof->mat, readLen, prof->n, NULL);
+	if (!profile) {
+		bests = NULL;
+	} else if (r->score_width == 1) {
+		bests = k->sw_byte(ref, 1, r->ref_end1 + 1, readLen, weight_gapO, weight_gapE, profile, r->score1, prof->bias, 0,
+		                   -1, 0, 0, set, &t, NULL, NULL);
+	} else if (r->score_width == 2) {
+		bests = k->sw_word(ref, 1, r->ref_end1 + 1, readLen, weight_gapO, weight_gapE, profile, r->score1, 0,
+		                   -1, 0, 0, set, &t, NULL, NULL);
+	} else {
+		bests = k->sw_dword(ref, 1, r->ref_end1 + 1, readLen, weight_gapO, weight_gapE, profile, r->score1, 0,
+		                    -1, 0, 0, set, &t, NULL, NULL);
+	}
+	free(profile);
+	free(read_reverse);
+	gssw_align_clear_matrix_and_seed(&t);
+	if (UNLIKELY(!bests)) {
+		// no memory for the backward pass, the end stands without the beginning
+		return r;
+	}
+	r->ref_begin1 = bests[0].ref;
+	r->read_begin1 = r->read_end1 - bests[0].read;
+	free(bests);
+
+	// bit 8 (1) asks for the cigar whatever the filters of bits 6 (4) and 7 (2)
+	if ((1&flag) == 0 && ((7&flag) == 0 || ((2&flag) != 0 && r->score1 < filters)
+	    || ((4&flag) != 0 && (r->ref_end1 - r->ref_begin1 > filterd || r->read_end1 - r->read_begin1 > filterd)))) {
+		return r;
+	}
+
+	// the cigar, from the window between the two, always over direction bits: the walk over H can stop short of the
+	// beginning, and the cigar has to join the two ends
+	int32_t refWin = r->ref_end1 - r->ref_begin1 + 1, readWin = r->read_end1 - r->read_begin1 + 1;
+	gssw_profile* wp = gssw_init(prof->read + r->read_begin1, readWin, prof->mat, prof->n, r->score_width == 1 ? 0 : 1);
+	gssw_align* w = wp ? gssw_fill_store(wp, ref + r->ref_begin1, refWin, weight_gapO, weight_gapE, 0, NULL, 2, set)
+	                   : NULL;
+	if (!w) {
+		// no memory for the matrix of the window, the ends stand without the cigar
+		if (wp) gssw_init_destroy(wp);
+		return r;
+	}
+	// the walk over the direction bits reads neither the letters nor the scores
+	uint32_t score;
+	int32_t refEnd = refWin - 1, readEnd = readWin - 1;
+	gssw_cigar* c = gssw_alignment_trace_back_new(w, &score, &refEnd, &readEnd, NULL, NULL, 0, 0, weight_gapO,
+	                                              weight_gapE);
+	if (c && w->score1 == r->score1 && refEnd == -1 && readEnd == -1) {
+		r->cigar = gssw_cigar_to_bam(c, NULL);
+		r->cigarLen = c->length;
+	}
+	// otherwise the window does not give the best alignment from the corner to the corner, and the ends of the two
+	// passes stand without the cigar
+	gssw_cigar_destroy(c);
+	gssw_align_destroy(w);
+	gssw_init_destroy(wp);
+	return r;
 }
 
 gssw_graph_mapping* gssw_graph_mapping_create(void) {
@@ -1008,6 +1978,7 @@ gssw_graph_mapping* gssw_graph_mapping_create(void) {
 void gssw_graph_mapping_destroy(gssw_graph_mapping* m) {
     int32_t i;
     gssw_graph_cigar* g = &m->cigar;
+    if (m->arena) return; // goes with its arena
     for (i = 0; i < g->length; ++i) {
         gssw_cigar_destroy(g->elements[i].cigar);
     }
@@ -1067,25 +2038,30 @@ char* gssw_graph_mapping_to_string(gssw_graph_mapping* gm) {
 }
 */
 
+// in place, so that cigars in an arena can be reversed too
 void gssw_reverse_graph_cigar(gssw_graph_cigar* c) {
-	gssw_graph_cigar* reversed = (gssw_graph_cigar*)malloc(sizeof(gssw_graph_cigar));
-    reversed->length = c->length;
-	reversed->elements = (gssw_node_cigar*) malloc(c->length * sizeof(gssw_node_cigar));
     gssw_node_cigar* c1 = c->elements;
-    gssw_node_cigar* c2 = reversed->elements;
 	int32_t s = 0;
 	int32_t e = c->length - 1;
-	while (LIKELY(s <= e)) {
-		c2[s] = c1[e];
-		c2[e] = c1[s];
+	while (LIKELY(s < e)) {
+		gssw_node_cigar t = c1[s];
+		c1[s] = c1[e];
+		c1[e] = t;
 		++ s;
 		-- e;
 	}
-    free(c->elements);
-    c->elements = reversed->elements;
-    free(reversed);
 }
 
+static gssw_graph_mapping* gssw_graph_trace_back_in (gssw_graph* graph,
+                                                     const char* read,
+                                                     int32_t readLen,
+                                                     int32_t match,
+                                                     int32_t mismatch,
+                                                     int32_t gap_open,
+                                                     int32_t gap_extension,
+                                                     gssw_graph_context* ctx,
+                                                     gssw_arena* arena);
+
 gssw_graph_mapping* gssw_graph_trace_back (gssw_graph* graph,
                                            const char* read,
                                            int32_t readLen,
@@ -1093,29 +2069,112 @@ gssw_graph_mapping* gssw_graph_trace_back (gssw_graph* graph,
                                            int32_t mismatch,
                                            int32_t gap_open,
                                            int32_t gap_extension) {
+    return gssw_graph_trace_back_in(graph, read, readLen, match, mismatch, gap_open, gap_extension, NULL, NULL);
+}
+
+gssw_graph_mapping* gssw_graph_trace_back_arena (gssw_graph* graph,
+                                                 const char* read,
+                                                 int32_t readLen,
+                                                 int32_t match,
+                                                 int32_t mismatch,
+                                                 int32_t gap_open,
+                                                 int32_t gap_extension,
+                                                 gssw_arena* arena) {
+    return gssw_graph_trace_back_in(graph, read, readLen, match, mismatch, gap_open, gap_extension, NULL, arena);
+}
 
-    gssw_graph_mapping* gm = gssw_graph_mapping_create();
+gssw_graph_mapping* gssw_graph_trace_back_context (gssw_graph_context* ctx,
+                                                   const char* read,
+                                                   int32_t readLen,
+                                                   int32_t match,
+                                                   int32_t mismatch,
+                                                   int32_t gap_open,
+                                                   int32_t gap_extension) {
+    return gssw_graph_trace_back_in((gssw_graph*)ctx->graph, read, readLen, match, mismatch, gap_open, gap_extension,
+                                    ctx, NULL);
+}
+
+/* The predecessor of n in which a traceback over direction bits goes on when it leaves n from cell (0, j) by move out:
+   the one whose seed gave that cell its diagonal (H at j - 1) or its E (at j), first among equals.  0 if the alignment
+   begins in n. */
+static gssw_node* gssw_dir_prev (gssw_graph_context* ctx, const gssw_node* n, int32_t out, int32_t j) {
+    gssw_node* best = NULL;
+    uint32_t best_score = 0;
+    int32_t k;
+    if (out == GSSW_DIR_DIAG) --j;
+    for (k = 0; k < n->count_prev; ++k) {
+        const gssw_align* a = gssw_node_align(ctx, n->prev[k]);
+        uint32_t v;
+        if (!a || !a->mD) continue;
+        v = gssw_seed_cell(a, out == GSSW_DIR_DIAG ? a->seed.pvHStore : a->seed.pvE, j);
+        if (v > best_score) {
+            best_score = v;
+            best = n->prev[k];
+        }
+    }
+    return best;
+}
+
+static gssw_graph_mapping* gssw_graph_trace_back_in (gssw_graph* graph,
+                                                     const char* read,
+                                                     int32_t readLen,
+                                                     int32_t match,
+                                                     int32_t mismatch,
+                                                     int32_t gap_open,
+                                                     int32_t gap_extension,
+                                                     gssw_graph_context* ctx,
+                                                     gssw_arena* arena) {
+
+    gssw_graph_mapping* gm;
+    if (arena) {
+        gm = (gssw_graph_mapping*)gssw_arena_alloc(arena, sizeof(gssw_graph_mapping));
+        if (UNLIKELY(!gm)) return NULL;
+        memset(gm, 0, sizeof(gssw_graph_mapping));
+        gm->arena = arena;
+    } else {
+        gm = gssw_graph_mapping_create();
+    }
     gssw_graph_cigar* gc = &gm->cigar;
     uint32_t graph_cigar_bufsiz = 16;
     gc->elements = NULL;
-    gc->elements = realloc((void*) gc->elements, graph_cigar_bufsiz * sizeof(gssw_node_cigar));
+    gc->elements = gssw_arena_realloc(arena, (void*) gc->elements, 0, graph_cigar_bufsiz * sizeof(gssw_node_cigar));
     gc->length = 0;
+    if (UNLIKELY(!gc->elements)) {
+        gssw_graph_mapping_destroy(gm);
+        return NULL;
+    }
 
-    gssw_node* n = graph->max_node;
+    gssw_node* n = ctx ? ctx->max_node : graph->max_node;
+    const gssw_node_alignment_end* second_best = ctx ? &ctx->second_best : &graph->second_best;
     if (!n) {
-        fprintf(stderr, "error:[gssw] Cannot trace back because graph alignment has not been run.\n");
-        fprintf(stderr, "error:[gssw] You must call graph_fill(...) before tracing back.\n");
-        exit(1);
+        fprintf(stderr, "error:[gssw] Cannot trace back: the graph has not been filled, or its last fill failed.\n");
+        gssw_graph_mapping_destroy(gm);
+        return NULL;
+    }
+    const gssw_align* best = gssw_node_align(ctx, n);
+    if (!best->mH && !best->mD && !best->ckpt.pv && !best->packed.m && best->score1) {
+        fprintf(stderr, "error:[gssw] Cannot trace back a score-only fill (gssw_graph_fill_score).\n");
+        gssw_graph_mapping_destroy(gm);
+        return NULL;
     }
-    uint16_t score = n->alignment->score1;
+    uint32_t score = best->score1;
     gm->score = score;
-    uint8_t score_is_byte = gssw_is_byte(n->alignment);
-    int32_t refEnd = n->alignment->ref_end1;
-    int32_t readEnd = n->alignment->read_end1;
+    gm->score2 = second_best->end.score;
+    gm->node2 = second_best->node;
+    gm->ref_end2 = second_best->end.ref;
+    int32_t refEnd = best->ref_end1;
+    int32_t readEnd = best->read_end1;
     //fprintf(stderr, "ref_end1 %i read_end1 %i\n", refEnd, readEnd);
 
-    // node cigar
+    // node cigar, built back to front as the traceback walks; failed once something could not be allocated
     gssw_node_cigar* nc = gc->elements;
+    int8_t failed = 0;
+    gssw_cigar_builder b = { NULL, 0, 0, arena, 0 };
+    gssw_tb_cache t = GSSW_TB_CACHE_INIT;
+
+    // over direction bits (GSSW_MATRIX_DIR) the path is read off the bits, state and move out of each node included
+    int8_t dir = best->mD != NULL;
+    int32_t state = GSSW_TB_H, out = 0;
 
     // get terminal soft clipping
     int32_t end_soft_clip = 0;
@@ -1128,39 +2187,50 @@ gssw_graph_mapping* gssw_graph_trace_back (gssw_graph* graph,
     while (score > 0) {
 
         if (gc->length == graph_cigar_bufsiz) {
+            gssw_node_cigar* e = gssw_arena_realloc(arena, (void*) gc->elements, gc->length * sizeof(gssw_node_cigar),
+                                                    2 * graph_cigar_bufsiz * sizeof(gssw_node_cigar));
+            if (UNLIKELY(!e)) {
+                failed = 1;
+                break;
+            }
+            gc->elements = e;
             graph_cigar_bufsiz *= 2;
-            gc->elements = realloc((void*) gc->elements, graph_cigar_bufsiz * sizeof(gssw_node_cigar));
         }
 
         // write the cigar to the current node
         nc = gc->elements + gc->length;
         //fprintf(stderr, "id=%i\n", n->id);
-        nc->cigar = gssw_alignment_trace_back (n->alignment,
-                                               &score,
-                                               &refEnd,
-                                               &readEnd,
-                                               n->seq,
-                                               n->len,
-                                               read,
-                                               readLen,
-                                               match,
-                                               mismatch,
-                                               gap_open,
-                                               gap_extension);
-
         if (end_soft_clip) {
-            gssw_cigar_push_back(nc->cigar, 'S', end_soft_clip);
+            gssw_cigar_builder_prepend(&b, 'S', end_soft_clip);
             end_soft_clip = 0;
         }
-        
-        nc->node = n;
-        ++gc->length;
-        //fprintf(stderr, "score is %u as we end node %p %u at position %i in read and %i in ref\n", score, n, n->id, readEnd, refEnd);
-        if (score == 0 || refEnd > 0) {
+
+        if (dir) {
+            out = gssw_dir_trace_back(gssw_node_align(ctx, n), &refEnd, &readEnd, &state, &b);
+        } else {
+            gssw_alignment_trace_back_cells (gssw_node_align(ctx, n),
+                                             &score,
+                                             &refEnd,
+                                             &readEnd,
+                                             n->seq,
+                                             read,
+                                             match,
+                                             mismatch,
+                                             gap_open,
+                                             gap_extension,
+                                             &t,
+                                             &b);
+        }
+
+        nc->node = n;
+        ++gc->length;
+        //fprintf(stderr, "score is %u as we end node %p %u at position %i in read and %i in ref\n", score, n, n->id, readEnd, refEnd);
+        if (dir ? !out : (score == 0 || refEnd > 0)) {
             if (readEnd > -1) {
                 //fprintf(stderr, "soft clipping %i\n", readEnd+1);
-                gssw_cigar_push_front(nc->cigar, 'S', readEnd+1);
+                gssw_cigar_builder_prepend(&b, 'S', readEnd+1);
             }
+            nc->cigar = gssw_cigar_builder_finish(&b);
             break;
         }
         // the read did not complete here
@@ -1175,7 +2245,7 @@ gssw_graph_mapping* gssw_graph_trace_back (gssw_graph* graph,
         // so check its inbound nodes at the given read end position
         int32_t i;
         gssw_node* max_prev = NULL;
-        uint16_t l = 0, d = 0, max_score = 0;
+        uint32_t l = 0, d = 0, max_score = 0;
         uint8_t max_diag = 1;
 
         // determine direction across edge
@@ -1183,36 +2253,15 @@ gssw_graph_mapping* gssw_graph_trace_back (gssw_graph* graph,
         // rationale: we have to check the left and diagonal directions
         // vertical would stay on this node even if we are in the last column
 
-        // note that the loop is split depending on alignment score width...
-        // this is done out of paranoia that optimization will not factor two loops into two if there
-        // is an if statement with a consistent result inside of each iteration
-        if (score_is_byte) {
-            for (i = 0; i < n->count_prev; ++i) {
-                gssw_node* cn = n->prev[i];
-                l = ((uint8_t*)cn->alignment->mH)[readLen*(cn->len-1) + readEnd];
-                d = ((uint8_t*)cn->alignment->mH)[readLen*(cn->len-1) + (readEnd-1)];
-                /*
-                char t = cn->seq[cn->len-1];
-                char q = read[readEnd-1];
-                fprintf(stderr, "score=%i t=%c q=%c d=%i l=%i h=%i max_score=%i id=%i\n",
-                        score, t, q, d, l, score, max_score, cn->id);
-                */
-                bool possible_gap = (score + gap_extension == l || score + gap_open == l);
-                if ((!possible_gap || d >= l) && d > max_score) {
-                    max_score = d;
-                    max_prev = cn;
-                    max_diag = 1;
-                } else if (l > d && l > max_score && possible_gap) {
-                    max_score = l;
-                    max_prev = cn;
-                    max_diag = 0;
-                }
-            }
+        // predecessors may have been filled at a different score width than this node
+        if (dir) {
+            max_prev = gssw_dir_prev(ctx, n, out, readEnd);
+            max_diag = out == GSSW_DIR_DIAG;
         } else {
             for (i = 0; i < n->count_prev; ++i) {
                 gssw_node* cn = n->prev[i];
-                l = ((uint16_t*)cn->alignment->mH)[readLen*(cn->len-1) + readEnd];
-                d = ((uint16_t*)cn->alignment->mH)[readLen*(cn->len-1) + (readEnd-1)];
+                l = gssw_mH_cell(&t, gssw_node_align(ctx, cn), cn->len-1, readEnd);
+                d = readEnd > 0 ? gssw_mH_cell(&t, gssw_node_align(ctx, cn), cn->len-1, readEnd-1) : 0;
                 bool possible_gap = (score + gap_extension == l || score + gap_open == l);
                 if ((!possible_gap || d >= l) && d > max_score) {
                     max_score = d;
@@ -1233,21 +2282,32 @@ gssw_graph_mapping* gssw_graph_trace_back (gssw_graph* graph,
         // go to ending position, look at neighbors across all inbound nodes
         //fprintf(stderr, "max_prev = %p, node = %p\n", max_prev, n);
         if (max_prev) {
+            gssw_matrix_release(&t);
             n = max_prev;
             // update ref end repeat
             refEnd = n->len - 1;
             if (max_diag) {
                 --readEnd;
                 //fprintf(stderr, "M\n");
-                gssw_cigar_push_front(nc->cigar, 'M', 1);
+                gssw_cigar_builder_prepend(&b, 'M', 1);
             } else {
                 //fprintf(stderr, "D\n");
-                gssw_cigar_push_front(nc->cigar, 'D', 1);
+                gssw_cigar_builder_prepend(&b, 'D', 1);
             }
-            ++nc;
+            if (dir) state = max_diag || gssw_mD_cell(gssw_node_align(ctx, n), refEnd, readEnd) & GSSW_DIR_E_OPEN
+                             ? GSSW_TB_H : GSSW_TB_E;
+            nc->cigar = gssw_cigar_builder_finish(&b);
+            if (UNLIKELY(!nc->cigar)) break;
         } else {
+            if (out == GSSW_DIR_DIAG) {
+                // the alignment begins with cell (0, readEnd), on a predecessor cell scoring 0
+                gssw_cigar_builder_prepend(&b, 'M', 1);
+                --readEnd;
+                refEnd = -1;
+            }
             //fprintf(stderr, "soft clip of %i\n", readEnd+1);
-            gssw_cigar_push_front(nc->cigar, 'S', readEnd+1);
+            gssw_cigar_builder_prepend(&b, 'S', readEnd+1);
+            nc->cigar = gssw_cigar_builder_finish(&b);
             break;
         }
 
@@ -1255,6 +2315,13 @@ gssw_graph_mapping* gssw_graph_trace_back (gssw_graph* graph,
 
     //fprintf(stderr, "at end of traceback loop\n");
     // 
+    gssw_matrix_release(&t);
+    if (UNLIKELY(failed || t.failed || (gc->length && !gc->elements[gc->length - 1].cigar))) {
+        b.failed = 1;
+        gssw_cigar_builder_finish(&b); // lets go of the cigar left unfinished
+        gssw_graph_mapping_destroy(gm);
+        return NULL;
+    }
     gssw_reverse_graph_cigar(gc);
 
     gm->position = (refEnd +1 < 0 ? 0 : refEnd +1); // drop last step by -1 on ref position
@@ -1263,73 +2330,66 @@ gssw_graph_mapping* gssw_graph_trace_back (gssw_graph* graph,
 
 }
 
+/* both ends merge runs in place and grow the elements geometrically, tracked by capacity */
+static void gssw_cigar_reserve (gssw_cigar* c, int32_t length) {
+    if (c->capacity < length) {
+        int32_t capacity = c->capacity > c->length ? c->capacity : c->length;
+        capacity = capacity ? 2 * capacity : 4;
+        if (capacity < length) capacity = length;
+        c->elements = (gssw_cigar_element*) realloc(c->elements, capacity * sizeof(gssw_cigar_element));
+        c->capacity = capacity;
+    }
+}
+
 void gssw_cigar_push_back(gssw_cigar* c, char type, uint32_t length) {
-    if (c->length == 0) {
-        c->length = 1;
-        c->elements = (gssw_cigar_element*) malloc(c->length * sizeof(gssw_cigar_element));
-        c->elements[0].type = type;
-        c->elements[0].length = length;
-    } else if (type != c->elements[c->length - 1].type) {
+    if (c->length == 0 || type != c->elements[c->length - 1].type) {
+        gssw_cigar_reserve(c, c->length + 1);
+        c->elements[c->length].type = type;
+        c->elements[c->length].length = length;
         c->length++;
-        // change to not realloc every single freakin time
-        // but e.g. on doubling
-        c->elements = (gssw_cigar_element*) realloc(c->elements, c->length * sizeof(gssw_cigar_element));
-        c->elements[c->length - 1].type = type;
-        c->elements[c->length - 1].length = length;
     } else {
         c->elements[c->length - 1].length += length;
     }
 }
 
 void gssw_cigar_push_front(gssw_cigar* c, char type, uint32_t length) {
-    gssw_reverse_cigar(c);
-    gssw_cigar_push_back(c, type, length);
-    gssw_reverse_cigar(c);
-    /*
-    if (c->length == 0) {
-        c->length = 1;
-        c->elements = (gssw_cigar_element*) malloc(c->length * sizeof(gssw_cigar_element));
+    if (c->length == 0 || type != c->elements[0].type) {
+        gssw_cigar_reserve(c, c->length + 1);
+        memmove(c->elements + 1, c->elements, c->length * sizeof(gssw_cigar_element));
         c->elements[0].type = type;
         c->elements[0].length = length;
-    } else if (type != c->elements[0].type) {
         c->length++;
-        // change to not realloc every single freakin time
-        // but e.g. on doubling
-        c->elements = (gssw_cigar_element*) realloc(c->elements, c->length * sizeof(gssw_cigar_element));
-        //gssw_cigar_element* new = (gssw_cigar_element*) malloc(c->length * sizeof(gssw_cigar_element));
-        //(gssw_cigar_element*) memcpy(new + sizeof(gssw_cigar_element), c->elements, c->length-1 * sizeof(gssw_cigar_element));
-        //free(c->elements);
-        int32_t i;
-        for (i = c->length-1; i > 1; --i) {
-            c->elements[i].type = c->elements[i-1].type;
-            c->elements[i].length = c->elements[i-1].length;
-        }
-        c->elements[0].type = type;
-        c->elements[0].length = length;
     } else {
         c->elements[0].length += length;
     }
-    */
+}
+
+uint32_t* gssw_cigar_to_bam (const gssw_cigar* c, uint32_t* ops) {
+    static const char codes[] = "MIDNSHP=X";
+    int32_t i;
+    if (!ops) ops = (uint32_t*) malloc((c->length ? c->length : 1) * sizeof(uint32_t));
+    for (i = 0; i < c->length; ++i) {
+        const char* op = c->elements[i].type ? strchr(codes, c->elements[i].type) : NULL;
+        if (UNLIKELY(!op)) {
+            fprintf(stderr, "error:[gssw] Cigar operation '%c' has no BAM code.\n", c->elements[i].type);
+            exit(1);
+        }
+        ops[i] = c->elements[i].length << 4 | (uint32_t)(op - codes);
+    }
+    return ops;
 }
 
 void gssw_reverse_cigar(gssw_cigar* c) {
-    if (!c->length) return; // bail out
-	gssw_cigar* reversed = (gssw_cigar*)malloc(sizeof(gssw_cigar));
-    reversed->length = c->length;
-	reversed->elements = (gssw_cigar_element*) malloc(c->length * sizeof(gssw_cigar_element));
     gssw_cigar_element* c1 = c->elements;
-    gssw_cigar_element* c2 = reversed->elements;
 	int32_t s = 0;
 	int32_t e = c->length - 1;
-	while (LIKELY(s <= e)) {
-		c2[s] = c1[e];
-		c2[e] = c1[s];
+	while (LIKELY(s < e)) {
+		gssw_cigar_element t = c1[s];
+		c1[s] = c1[e];
+		c1[e] = t;
 		++ s;
 		-- e;
 	}
-    free(c->elements);
-    c->elements = reversed->elements;
-    free(reversed);
 }
 
 void gssw_print_cigar(gssw_cigar* c) {
@@ -1342,6 +2402,7 @@ void gssw_print_cigar(gssw_cigar* c) {
 }
 
 void gssw_cigar_destroy(gssw_cigar* c) {
+    if (!c) return;
     free(c->elements);
     c->elements = NULL;
     free(c);
@@ -1374,6 +2435,28 @@ gssw_node* gssw_node_create(void* data,
     return n;
 }
 
+gssw_node* gssw_node_create_arena(void* data,
+                                  const uint32_t id,
+                                  const char* seq,
+                                  const int8_t* nt_table,
+                                  const int8_t* score_matrix,
+                                  gssw_arena* arena) {
+    gssw_node* n = (gssw_node*)gssw_arena_alloc(arena, sizeof(gssw_node));
+    int32_t len = strlen(seq), m;
+    if (UNLIKELY(!n)) return NULL;
+    memset(n, 0, sizeof(gssw_node));
+    n->id = id;
+    n->len = len;
+    n->seq = (char*)gssw_arena_alloc(arena, len+1);
+    n->num = (int8_t*)gssw_arena_alloc(arena, len);
+    if (UNLIKELY(!n->seq || !n->num)) return NULL;
+    memcpy(n->seq, seq, len); n->seq[len] = 0;
+    n->data = data;
+    for (m = 0; m < len; ++m) n->num[m] = nt_table[(int)seq[m]];
+    n->arena = arena;
+    return n;
+}
+
 // for reuse of graph through multiple alignments
 void gssw_node_clear_alignment(gssw_node* n) {
     gssw_align_destroy(n->alignment);
@@ -1383,10 +2466,17 @@ void gssw_node_clear_alignment(gssw_node* n) {
 void gssw_profile_destroy(gssw_profile* prof) {
     free(prof->profile_byte);
     free(prof->profile_word);
+    free(prof->profile_dword);
+    free(prof->profile_band);
     free(prof);
 }
 
 void gssw_node_destroy(gssw_node* n) {
+    if (n->arena) {
+        // the alignment is recycled across fills rather than kept in the arena, the rest goes with the arena
+        if (n->alignment) gssw_align_destroy(n->alignment);
+        return;
+    }
     free(n->seq);
     free(n->num);
     free(n->prev);
@@ -1401,15 +2491,24 @@ void gssw_node_destroy(gssw_node* n) {
 //    align_clear_matrix_and_seed(n->alignment);
 //}
 
+/* room for one more edge after count of them; edges in an arena double their array when count is a power of 2,
+   elsewhere the heap takes care of it */
+static gssw_node** gssw_node_grow_edges(gssw_node* n, gssw_node** edges, int32_t count) {
+    if (!n->arena) return (gssw_node**)realloc(edges, (count + 1)*sizeof(gssw_node*));
+    if (count & (count - 1)) return edges;
+    return (gssw_node**)gssw_arena_realloc(n->arena, edges, count*sizeof(gssw_node*),
+                                           (count ? 2*count : 1)*sizeof(gssw_node*));
+}
+
 void gssw_node_add_prev(gssw_node* n, gssw_node* m) {
+    n->prev = gssw_node_grow_edges(n, n->prev, n->count_prev);
     ++n->count_prev;
-    n->prev = (gssw_node**)realloc(n->prev, n->count_prev*sizeof(gssw_node*));
     n->prev[n->count_prev -1] = m;
 }
 
 void gssw_node_add_next(gssw_node* n, gssw_node* m) {
+    n->next = gssw_node_grow_edges(n, n->next, n->count_next);
     ++n->count_next;
-    n->next = (gssw_node**)realloc(n->next, n->count_next*sizeof(gssw_node*));
     n->next[n->count_next -1] = m;
 }
 
@@ -1427,32 +2526,25 @@ void gssw_nodes_add_edge(gssw_node* n, gssw_node* m) {
     gssw_node_add_prev(m, n);
 }
 
+// edges are removed in place, the arrays keep their room (which the arena growth above relies on)
 void gssw_node_del_prev(gssw_node* n, gssw_node* m) {
-    gssw_node** x = (gssw_node**)malloc(n->count_prev*sizeof(gssw_node*));
-    int i = 0;
-    gssw_node** np = n->prev;
-    for ( ; i < n->count_prev; ++i, ++np) {
-        if (*np != m) {
-            x[i] = *np;
+    int i = 0, j = 0;
+    for ( ; i < n->count_prev; ++i) {
+        if (n->prev[i] != m) {
+            n->prev[j++] = n->prev[i];
         }
     }
-    free(n->prev);
-    n->prev = x;
-    --n->count_prev;
+    n->count_prev = j;
 }
 
 void gssw_node_del_next(gssw_node* n, gssw_node* m) {
-    gssw_node** x = (gssw_node**)malloc(n->count_next*sizeof(gssw_node*));
-    int i = 0;
-    gssw_node** nn = n->next;
-    for ( ; i < n->count_next; ++i, ++nn) {
-        if (*nn != m) {
-            x[i] = *nn;
+    int i = 0, j = 0;
+    for ( ; i < n->count_next; ++i) {
+        if (n->next[i] != m) {
+            n->next[j++] = n->next[i];
         }
     }
-    free(n->next);
-    n->next = x;
-    --n->count_next;
+    n->count_next = j;
 }
 
 void gssw_nodes_del_edge(gssw_node* n, gssw_node* m) {
@@ -1481,70 +2573,53 @@ void gssw_node_replace_next(gssw_node* n, gssw_node* m, gssw_node* p) {
 }
 
 gssw_seed* gssw_create_seed_byte(int32_t readLen, gssw_node** prev, int32_t count) {
-    int32_t j = 0, k = 0;
-    for (k = 0; k < count; ++k) {
-        if (!prev[k]->alignment) {
-            fprintf(stderr, "cannot align because node predecessors cannot provide seed\n");
-            fprintf(stderr, "failing is node %u\n", prev[k]->id);
-            exit(1);
-        }
-    }
-
-    __m128i vZero = _mm_set1_epi32(0);
-	int32_t segLen = (readLen + 15) / 16;
-    gssw_seed* seed = (gssw_seed*)calloc(1, sizeof(gssw_seed));
-    if (!(!posix_memalign((void**)&seed->pvE,      sizeof(__m128i), segLen*sizeof(__m128i)) &&
-          !posix_memalign((void**)&seed->pvHStore, sizeof(__m128i), segLen*sizeof(__m128i)))) {
-        fprintf(stderr, "error:[gssw] Could not allocate memory for alignment seed\n"); exit(1);
-        exit(1);
-    }
-    memset(seed->pvE,      0, segLen*sizeof(__m128i));
-    memset(seed->pvHStore, 0, segLen*sizeof(__m128i));
-    // take the max of all inputs
-    __m128i pvE = vZero, pvH = vZero, ovE = vZero, ovH = vZero;
-    for (j = 0; j < segLen; ++j) {
-        pvE = vZero; pvH = vZero;
-        for (k = 0; k < count; ++k) {
-            ovE = _mm_load_si128(prev[k]->alignment->seed.pvE + j);
-            ovH = _mm_load_si128(prev[k]->alignment->seed.pvHStore + j);
-            pvE = _mm_max_epu8(pvE, ovE);
-            pvH = _mm_max_epu8(pvH, ovH);
-        }
-        _mm_store_si128(seed->pvHStore + j, pvH);
-        _mm_store_si128(seed->pvE + j, pvE);
-    }
-    return seed;
+    gssw_node n = { .prev = prev, .count_prev = count };
+    return gssw_node_seed(&gssw_kernel_table[gssw_simd_get()], 1, readLen, NULL, &n, NULL);
 }
 
 gssw_seed* gssw_create_seed_word(int32_t readLen, gssw_node** prev, int32_t count) {
-    int32_t j = 0, k = 0;
-    __m128i vZero = _mm_set1_epi32(0);
-	int32_t segLen = (readLen + 7) / 8;
-    gssw_seed* seed = (gssw_seed*)calloc(1, sizeof(gssw_seed));
-    if (!(!posix_memalign((void**)&seed->pvE,      sizeof(__m128i), segLen*sizeof(__m128i)) &&
-          !posix_memalign((void**)&seed->pvHStore, sizeof(__m128i), segLen*sizeof(__m128i)))) {
-        fprintf(stderr, "error:[gssw] Could not allocate memory for alignment seed\n"); exit(1);
-        exit(1);
-    }
-    memset(seed->pvE,      0, segLen*sizeof(__m128i));
-    memset(seed->pvHStore, 0, segLen*sizeof(__m128i));
-    // take the max of all inputs
-    __m128i pvE = vZero, pvH = vZero, ovE = vZero, ovH = vZero;
-    for (j = 0; j < segLen; ++j) {
-        pvE = vZero; pvH = vZero;
-        for (k = 0; k < count; ++k) {
-            ovE = _mm_load_si128(prev[k]->alignment->seed.pvE + j);
-            ovH = _mm_load_si128(prev[k]->alignment->seed.pvHStore + j);
-            pvE = _mm_max_epu16(pvE, ovE);
-            pvH = _mm_max_epu16(pvH, ovH);
+    gssw_node n = { .prev = prev, .count_prev = count };
+    return gssw_node_seed(&gssw_kernel_table[gssw_simd_get()], 2, readLen, NULL, &n, NULL);
+}
+
+gssw_seed* gssw_create_seed_dword(int32_t readLen, gssw_node** prev, int32_t count) {
+    gssw_node n = { .prev = prev, .count_prev = count };
+    return gssw_node_seed(&gssw_kernel_table[gssw_simd_get()], 4, readLen, NULL, &n, NULL);
+}
+
+
+static int8_t gssw_fill_width (const int8_t* num, const int32_t len, gssw_align** slot, const gssw_profile* prof,
+                               const uint8_t weight_gapO, const uint8_t weight_gapE, const int32_t maskLen,
+                               const gssw_seed* seed, const uint8_t width, const int32_t xdrop, const uint32_t xbest,
+                               const int8_t store_mH, gssw_fill_settings set, gssw_workspace* ws);
+
+/* gssw_fill_width of node n, into its alignment in context ctx (or its own without one) */
+static inline int8_t gssw_node_fill_width (gssw_node* node, const gssw_profile* prof, const uint8_t weight_gapO,
+                                           const uint8_t weight_gapE, const int32_t maskLen, const gssw_seed* seed,
+                                           const uint8_t width, const int32_t xdrop, const uint32_t xbest,
+                                           const int8_t store_mH, gssw_fill_settings set, gssw_workspace* ws,
+                                           gssw_graph_context* ctx) {
+    return gssw_fill_width(node->num, node->len, gssw_node_slot(ctx, node), prof, weight_gapO, weight_gapE, maskLen,
+                           seed, width, xdrop, xbest, store_mH, set, ws);
+}
+
+/* highest H or E score a seed of the given width carries into a node (padding lanes included) */
+static uint32_t gssw_seed_max (const gssw_seed* seed, int32_t readLen, uint8_t width, int32_t vsize) {
+    int32_t lanes = vsize / width;
+    int32_t r, n = (readLen + lanes - 1) / lanes * lanes;
+    uint32_t m = 0, h, e;
+    for (r = 0; r < n; ++r) {
+        switch (width) {
+        case 1: h = ((uint8_t*)seed->pvHStore)[r]; e = ((uint8_t*)seed->pvE)[r]; break;
+        case 2: h = ((uint16_t*)seed->pvHStore)[r]; e = ((uint16_t*)seed->pvE)[r]; break;
+        default: h = ((uint32_t*)seed->pvHStore)[r]; e = ((uint32_t*)seed->pvE)[r]; break;
         }
-        _mm_store_si128(seed->pvHStore + j, pvH);
-        _mm_store_si128(seed->pvE + j, pvE);
+        if (h > m) m = h;
+        if (e > m) m = e;
     }
-    return seed;
+    return m;
 }
 
-
 gssw_graph*
 gssw_graph_fill (gssw_graph* graph,
                  const char* read_seq,
@@ -1554,45 +2629,672 @@ gssw_graph_fill (gssw_graph* graph,
                  const uint8_t weight_gapE,
                  const int32_t maskLen,
                  const int8_t score_size) {
+    return gssw_graph_fill_xdrop(graph, read_seq, nt_table, score_matrix, weight_gapO, weight_gapE, maskLen,
+                                 score_size, -1);
+}
 
-    int32_t read_length = strlen(read_seq);
-    int8_t* read_num = gssw_create_num(read_seq, read_length, nt_table);
-	gssw_profile* prof = gssw_init(read_num, read_length, score_matrix, 5, score_size);
-    gssw_seed* seed = NULL;
-    uint16_t max_score = 0;
+static gssw_graph*
+gssw_graph_fill_nodes (gssw_graph* graph,
+                       const char* read_seq,
+                       const int8_t* nt_table,
+                       const int8_t* score_matrix,
+                       const uint8_t weight_gapO,
+                       const uint8_t weight_gapE,
+                       const int32_t maskLen,
+                       const int8_t score_size,
+                       const int32_t xdrop,
+                       const int8_t store_mH,
+                       gssw_workspace* ws,
+                       gssw_graph_context* ctx,
+                       const int32_t threads);
+
+gssw_graph*
+gssw_graph_fill_xdrop (gssw_graph* graph,
+                       const char* read_seq,
+                       const int8_t* nt_table,
+                       const int8_t* score_matrix,
+                       const uint8_t weight_gapO,
+                       const uint8_t weight_gapE,
+                       const int32_t maskLen,
+                       const int8_t score_size,
+                       const int32_t xdrop) {
+    return gssw_graph_fill_nodes(graph, read_seq, nt_table, score_matrix, weight_gapO, weight_gapE, maskLen,
+                                 score_size, xdrop, 1, NULL, NULL, 1);
+}
+
+gssw_graph*
+gssw_graph_fill_ws (gssw_graph* graph,
+                    const char* read_seq,
+                    const int8_t* nt_table,
+                    const int8_t* score_matrix,
+                    const uint8_t weight_gapO,
+                    const uint8_t weight_gapE,
+                    const int32_t maskLen,
+                    const int8_t score_size,
+                    const int32_t xdrop,
+                    gssw_workspace* ws) {
+    gssw_workspace_reset(ws);
+    return gssw_graph_fill_nodes(graph, read_seq, nt_table, score_matrix, weight_gapO, weight_gapE, maskLen,
+                                 score_size, xdrop, 1, ws, NULL, 1);
+}
+
+#define GSSW_FILL_CONE 2 // store_mH of gssw_graph_fill_nodes for gssw_graph_fill_cone
+
+gssw_graph*
+gssw_graph_fill_cone (gssw_graph* graph,
+                      const char* read_seq,
+                      const int8_t* nt_table,
+                      const int8_t* score_matrix,
+                      const uint8_t weight_gapO,
+                      const uint8_t weight_gapE,
+                      const int32_t maskLen,
+                      const int8_t score_size) {
+    return gssw_graph_fill_nodes(graph, read_seq, nt_table, score_matrix, weight_gapO, weight_gapE, maskLen,
+                                 score_size, -1, GSSW_FILL_CONE, NULL, NULL, 1);
+}
+
+gssw_graph*
+gssw_graph_fill_parallel (gssw_graph* graph,
+                          const char* read_seq,
+                          const int8_t* nt_table,
+                          const int8_t* score_matrix,
+                          const uint8_t weight_gapO,
+                          const uint8_t weight_gapE,
+                          const int32_t maskLen,
+                          const int8_t score_size,
+                          const int32_t threads) {
+    return gssw_graph_fill_nodes(graph, read_seq, nt_table, score_matrix, weight_gapO, weight_gapE, maskLen,
+                                 score_size, -1, 1, NULL, NULL, threads);
+}
+
+gssw_graph_context*
+gssw_graph_fill_context (gssw_graph_context* ctx,
+                         const char* read_seq,
+                         const int8_t* nt_table,
+                         const int8_t* score_matrix,
+                         const uint8_t weight_gapO,
+                         const uint8_t weight_gapE,
+                         const int32_t maskLen,
+                         const int8_t score_size) {
+    return gssw_graph_fill_nodes((gssw_graph*)ctx->graph, read_seq, nt_table, score_matrix, weight_gapO, weight_gapE,
+                                 maskLen, score_size, -1, 1, NULL, ctx, 1) ? ctx : NULL;
+}
+
+gssw_graph*
+gssw_graph_fill_score (gssw_graph* graph,
+                       const char* read_seq,
+                       const int8_t* nt_table,
+                       const int8_t* score_matrix,
+                       const uint8_t weight_gapO,
+                       const uint8_t weight_gapE,
+                       const int8_t score_size) {
+    return gssw_graph_fill_nodes(graph, read_seq, nt_table, score_matrix, weight_gapO, weight_gapE, 0,
+                                 score_size, -1, 0, NULL, NULL, 1);
+}
+
+/* columns within maskLen of the best end, along the edges: a prefix of the nodes downstream, a suffix upstream */
+typedef struct {
+    gssw_node* node;
+    int32_t begin, end; // masked columns, inclusive
+} gssw_mask;
+
+typedef struct {
+    gssw_mask* m;
+    int32_t size, cap;
+} gssw_masks;
+
+static void gssw_masks_push (gssw_masks* ms, gssw_node* n, int32_t begin, int32_t end) {
+    if (ms->size == ms->cap) {
+        ms->cap = ms->cap ? ms->cap * 2 : 16;
+        ms->m = (gssw_mask*)realloc(ms->m, ms->cap * sizeof(gssw_mask));
+    }
+    ms->m[ms->size].node = n;
+    ms->m[ms->size].begin = begin < 0 ? 0 : begin;
+    ms->m[ms->size].end = end >= n->len ? n->len - 1 : end;
+    ++ms->size;
+}
+
+/* mask the first cols columns downstream of n (forward), or the last cols columns upstream of it */
+static void gssw_masks_spread (gssw_masks* ms, gssw_node* n, int32_t cols, int8_t forward) {
+    int32_t i, count = forward ? n->count_next : n->count_prev;
+    for (i = 0; i < count; ++i) {
+        gssw_node* m = forward ? n->next[i] : n->prev[i];
+        if (forward) gssw_masks_push(ms, m, 0, cols - 1);
+        else gssw_masks_push(ms, m, m->len - cols, m->len - 1);
+        if (cols > m->len) gssw_masks_spread(ms, m, cols - m->len, forward);
+    }
+}
+
+/* the graph-wide counterpart of the 2nd best search of the kernels: the highest column maximum over all nodes,
+   outside the columns within maskLen of the best end; alternative paths around the best alignment are not masked */
+static void gssw_graph_second_best (gssw_graph* graph, gssw_graph_context* ctx, int32_t maskLen, gssw_workspace* ws) {
+    gssw_node_alignment_end* sb = ctx ? &ctx->second_best : &graph->second_best;
+    gssw_node* best = ctx ? ctx->max_node : graph->max_node;
+    gssw_masks ms = { ws ? (gssw_mask*)ws->masks : NULL, 0, ws ? ws->masks_cap : 0 };
+    int32_t e = gssw_node_align(ctx, best)->ref_end1;
+    uint32_t i;
+    int32_t j, k;
+
+    gssw_masks_push(&ms, best, e - maskLen, e + maskLen);
+    if (maskLen - (best->len - 1 - e) > 0) gssw_masks_spread(&ms, best, maskLen - (best->len - 1 - e), 1);
+    if (maskLen - e > 0) gssw_masks_spread(&ms, best, maskLen - e, 0);
+
+    for (i = 0; i < graph->size; ++i) {
+        gssw_node* n = graph->nodes[i];
+        const gssw_align* a = ctx ? ctx->alignment[i] : n->alignment;
+        const uint32_t* mc = a ? a->max_column : NULL;
+        if (!mc) continue;
+        for (j = 0; j < n->len; ++j) {
+            if (mc[j] <= sb->end.score) continue;
+            for (k = 0; k < ms.size; ++k) {
+                if (ms.m[k].node == n && j >= ms.m[k].begin && j <= ms.m[k].end) break;
+            }
+            if (k < ms.size) continue;
+            sb->node = n;
+            sb->end.score = mc[j];
+            sb->end.ref = j;
+        }
+    }
+    if (ws) {
+        // keep the buffer for the next fill
+        ws->masks = ms.m;
+        ws->masks_cap = ms.cap;
+    } else {
+        free(ms.m);
+    }
+}
+
+/* The second pass of gssw_graph_fill_cone: fill the nodes an alignment to the best end can go through again, now with
+   their matrices.  Ending at read position e with score s, it takes at most e + 1 read positions, and at most
+   ((e + 1) * max_match - s) / gap deletions, each costing at least the smaller gap weight; nodes ending further
+   upstream than those reference positions keep only the seeds of the first pass.  Those seeds are still in place and
+   the fills do not depend on anything else, so every node of the cone is filled again just as it was the first time.
+   Returns -1 if a node could not get its matrix, 1 otherwise. */
+static int8_t gssw_graph_refill_cone (gssw_graph* graph,
+                                    const gssw_profile* prof,
+                                    const uint8_t weight_gapO,
+                                    const uint8_t weight_gapE,
+                                    const int32_t maskLen,
+                                    const int32_t max_match,
+                                    gssw_fill_settings set,
+                                    gssw_workspace* ws,
+                                    gssw_graph_context* ctx) {
+
+    const gssw_kernels* k = &gssw_kernel_table[prof->simd];
+    gssw_node* max_node = ctx ? ctx->max_node : graph->max_node;
+    const gssw_align* a = gssw_node_align(ctx, max_node);
+    int32_t gap = weight_gapO < weight_gapE ? weight_gapO : weight_gapE, j;
+    int64_t e = a->read_end1 + 1;
+    int64_t span = gap ? e + (e * max_match - a->score1) / gap : INT64_MAX;
+    uint32_t size = graph->size, i, top = 0;
+    int8_t filled = 1;
+    gssw_node_index* index = (gssw_node_index*)malloc(size * sizeof(gssw_node_index));
+    int64_t* need = (int64_t*)malloc(size * sizeof(int64_t)); // reference positions from a node to the best end
+    for (i = 0; i < size; ++i) {
+        index[i].node = graph->nodes[i];
+        index[i].i = i;
+        need[i] = INT64_MAX;
+        if (graph->nodes[i] == max_node) top = i;
+    }
+    qsort(index, size, sizeof(gssw_node_index), gssw_node_index_cmp);
+
+    // upstream from the best end, in reverse topological order
+    need[top] = a->ref_end1 + 1;
+    for (i = top + 1; i-- > 0;) {
+        gssw_node* n = graph->nodes[i];
+        if (need[i] == INT64_MAX || need[i] - n->len >= span) continue;
+        for (j = 0; j < n->count_prev; ++j) {
+            gssw_node_index key = { n->prev[j], 0 };
+            gssw_node_index* p = (gssw_node_index*)bsearch(&key, index, size, sizeof(gssw_node_index), gssw_node_index_cmp);
+            if (p && need[i] + n->prev[j]->len < need[p->i]) need[p->i] = need[i] + n->prev[j]->len;
+        }
+    }
+
+    for (i = 0; i <= top; ++i) {
+        gssw_node* n = graph->nodes[i];
+        gssw_seed* seed;
+        uint8_t width = gssw_node_align(ctx, n)->score_width;
+        if (need[i] == INT64_MAX || need[i] - n->len >= span) continue;
+        seed = gssw_node_seed(k, width, prof->readLen, ctx, n, ws);
+        if (UNLIKELY(!seed)) { filled = -1; break; }
+        filled = gssw_node_fill_width(n, prof, weight_gapO, weight_gapE, maskLen, seed, width, -1, 0, 1, set, ws, ctx);
+        if (!ws) gssw_seed_destroy(seed);
+        if (filled < 0) break;
+    }
+    free(index);
+    free(need);
+    return filled;
+}
+
+/* fill a node of a graph fill, of sequence num (len long) and predecessor alignments prev, into slot: with the width
+   of its widest predecessor, growing it (and what descends from it) when it overflows.  The profiles of wider scores
+   are built on demand, under lock if there is one.  Returns 1, or -1 if the node could not get its matrix; with
+   X-drop, best is the best score of the fill so far. */
+static int8_t gssw_fill_grow (const int8_t* num,
+                              const int32_t len,
+                              gssw_align** slot,
+                              gssw_align** prev,
+                              const int32_t count_prev,
+                              gssw_profile* prof,
+                              const uint8_t weight_gapO,
+                              const uint8_t weight_gapE,
+                              const int32_t maskLen,
+                              const int32_t xdrop,
+                              const uint32_t best,
+                              const int32_t max_match,
+                              const int8_t store_mH,
+                              gssw_fill_settings set,
+                              gssw_workspace* ws,
+                              pthread_mutex_t* lock) {
+
+    const gssw_kernels* k = &gssw_kernel_table[prof->simd];
+    gssw_seed* seed;
+    int8_t filled;
+    int32_t j;
+    // nodes stay in byte mode until they overflow, or descend from a node which did; likewise for word
+    uint8_t width = prof->profile_byte ? 1 : 2;
+    for (j = 0; j < count_prev; ++j) {
+        if (prev[j]->score_width > width) width = prev[j]->score_width;
+    }
+    for (;;) {
+        // get seed from parents (max of multiple inputs), widening those filled with narrower scores
+        if (width == 2) {
+            if (lock) pthread_mutex_lock(lock);
+            if (!prof->profile_word) prof->profile_word = k->qP_word(prof->read, prof->mat, prof->readLen, prof->n, ws);
+            if (lock) pthread_mutex_unlock(lock);
+        } else if (width == 4) {
+            if (lock) pthread_mutex_lock(lock);
+            if (!prof->profile_dword) prof->profile_dword = k->qP_dword(prof->read, prof->mat, prof->readLen, prof->n, ws);
+            if (lock) pthread_mutex_unlock(lock);
+        }
+        if (UNLIKELY((width == 2 && !prof->profile_word) || (width == 4 && !prof->profile_dword))) return -1;
+        seed = gssw_seed_merge(k, width, prof->readLen, prev, count_prev, ws);
+        if (UNLIKELY(!seed)) return -1;
+        if (xdrop >= 0 && best > (uint32_t)xdrop
+            && gssw_seed_max(seed, prof->readLen, width, k->vsize) + max_match < best - xdrop) {
+            // X-drop: nothing reachable from the predecessors comes within xdrop of the best score, skip the
+            // node.  It is left without matrix or seed, which read as 0 to the traceback and to its successors
+            gssw_align* a = gssw_node_reset_alignment(slot);
+            a->score_width = width;
+            a->is_byte = width == 1;
+            if (!ws) gssw_seed_destroy(seed);
+            return 1;
+        }
+        filled = gssw_fill_width(num, len, slot, prof, weight_gapO, weight_gapE, maskLen, seed, width,
+                                 xdrop, best, store_mH, set, ws);
+        if (!ws) gssw_seed_destroy(seed); // cleanup seed
+        if (filled) return filled;
+        // we have exceeded the dynamic range of this width: redo only this node with twice the bits
+        width *= 2;
+    }
+}
+
+/* gssw_fill_grow of node n into context ctx; -2 if a predecessor of n has not been filled */
+static int8_t gssw_graph_fill_node (gssw_node* n,
+                                    gssw_profile* prof,
+                                    const uint8_t weight_gapO,
+                                    const uint8_t weight_gapE,
+                                    const int32_t maskLen,
+                                    const int32_t xdrop,
+                                    const uint32_t best,
+                                    const int32_t max_match,
+                                    const int8_t store_mH,
+                                    gssw_fill_settings set,
+                                    gssw_workspace* ws,
+                                    gssw_graph_context* ctx,
+                                    pthread_mutex_t* lock) {
+
+    gssw_align* stack[16];
+    gssw_align** prev = n->count_prev > 16 ? (gssw_align**)malloc(n->count_prev * sizeof(gssw_align*)) : stack;
+    int8_t filled = gssw_node_prev_aligns(ctx, n, prev);
+    if (filled == 0) {
+        filled = gssw_fill_grow(n->num, n->len, gssw_node_slot(ctx, n), prev, n->count_prev, prof, weight_gapO,
+                                weight_gapE, maskLen, xdrop, best, max_match, store_mH, set, ws, lock);
+    }
+    if (prev != stack) free(prev);
+    return filled;
+}
+
+/* gssw_fill_grow of node i of the compiled graph of ctx, its sequence and predecessors read off the arrays */
+static int8_t gssw_compiled_fill_node (gssw_graph_context* ctx,
+                                       uint32_t i,
+                                       gssw_profile* prof,
+                                       const uint8_t weight_gapO,
+                                       const uint8_t weight_gapE,
+                                       const int32_t maskLen,
+                                       const int32_t xdrop,
+                                       const uint32_t best,
+                                       const int32_t max_match,
+                                       const int8_t store_mH,
+                                       gssw_fill_settings set,
+                                       gssw_workspace* ws) {
+
+    const gssw_graph_compiled* cg = ctx->compiled;
+    uint32_t x, begin = cg->prev_at[i], count = cg->prev_at[i + 1] - begin;
+    for (x = 0; x < count; ++x) ctx->prev[x] = ctx->alignment[cg->prev[begin + x]];
+    return gssw_fill_grow(cg->num + cg->num_at[i], (int32_t)(cg->num_at[i + 1] - cg->num_at[i]), &ctx->alignment[i],
+                          ctx->prev, count, prof, weight_gapO, weight_gapE, maskLen, xdrop, best, max_match, store_mH,
+                          set, ws, NULL);
+}
+
+/* Parallel graph fill (see gssw_graph_fill_parallel).  A node is ready once the predecessors it has in the graph are
+   filled, counted down in pending.  Each thread keeps the nodes it made ready in a deque of its own, taking back the
+   newest, which continue the path it is on, and when it runs out steals the oldest from the others.  Every node is
+   queued once, so the deques never need more than a slot per node. */
+typedef struct {
+    pthread_mutex_t lock;
+    uint32_t* node;
+    uint32_t top;	// oldest, stolen from here
+    uint32_t bottom;	// one past the newest, pushed and taken here
+} gssw_deque;
+
+typedef struct {
+    gssw_graph* graph;
+    gssw_graph_context* ctx;
+    gssw_profile* prof;
+    uint8_t gapO;
+    uint8_t gapE;
+    int32_t maskLen;
+    int8_t store_mH;
+    gssw_fill_settings set;
+    uint32_t* next;	// successors of node i in the graph: next[next_at[i]] ... next[next_at[i + 1] - 1]
+    uint32_t* next_at;
+    uint32_t* pending;
+    gssw_deque* deques;
+    int32_t threads;
+    uint32_t ready;	// nodes queued in all the deques
+    uint32_t done;	// nodes filled, under lock
+    int8_t failed;	// -1 once a node could not get its matrix, -2 its predecessors; under lock
+    pthread_mutex_t lock;	// idle threads wait on wake for ready nodes
+    pthread_cond_t wake;
+    pthread_mutex_t profile_lock;
+} gssw_fill_pool;
+
+typedef struct {
+    gssw_fill_pool* pool;
+    int32_t id;
+} gssw_fill_worker;
+
+static void gssw_fill_pool_push (gssw_fill_pool* p, int32_t t, uint32_t i) {
+    gssw_deque* d = &p->deques[t];
+    pthread_mutex_lock(&d->lock);
+    d->node[d->bottom++] = i;
+    pthread_mutex_unlock(&d->lock);
+    __atomic_add_fetch(&p->ready, 1, __ATOMIC_RELEASE);
+    pthread_mutex_lock(&p->lock);
+    pthread_cond_signal(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+}
+
+/* the newest node of the deque of thread t, else the oldest of another one; 0 if there is none */
+static int8_t gssw_fill_pool_take (gssw_fill_pool* p, int32_t t, uint32_t* i) {
+    int32_t s;
+    for (s = 0; s < p->threads; ++s) {
+        gssw_deque* d = &p->deques[(t + s) % p->threads];
+        int8_t found = 0;
+        pthread_mutex_lock(&d->lock);
+        if (d->top < d->bottom) {
+            *i = s ? d->node[d->top++] : d->node[--d->bottom];
+            found = 1;
+        }
+        pthread_mutex_unlock(&d->lock);
+        if (found) {
+            __atomic_sub_fetch(&p->ready, 1, __ATOMIC_ACQUIRE);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void* gssw_fill_pool_run (void* arg) {
+    gssw_fill_worker* w = (gssw_fill_worker*)arg;
+    gssw_fill_pool* p = w->pool;
+    uint32_t size = p->graph->size, i, x;
+    for (;;) {
+        if (!gssw_fill_pool_take(p, w->id, &i)) {
+            int8_t stop;
+            pthread_mutex_lock(&p->lock);
+            while (!__atomic_load_n(&p->ready, __ATOMIC_ACQUIRE) && p->done < size && !p->failed) {
+                pthread_cond_wait(&p->wake, &p->lock);
+            }
+            stop = p->done == size || p->failed;
+            pthread_mutex_unlock(&p->lock);
+            if (stop) return NULL;
+            continue;
+        }
+        int8_t filled = gssw_graph_fill_node(p->graph->nodes[i], p->prof, p->gapO, p->gapE, p->maskLen, -1, 0, 0,
+                                             p->store_mH, p->set, NULL, p->ctx, &p->profile_lock);
+        if (filled < 0) {
+            pthread_mutex_lock(&p->lock);
+            p->failed = filled;
+            pthread_cond_broadcast(&p->wake);
+            pthread_mutex_unlock(&p->lock);
+            return NULL;
+        }
+        for (x = p->next_at[i]; x < p->next_at[i + 1]; ++x) {
+            if (__atomic_sub_fetch(&p->pending[p->next[x]], 1, __ATOMIC_ACQ_REL) == 0) {
+                gssw_fill_pool_push(p, w->id, p->next[x]);
+            }
+        }
+        pthread_mutex_lock(&p->lock);
+        if (++p->done == size) pthread_cond_broadcast(&p->wake);
+        pthread_mutex_unlock(&p->lock);
+    }
+}
+
+/* fill the nodes of graph on threads threads, the calling one included; 0 without filling anything if graph->nodes is
+   not in topological order, for the serial fill to go through them as it always has.  *filled is -1 if a node could
+   not get its matrix, -2 if a node outside the graph preceding one in it was not filled. */
+static int8_t gssw_graph_fill_parallel_nodes (gssw_graph* graph,
+                                              gssw_graph_context* ctx,
+                                              gssw_profile* prof,
+                                              const uint8_t weight_gapO,
+                                              const uint8_t weight_gapE,
+                                              const int32_t maskLen,
+                                              const int8_t store_mH,
+                                              gssw_fill_settings set,
+                                              uint32_t threads,
+                                              int8_t* filled) {
+
+    uint32_t size = graph->size, i, t, started;
+    int32_t j;
+    gssw_node_index* index = (gssw_node_index*)malloc((size ? size : 1) * sizeof(gssw_node_index));
+    gssw_node_index* q;
+    gssw_fill_pool p;
+    memset(&p, 0, sizeof(gssw_fill_pool));
+    p.next_at = (uint32_t*)calloc(size + 2, sizeof(uint32_t));
+    p.pending = (uint32_t*)calloc(size ? size : 1, sizeof(uint32_t));
+    for (i = 0; i < size; ++i) {
+        index[i].node = graph->nodes[i];
+        index[i].i = i;
+    }
+    qsort(index, size, sizeof(gssw_node_index), gssw_node_index_cmp);
+
+    // the edges within the graph, which must all point forward; predecessors outside it are filled already
+    for (i = 0; i < size; ++i) {
+        gssw_node* n = graph->nodes[i];
+        for (j = 0; j < n->count_prev; ++j) {
+            gssw_node_index key = { n->prev[j], 0 };
+            q = (gssw_node_index*)bsearch(&key, index, size, sizeof(gssw_node_index), gssw_node_index_cmp);
+            if (!q) continue;
+            if (q->i >= i) break;
+            ++p.pending[i];
+            ++p.next_at[q->i + 2];
+        }
+        if (j < n->count_prev) break;
+    }
+    if (i < size) {
+        free(index);
+        free(p.next_at);
+        free(p.pending);
+        return 0;
+    }
+    for (i = 0; i < size; ++i) p.next_at[i + 2] += p.next_at[i + 1];
+    p.next = (uint32_t*)malloc((p.next_at[size + 1] ? p.next_at[size + 1] : 1) * sizeof(uint32_t));
+    for (i = 0; i < size; ++i) {
+        gssw_node* n = graph->nodes[i];
+        for (j = 0; j < n->count_prev; ++j) {
+            gssw_node_index key = { n->prev[j], 0 };
+            q = (gssw_node_index*)bsearch(&key, index, size, sizeof(gssw_node_index), gssw_node_index_cmp);
+            if (q) p.next[p.next_at[q->i + 1]++] = i; // next_at[k + 1] ends up where the successors of k + 1 start
+        }
+    }
+    free(index);
+    if (threads > size) threads = size ? size : 1;
+
+    p.graph = graph;
+    p.ctx = ctx;
+    p.prof = prof;
+    p.gapO = weight_gapO;
+    p.gapE = weight_gapE;
+    p.maskLen = maskLen;
+    p.store_mH = store_mH;
+    p.set = set;
+    p.threads = threads;
+    p.deques = (gssw_deque*)calloc(threads, sizeof(gssw_deque));
+    pthread_mutex_init(&p.lock, NULL);
+    pthread_cond_init(&p.wake, NULL);
+    pthread_mutex_init(&p.profile_lock, NULL);
+    for (t = 0; t < threads; ++t) {
+        pthread_mutex_init(&p.deques[t].lock, NULL);
+        p.deques[t].node = (uint32_t*)malloc((size ? size : 1) * sizeof(uint32_t));
+    }
+    // the sources, dealt out in order
+    for (i = 0, t = 0; i < size; ++i) {
+        if (p.pending[i]) continue;
+        p.deques[t].node[p.deques[t].bottom++] = i;
+        ++p.ready;
+        t = (t + 1) % threads;
+    }
+
+    pthread_t* tid = (pthread_t*)malloc(threads * sizeof(pthread_t));
+    gssw_fill_worker* w = (gssw_fill_worker*)malloc(threads * sizeof(gssw_fill_worker));
+    for (t = 0; t < threads; ++t) {
+        w[t].pool = &p;
+        w[t].id = t;
+    }
+    // the calling thread is worker 0; if fewer threads start, they steal all the work of the others
+    for (started = 1; started < threads; ++started) {
+        if (pthread_create(&tid[started], NULL, gssw_fill_pool_run, &w[started])) break;
+    }
+    gssw_fill_pool_run(&w[0]);
+    for (t = 1; t < started; ++t) pthread_join(tid[t], NULL);
+    *filled = p.failed ? p.failed : 1;
+
+    for (t = 0; t < threads; ++t) {
+        pthread_mutex_destroy(&p.deques[t].lock);
+        free(p.deques[t].node);
+    }
+    pthread_mutex_destroy(&p.lock);
+    pthread_cond_destroy(&p.wake);
+    pthread_mutex_destroy(&p.profile_lock);
+    free(p.deques);
+    free(p.next);
+    free(p.next_at);
+    free(p.pending);
+    free(tid);
+    free(w);
+    return 1;
+}
+
+/* fill every node in order, growing the score width of a node (and of what descends from it) when it overflows;
+   store_mH == 0 keeps only the seeds, for score-only fills, and GSSW_FILL_CONE then fills the nodes the best
+   alignment can go through again with their matrices.  With a workspace, the read, its profile, the seeds and the
+   matrices all come from its arena.  With a context, everything the fill leaves goes there, and the graph is only
+   read; a compiled graph is filled off its arrays */
+static gssw_graph*
+gssw_graph_fill_nodes (gssw_graph* graph,
+                       const char* read_seq,
+                       const int8_t* nt_table,
+                       const int8_t* score_matrix,
+                       const uint8_t weight_gapO,
+                       const uint8_t weight_gapE,
+                       const int32_t maskLen,
+                       const int8_t score_size,
+                       const int32_t xdrop,
+                       const int8_t store_mH,
+                       gssw_workspace* ws,
+                       gssw_graph_context* ctx,
+                       const int32_t threads) {
+
+    int32_t read_length = strlen(read_seq), j;
+    gssw_fill_settings set = ctx ? ctx->settings : gssw_fill_defaults();
+    gssw_node** max_node = ctx ? &ctx->max_node : &graph->max_node;
+    gssw_node_alignment_end* second_best = ctx ? &ctx->second_best : &graph->second_best;
+    gssw_profile** profile = ctx ? &ctx->profile : &graph->profile;
+    if (*profile) {
+        gssw_profile_destroy(*profile);
+        *profile = NULL;
+    }
+    int8_t* read_num = (int8_t*)gssw_ws_alloc(ws, read_length);
+    gssw_profile* prof = NULL;
+    if (LIKELY(read_num != NULL)) {
+        for (j = 0; j < read_length; ++j) read_num[j] = nt_table[(int)read_seq[j]];
+        // the word profile is only built once some node overflows
+        prof = gssw_init_ws(read_num, read_length, score_matrix, 5, score_size == 1 ? 1 : 0, ws);
+    }
+    if (UNLIKELY(!prof)) {
+        if (!ws) free(read_num);
+        fprintf(stderr, "error:[gssw] Could not allocate the profile of the read, the fill is incomplete.\n");
+        *max_node = NULL;
+        return NULL;
+    }
+    uint32_t max_score = 0;
+    int8_t filled = 1; // -1 once a node could not get its matrix, -2 if the nodes are out of order
+
+    memset(second_best, 0, sizeof(gssw_node_alignment_end));
+    second_best->end.ref = -1;
+
+    // most a single column can add to a score, bounds what a node can reach from its seed
+    int32_t max_match = 0;
+    for (j = 0; j < 25; ++j) if (score_matrix[j] > max_match) max_match = score_matrix[j];
 
     // for each node, from start to finish in the partial order (which should be sorted topologically)
     // generate a seed from input nodes or use existing (e.g. for subgraph traversal here)
     uint32_t i;
     gssw_node** npp = &graph->nodes[0];
-    for (i = 0; i < graph->size; ++i, ++npp) {
-        gssw_node* n = *npp;
-        // get seed from parents (max of multiple inputs)
-        if (prof->profile_byte) {
-            seed = gssw_create_seed_byte(prof->readLen, n->prev, n->count_prev);
-        } else {
-            seed = gssw_create_seed_word(prof->readLen, n->prev, n->count_prev);
-        }
-        gssw_node* filled_node = gssw_node_fill(n, prof, weight_gapO, weight_gapE, maskLen, seed);
-        gssw_seed_destroy(seed); seed = NULL; // cleanup seed
-        // test if we have exceeded the score dynamic range
-        if (prof->profile_byte && !filled_node) {
-            free(prof->profile_byte);
-            prof->profile_byte = NULL;
-            free(read_num);
-            gssw_profile_destroy(prof);
-            return gssw_graph_fill(graph, read_seq, nt_table, score_matrix, weight_gapO, weight_gapE, maskLen, 1);
-        } else {
-            if (!graph->max_node || n->alignment->score1 > max_score) {
-                graph->max_node = n;
-                max_score = n->alignment->score1;
+    if (threads > 1 && !ws && xdrop < 0 && gssw_graph_fill_parallel_nodes(graph, ctx, prof, weight_gapO, weight_gapE, maskLen,
+                                                                          store_mH == 1, set, threads, &filled)) {
+        // the best node as the serial fill picks it, the first of the highest score
+        for (i = 0; filled >= 0 && i < graph->size; ++i, ++npp) {
+            const gssw_align* a = ctx ? ctx->alignment[i] : (*npp)->alignment;
+            if (!*max_node || a->score1 > max_score) {
+                *max_node = *npp;
+                max_score = a->score1;
             }
         }
+    } else for (i = 0; i < graph->size; ++i, ++npp) {
+        gssw_node* n = *npp;
+        filled = ctx && ctx->compiled
+               ? gssw_compiled_fill_node(ctx, i, prof, weight_gapO, weight_gapE, maskLen, xdrop, max_score, max_match,
+                                         store_mH == 1, set, ws)
+               : gssw_graph_fill_node(n, prof, weight_gapO, weight_gapE, maskLen, xdrop, max_score, max_match,
+                                      store_mH == 1, set, ws, ctx, NULL);
+        if (filled < 0) break;
+        const gssw_align* a = ctx ? ctx->alignment[i] : n->alignment;
+        if (!*max_node || a->score1 > max_score) {
+            *max_node = n;
+            max_score = a->score1;
+        }
+    }
+    if (filled >= 0 && maskLen >= 15 && *max_node) gssw_graph_second_best(graph, ctx, maskLen, ws);
+    if (filled >= 0 && store_mH == GSSW_FILL_CONE && *max_node) {
+        filled = gssw_graph_refill_cone(graph, prof, weight_gapO, weight_gapE, maskLen, max_match, set, ws, ctx);
     }
 
-    free(read_num);
-    gssw_profile_destroy(prof);
+    if (!ws) {
+        free(read_num);
+        prof->read = NULL;
+        // a checkpointed traceback refills blocks from the profile, the graph (or context) keeps it until the next fill
+        if (filled >= 0 && store_mH && set.matrix == GSSW_MATRIX_CKPT) *profile = prof;
+        else gssw_profile_destroy(prof);
+    }
 
+    if (filled < 0) {
+        if (filled == -1) fprintf(stderr, "error:[gssw] Could not allocate the matrix of a node, the fill is incomplete.\n");
+        *max_node = NULL;
+        return NULL;
+    }
     return graph;
 
 }
@@ -1607,19 +3309,52 @@ gssw_node_fill (gssw_node* node,
                 const uint8_t weight_gapE,
                 const int32_t maskLen,
                 const gssw_seed* seed) {
+    return gssw_node_fill_width(node, prof, weight_gapO, weight_gapE, maskLen, seed,
+                                prof->profile_byte ? 1 : prof->profile_word ? 2 : 4, -1, 0, 1, gssw_fill_defaults(),
+                                NULL, NULL) > 0 ? node : NULL;
+}
+
+gssw_node*
+gssw_node_fill_ws (gssw_node* node,
+                   const gssw_profile* prof,
+                   const uint8_t weight_gapO,
+                   const uint8_t weight_gapE,
+                   const int32_t maskLen,
+                   const gssw_seed* seed,
+                   gssw_workspace* ws) {
+    return gssw_node_fill_width(node, prof, weight_gapO, weight_gapE, maskLen, seed,
+                                prof->profile_byte ? 1 : prof->profile_word ? 2 : 4, -1, 0, 1, gssw_fill_defaults(), ws,
+                                NULL) > 0 ? node : NULL;
+}
+
+/* fill the node of sequence num, len long, with scores of width bytes (1, 2 or 4) into the alignment in slot; the
+   seed must be of the same width, and store_mH 1 for a fill to trace back (keeping what the matrix mode of set says),
+   -1 for one keeping mH whatever it says, 0 for scores only.  Returns 1, 0 if the scores overflowed, and the node has
+   to be filled again wider, or -1 if there was no memory for the matrix */
+static int8_t
+gssw_fill_width (const int8_t* num,
+                 const int32_t len,
+                 gssw_align** slot,
+                 const gssw_profile* prof,
+                 const uint8_t weight_gapO,
+                 const uint8_t weight_gapE,
+                 const int32_t maskLen,
+                 const gssw_seed* seed,
+                 const uint8_t width,
+                 const int32_t xdrop,
+                 const uint32_t xbest,
+                 const int8_t store_mH,
+                 gssw_fill_settings set,
+                 gssw_workspace* ws) {
 
 	gssw_alignment_end* bests = NULL;
 	int32_t readLen = prof->readLen;
+	const gssw_kernels* k = &gssw_kernel_table[prof->simd];
+	int8_t store = store_mH < 0 ? 1 : store_mH ? gssw_matrix_store(prof, weight_gapO, set.matrix) : 0;
 
     //alignment_end* best = (alignment_end*)calloc(1, sizeof(alignment_end));
-    gssw_align* alignment = node->alignment;
-
-    if (alignment) {
-        // clear old alignment
-        gssw_align_destroy(alignment);
-    }
-    // and build up a new one
-    node->alignment = alignment = gssw_align_create();
+    // clear the old alignment, and build up a new one in its place
+    gssw_align* alignment = gssw_node_reset_alignment(slot);
 
     
     // if we have parents, we should generate a new seed as the max of each vector
@@ -1627,23 +3362,57 @@ gssw_node_fill (gssw_node* node,
     // otherwise, just use the single parent alignment result as seed
     // or, if no parents, run unseeded
 
-    // to decrease code complexity, we assume the same stripe size for the entire graph
-    // this is ensured by changing the stripe size for the entire graph in graph_fill if any node scores >= 255
+    // the width is chosen per node in graph_fill: byte until a node scores >= 255, then word for that node
+    // and everything downstream of it, then dword once a node saturates 16 bits
 
 	// Find the alignment scores and ending positions
-	if (prof->profile_byte) {
-		bests = gssw_sw_sse2_byte((const int8_t*)node->num, 0, node->len, readLen, weight_gapO, weight_gapE, prof->profile_byte, -1, prof->bias, maskLen, alignment, seed);
-		if (bests[0].score == 255) {
-			free(bests);
+	if (width == 1 && prof->profile_byte) {
+		bests = k->sw_byte(num, 0, len, readLen, weight_gapO, weight_gapE, prof->profile_byte, -1, prof->bias, maskLen,
+		                   xdrop, xbest, store, set, alignment, seed, ws);
+		if (bests && bests[0].score == 255) {
+			gssw_ws_free(ws, bests);
             gssw_align_clear_matrix_and_seed(alignment);
             return 0; // re-run from external context
 		}
-	} else if (prof->profile_word) {
-        bests = gssw_sw_sse2_word((const int8_t*)node->num, 0, node->len, readLen, weight_gapO, weight_gapE, prof->profile_word, -1, maskLen, alignment, seed);
+	} else if (width == 2 && prof->profile_word) {
+        bests = k->sw_word(num, 0, len, readLen, weight_gapO, weight_gapE, prof->profile_word, -1, maskLen,
+                           xdrop, xbest, store, set, alignment, seed, ws);
+		if (bests && bests[0].score == INT16_MAX) {
+			gssw_ws_free(ws, bests);
+            gssw_align_clear_matrix_and_seed(alignment);
+            return 0;
+		}
+    } else if (width == 4 && prof->profile_dword) {
+        bests = k->sw_dword(num, 0, len, readLen, weight_gapO, weight_gapE, prof->profile_dword, -1, maskLen,
+                            xdrop, xbest, store, set, alignment, seed, ws);
     } else {
 		fprintf(stderr, "Please call the function ssw_init before ssw_align.\n");
 		return 0;
 	}
+	if (!bests) {
+		// the node is left as X-drop leaves it, without matrix or seed
+		gssw_align_clear_matrix_and_seed(alignment);
+		return -1;
+	}
+	if (UNLIKELY(alignment->packed.overflow)) {
+		// H did not pack after all, the node keeps mH
+		gssw_ws_free(ws, bests);
+		gssw_align_clear_matrix_and_seed(alignment);
+		return gssw_fill_width(num, len, slot, prof, weight_gapO, weight_gapE, maskLen, seed, width, xdrop, xbest, -1,
+		                       set, ws);
+	}
+
+	if (alignment->ckpt.pv) {
+		// what the traceback refills the blocks from
+		gssw_checkpoints* c = &alignment->ckpt;
+		c->ref = num;
+		c->profile = width == 1 ? prof->profile_byte : width == 2 ? prof->profile_word : prof->profile_dword;
+		c->readLen = readLen;
+		c->gapO = weight_gapO;
+		c->gapE = weight_gapE;
+		c->bias = prof->bias;
+		c->simd = prof->simd;
+	}
 
 	alignment->score1 = bests[0].score;
 	alignment->ref_end1 = bests[0].ref;
@@ -1655,10 +3424,319 @@ gssw_node_fill (gssw_node* node,
 	    alignment->score2 = 0;
 		alignment->ref_end2 = -1;
 	}
+	gssw_ws_free(ws, bests);
+
+	return 1;
+
+}
+
+/* Linear query profile of the banded fill: row nt holds the scores of nt against every read position, with
+   GSSW_BAND_PAD cells of the lowest score either side so that no band ever scores outside the read. */
+static int16_t* gssw_qP_band (const int8_t* read_num, const int8_t* mat, const int32_t readLen, const int32_t n) {
+    int32_t rowLen = readLen + 2 * GSSW_BAND_PAD;
+    int16_t* profile = (int16_t*)malloc(n * rowLen * sizeof(int16_t));
+    int32_t nt, j;
+    if (UNLIKELY(!profile)) return NULL;
+    for (nt = 0; nt < n; ++nt) {
+        int16_t* t = profile + nt * rowLen;
+        for (j = -GSSW_BAND_PAD; j < readLen + GSSW_BAND_PAD; ++j) {
+            *t++ = (j < 0 || j >= readLen) ? INT16_MIN : mat[nt * n + read_num[j]];
+        }
+    }
+    return profile;
+}
+
+/* Merge the last columns of the banded predecessors into a seed covering the union of their bands, one position
+   further down the read.  Sets *band_lo and *band_w for the node; NULL if no predecessor has a band, or with *band_w
+   set to -1 if the seed cannot be had. */
+static gssw_seed* gssw_create_seed_band (gssw_node** prev, int32_t count, int32_t vsize, int32_t* band_lo,
+                                         int32_t* band_w) {
+    int32_t lanes = vsize / 2;
+    int32_t i, k, lo = INT32_MAX, hi = INT32_MIN;
+    for (i = 0; i < count; ++i) {
+        const gssw_align* a = prev[i]->alignment;
+        if (!a || !a->band_w || !a->seed.pvE) continue;
+        if (a->band_lo + prev[i]->len < lo) lo = a->band_lo + prev[i]->len;
+        if (a->band_lo + prev[i]->len + a->band_w > hi) hi = a->band_lo + prev[i]->len + a->band_w;
+    }
+    if (lo == INT32_MAX) return NULL;
+
+    int32_t w = (hi - lo + lanes - 1) / lanes * lanes;
+    size_t bytes = (w / lanes + 1) * vsize;
+    gssw_seed* seed = (gssw_seed*)calloc(1, sizeof(gssw_seed));
+    if (seed) {
+        seed->pvE = gssw_aligned_malloc(bytes, vsize);
+        seed->pvHStore = gssw_aligned_malloc(bytes, vsize);
+    }
+    if (UNLIKELY(!seed || !seed->pvE || !seed->pvHStore)) {
+        if (seed) gssw_seed_destroy(seed);
+        *band_w = -1;
+        return NULL;
+    }
+    memset(seed->pvE, 0, bytes);
+    memset(seed->pvHStore, 0, bytes);
+    uint16_t* sE = (uint16_t*)seed->pvE;
+    uint16_t* sH = (uint16_t*)seed->pvHStore;
+    for (i = 0; i < count; ++i) {
+        const gssw_align* a = prev[i]->alignment;
+        if (!a || !a->band_w || !a->seed.pvE) continue;
+        const uint16_t* pE = (const uint16_t*)a->seed.pvE;
+        const uint16_t* pH = (const uint16_t*)a->seed.pvHStore;
+        int32_t o = a->band_lo + prev[i]->len - lo;
+        for (k = 0; k < a->band_w; ++k) {
+            if (pE[k] > sE[o + k]) sE[o + k] = pE[k];
+            if (pH[k] > sH[o + k]) sH[o + k] = pH[k];
+        }
+    }
+    *band_lo = lo;
+    *band_w = w;
+    return seed;
+}
+
+static int8_t gssw_node_fill_band (gssw_node* node, gssw_profile* prof, const uint8_t weight_gapO,
+                                   const uint8_t weight_gapE, const int32_t read_offset, const int32_t band_width);
+
+gssw_graph*
+gssw_graph_fill_banded (gssw_graph* graph,
+                        const char* read_seq,
+                        const int8_t* nt_table,
+                        const int8_t* score_matrix,
+                        const uint8_t weight_gapO,
+                        const uint8_t weight_gapE,
+                        const int32_t read_offset,
+                        const int32_t band_width) {
+
+    int32_t read_length = strlen(read_seq);
+    int8_t* read_num = gssw_create_num(read_seq, read_length, nt_table);
+    // the banded kernel has 16-bit scores, its profile is built by the first node
+	gssw_profile* prof = gssw_init(read_num, read_length, score_matrix, 5, 1);
+    uint32_t max_score = 0;
+    if (UNLIKELY(!prof)) {
+        free(read_num);
+        fprintf(stderr, "error:[gssw] Could not allocate the profile of the read, the fill is incomplete.\n");
+        graph->max_node = NULL;
+        return NULL;
+    }
+    memset(&graph->second_best, 0, sizeof(gssw_node_alignment_end));
+    graph->second_best.end.ref = -1;
+
+    uint32_t i;
+    gssw_node** npp = &graph->nodes[0];
+    for (i = 0; i < graph->size; ++i, ++npp) {
+        gssw_node* n = *npp;
+        int8_t filled = gssw_node_fill_band(n, prof, weight_gapO, weight_gapE, read_offset, band_width);
+        if (filled <= 0) {
+            free(read_num);
+            gssw_profile_destroy(prof);
+            if (filled < 0) {
+                fprintf(stderr, "error:[gssw] Could not allocate the matrix of a node, the fill is incomplete.\n");
+                graph->max_node = NULL;
+                return NULL;
+            }
+            // 16 bits saturated inside the band: fill the whole graph again unbanded, which escalates to 32 bits
+            return gssw_graph_fill(graph, read_seq, nt_table, score_matrix, weight_gapO, weight_gapE, 0, 1);
+        }
+        if (!graph->max_node || n->alignment->score1 > max_score) {
+            graph->max_node = n;
+            max_score = n->alignment->score1;
+        }
+    }
+
+    free(read_num);
+    gssw_profile_destroy(prof);
+
+    return graph;
+}
+
+/* gssw_node_fill_banded: 1 if node was filled, 0 if its 16-bit scores saturated, -1 if its profile, seed or matrix
+   could not be had */
+static int8_t
+gssw_node_fill_band (gssw_node* node,
+                     gssw_profile* prof,
+                     const uint8_t weight_gapO,
+                     const uint8_t weight_gapE,
+                     const int32_t read_offset,
+                     const int32_t band_width) {
+
+	const gssw_kernels* k = &gssw_kernel_table[prof->simd];
+    int32_t lanes = k->vsize / 2;
+    int32_t band_lo, band_w = 0;
+
+    if (!prof->profile_band) prof->profile_band = gssw_qP_band(prof->read, prof->mat, prof->readLen, prof->n);
+    if (UNLIKELY(!prof->profile_band)) return -1;
+
+    // the band follows the diagonals of the predecessors, or starts around read_offset at a source node
+    gssw_seed* seed = gssw_create_seed_band(node->prev, node->count_prev, k->vsize, &band_lo, &band_w);
+    if (UNLIKELY(band_w < 0)) return -1;
+    if (!seed) {
+        // the kernel scores whole vectors, so the band is widened past the read positions above the diagonal
+        band_lo = read_offset - band_width;
+        band_w = (2 * band_width + 1 + lanes - 1) / lanes * lanes;
+    }
+
+    gssw_align* alignment = gssw_node_reset_alignment(&node->alignment);
+
+    gssw_alignment_end* bests = k->sw_band_word((const int8_t*)node->num, node->len, prof->readLen, weight_gapO,
+                                                weight_gapE, (const int16_t*)prof->profile_band, band_lo, band_w,
+                                                alignment, seed);
+    if (seed) gssw_seed_destroy(seed);
+    if (!bests || bests[0].score == INT16_MAX) {
+        int8_t r = bests ? 0 : -1;
+        free(bests);
+        gssw_align_clear_matrix_and_seed(alignment);
+        return r;
+    }
+
+	alignment->score1 = bests[0].score;
+	alignment->ref_end1 = bests[0].ref;
+	alignment->read_end1 = bests[0].read;
+	alignment->score2 = 0;
+	alignment->ref_end2 = -1;
 	free(bests);
 
-	return node;
+	return 1;
+}
 
+gssw_node*
+gssw_node_fill_banded (gssw_node* node,
+                       gssw_profile* prof,
+                       const uint8_t weight_gapO,
+                       const uint8_t weight_gapE,
+                       const int32_t read_offset,
+                       const int32_t band_width) {
+    return gssw_node_fill_band(node, prof, weight_gapO, weight_gapE, read_offset, band_width) > 0 ? node : NULL;
+}
+
+/* Fill the graph for up to one vector of reads (byte or word lanes, one read per lane) and trace back each
+   of them.  Returns 0 if the batch overflowed, and the group needs to be run again with wider scores, -1 if
+   a matrix, a seed or the profile could not be had, leaving the reads of the group without mappings. */
+static int8_t
+gssw_graph_align_batch_group (gssw_graph* graph,
+                              const gssw_kernels* k,
+                              const uint8_t is_byte,
+                              const char** read_seqs,
+                              const int32_t count,
+                              const int8_t* nt_table,
+                              const int8_t* score_matrix,
+                              int32_t match,
+                              int32_t mismatch,
+                              int32_t gap_open,
+                              int32_t gap_extension,
+                              gssw_graph_mapping** mappings) {
+
+    int32_t lanes = is_byte ? k->vsize : k->vsize / 2;
+    int32_t maxLen = 0, r, bias = 0;
+    uint32_t i;
+    int8_t** read_nums = (int8_t**)malloc(count * sizeof(int8_t*));
+    int32_t* read_lens = (int32_t*)malloc(count * sizeof(int32_t));
+    for (r = 0; r < count; ++r) {
+        read_lens[r] = strlen(read_seqs[r]);
+        read_nums[r] = gssw_create_num(read_seqs[r], read_lens[r], nt_table);
+        if (read_lens[r] > maxLen) maxLen = read_lens[r];
+    }
+    for (r = 0; r < 25; ++r) if (score_matrix[r] < bias) bias = score_matrix[r];
+    bias = abs(bias);
+
+    void* profile = is_byte
+        ? k->qP_batch_byte((const int8_t**)read_nums, read_lens, count, maxLen, score_matrix, 5, bias)
+        : k->qP_batch_word((const int8_t**)read_nums, read_lens, count, maxLen, score_matrix, 5);
+
+    // per node and lane ends, and the best node of every lane
+    gssw_alignment_end* ends = (gssw_alignment_end*)malloc(graph->size * lanes * sizeof(gssw_alignment_end));
+    gssw_node** max_nodes = (gssw_node**)calloc(lanes, sizeof(gssw_node*));
+    uint32_t* max_scores = (uint32_t*)calloc(lanes, sizeof(uint32_t));
+    int8_t overflow = 0, failed = !profile;
+
+    for (i = 0; i < graph->size && !overflow && !failed; ++i) {
+        gssw_node* n = graph->nodes[i];
+        // a batch seed is one vector per read position
+        gssw_seed* seed = gssw_node_seed(k, is_byte ? 1 : 2, maxLen * lanes, NULL, n, NULL);
+        gssw_node_reset_alignment(&n->alignment);
+        gssw_alignment_end* bests = !seed ? NULL : is_byte
+            ? k->sw_batch_byte((const int8_t*)n->num, n->len, read_lens, count, maxLen,
+                               gap_open, gap_extension, profile, bias, n->alignment, seed)
+            : k->sw_batch_word((const int8_t*)n->num, n->len, read_lens, count, maxLen,
+                               gap_open, gap_extension, profile, n->alignment, seed);
+        if (seed) gssw_seed_destroy(seed);
+        if (UNLIKELY(!bests)) {
+            failed = 1;
+            break;
+        }
+        for (r = 0; r < count; ++r) {
+            if (bests[r].score == (is_byte ? 255 : INT16_MAX)) overflow = 1;
+            if (!max_nodes[r] || bests[r].score > max_scores[r]) {
+                max_nodes[r] = n;
+                max_scores[r] = bests[r].score;
+            }
+        }
+        memcpy(ends + i * lanes, bests, lanes * sizeof(gssw_alignment_end));
+        free(bests);
+    }
+
+    // point every node at the lane of each read in turn and reuse the graph traceback
+    for (r = 0; r < count && !overflow && !failed; ++r) {
+        for (i = 0; i < graph->size; ++i) {
+            gssw_align* a = graph->nodes[i]->alignment;
+            gssw_alignment_end* e = ends + i * lanes + r;
+            a->mH_lane = r;
+            a->score1 = e->score;
+            a->ref_end1 = e->ref;
+            a->read_end1 = e->read;
+        }
+        graph->max_node = max_nodes[r];
+        mappings[r] = gssw_graph_trace_back(graph, read_seqs[r], read_lens[r],
+                                            match, mismatch, gap_open, gap_extension);
+    }
+
+    for (r = 0; r < count; ++r) free(read_nums[r]);
+    free(read_nums);
+    free(read_lens);
+    free(profile);
+    free(ends);
+    free(max_nodes);
+    free(max_scores);
+
+    if (failed) fprintf(stderr, "error:[gssw] Could not allocate the matrices of a batch, its reads have no mappings.\n");
+    return failed ? -1 : !overflow;
+}
+
+gssw_graph_mapping**
+gssw_graph_align_batch (gssw_graph* graph,
+                        const char** read_seqs,
+                        const int32_t count,
+                        const int8_t* nt_table,
+                        const int8_t* score_matrix,
+                        int32_t match,
+                        int32_t mismatch,
+                        int32_t gap_open,
+                        int32_t gap_extension) {
+
+    const gssw_kernels* k = &gssw_kernel_table[gssw_simd_get()];
+    gssw_graph_mapping** mappings = (gssw_graph_mapping**)calloc(count, sizeof(gssw_graph_mapping*));
+    int32_t b, w, r;
+
+    for (b = 0; b < count; b += k->vsize) {
+        int32_t n = count - b < k->vsize ? count - b : k->vsize;
+        if (gssw_graph_align_batch_group(graph, k, 1, read_seqs + b, n, nt_table, score_matrix,
+                                         match, mismatch, gap_open, gap_extension, mappings + b) == 0) {
+            // some read overflowed 8 bits, redo the group in halves with 16-bit lanes
+            for (w = b; w < b + n; w += k->vsize / 2) {
+                int32_t m = b + n - w < k->vsize / 2 ? b + n - w : k->vsize / 2;
+                if (gssw_graph_align_batch_group(graph, k, 0, read_seqs + w, m, nt_table, score_matrix,
+                                                 match, mismatch, gap_open, gap_extension, mappings + w) != 0) continue;
+                // beyond 16 bits: these reads are long enough for the striped fill, which goes up to 32 bits
+                for (r = w; r < w + m; ++r) {
+                    if (!gssw_graph_fill(graph, read_seqs[r], nt_table, score_matrix, gap_open, gap_extension, 0, 2)) {
+                        continue; // no memory for its matrices, left without a mapping
+                    }
+                    mappings[r] = gssw_graph_trace_back(graph, read_seqs[r], strlen(read_seqs[r]),
+                                                        match, mismatch, gap_open, gap_extension);
+                }
+            }
+        }
+    }
+
+    return mappings;
 }
 
 gssw_graph* gssw_graph_create(uint32_t size) {
@@ -1668,6 +3746,21 @@ gssw_graph* gssw_graph_create(uint32_t size) {
     return g;
 }
 
+gssw_graph* gssw_graph_create_arena(uint32_t size, const gssw_allocator* allocator) {
+    gssw_arena* arena = gssw_arena_create(allocator);
+    gssw_graph* g = arena ? (gssw_graph*)gssw_arena_alloc(arena, sizeof(gssw_graph)) : NULL;
+    // room for the first 1024 nodes, as gssw_graph_add_node grows the array in steps of 1024
+    gssw_node** nodes = g ? (gssw_node**)gssw_arena_alloc(arena, 1024*sizeof(gssw_node*)) : NULL;
+    if (UNLIKELY(!nodes)) {
+        gssw_arena_destroy(arena);
+        return NULL;
+    }
+    memset(g, 0, sizeof(gssw_graph));
+    g->arena = arena;
+    g->nodes = nodes;
+    return g;
+}
+
 void gssw_graph_clear_alignment(gssw_graph* g) {
     g->max_node = NULL;
 }
@@ -1677,6 +3770,11 @@ void gssw_graph_destroy(gssw_graph* g) {
     for (i = 0; i < g->size; ++i) {
         gssw_node_destroy(g->nodes[i]);
     }
+    if (g->profile) gssw_profile_destroy(g->profile);
+    if (g->arena) {
+        gssw_arena_destroy(g->arena);
+        return;
+    }
     g->max_node = NULL;
     free(g->nodes);
     g->nodes = NULL;
@@ -1684,7 +3782,12 @@ void gssw_graph_destroy(gssw_graph* g) {
 }
 
 int32_t gssw_graph_add_node(gssw_graph* graph, gssw_node* node) {
-    if (UNLIKELY(graph->size % 1024 == 0)) {
+    if (UNLIKELY(graph->arena && graph->size % 1024 == 0 && graph->size)) {
+        gssw_node** nodes = (gssw_node**)gssw_arena_realloc(graph->arena, graph->nodes, graph->size * sizeof(void*),
+                                                            (graph->size + 1024) * sizeof(void*));
+        if (UNLIKELY(!nodes)) return -1; // the graph stays as it was
+        graph->nodes = nodes;
+    } else if (UNLIKELY(!graph->arena && graph->size % 1024 == 0)) {
         size_t old_size = graph->size * sizeof(void*);
         size_t increment = 1024 * sizeof(void*);
         if (UNLIKELY(!(graph->nodes = realloc((void*)graph->nodes, old_size + increment)))) {
@@ -1696,6 +3799,187 @@ int32_t gssw_graph_add_node(gssw_graph* graph, gssw_node* node) {
     return graph->size;
 }
 
+/* the index of the node n continues the chain of in a normalized graph (its only predecessor, of which it is the only
+   successor) in graph, through index; size if it starts a chain */
+static uint32_t gssw_chain_prev (const gssw_graph* graph, const gssw_node_index* index, const gssw_node* n) {
+    gssw_node_index key = { n->count_prev == 1 ? n->prev[0] : NULL, 0 };
+    const gssw_node_index* q;
+    if (n->count_prev != 1 || key.node == n || n->prev[0]->count_next != 1) return graph->size;
+    q = (const gssw_node_index*)bsearch(&key, index, graph->size, sizeof(gssw_node_index), gssw_node_index_cmp);
+    return q ? q->i : graph->size;
+}
+
+gssw_graph_normalized* gssw_graph_normalize(const gssw_graph* graph,
+                                            const int32_t max_len,
+                                            const int8_t* nt_table,
+                                            const int8_t* score_matrix) {
+    uint32_t size = graph->size, i, c, chains = 0, parts = 0, x = 0, m;
+    int32_t j;
+    gssw_node_index* index = (gssw_node_index*)malloc((size ? size : 1) * sizeof(gssw_node_index));
+    uint32_t* chain_of = (uint32_t*)malloc((size ? size : 1) * sizeof(uint32_t));
+    uint32_t* member = (uint32_t*)malloc((size ? size : 1) * sizeof(uint32_t)); // the nodes of chain c, in order,
+    uint32_t* member_at = (uint32_t*)malloc((size + 1) * sizeof(uint32_t));      // from member_at[c] on
+    uint32_t* part_at = (uint32_t*)malloc((size + 1) * sizeof(uint32_t));        // and its new nodes from part_at[c]
+    gssw_node_index* q;
+    for (i = 0; i < size; ++i) {
+        index[i].node = graph->nodes[i];
+        index[i].i = i;
+        chain_of[i] = UINT32_MAX;
+    }
+    qsort(index, size, sizeof(gssw_node_index), gssw_node_index_cmp);
+
+    // chains from the nodes which start one, in graph order, then from what is left of unary cycles
+    for (m = 0; m < 2; ++m) {
+        for (i = 0; i < size; ++i) {
+            uint32_t k = i;
+            int64_t len = 0;
+            if (chain_of[i] != UINT32_MAX || (!m && gssw_chain_prev(graph, index, graph->nodes[i]) != size)) continue;
+            member_at[chains] = x;
+            for (;;) {
+                gssw_node* n = graph->nodes[k];
+                chain_of[k] = chains;
+                member[x++] = k;
+                len += n->len;
+                if (n->count_next != 1) break;
+                gssw_node_index key = { n->next[0], 0 };
+                q = (gssw_node_index*)bsearch(&key, index, size, sizeof(gssw_node_index), gssw_node_index_cmp);
+                if (!q || chain_of[q->i] != UINT32_MAX || gssw_chain_prev(graph, index, n->next[0]) != k) break;
+                k = q->i;
+            }
+            part_at[chains++] = parts;
+            parts += max_len > 0 && len > max_len ? (uint32_t)((len + max_len - 1) / max_len) : 1;
+        }
+    }
+    member_at[chains] = x;
+    part_at[chains] = parts;
+
+    gssw_graph_normalized* gn = (gssw_graph_normalized*)calloc(1, sizeof(gssw_graph_normalized));
+    gn->graph = gssw_graph_create(parts);
+    gn->pieces = (gssw_node_piece*)malloc((size + parts) * sizeof(gssw_node_piece)); // a cut adds at most one piece
+    gn->piece_at = (uint32_t*)malloc((parts + 1) * sizeof(uint32_t));
+    uint32_t p = 0, id = 0;
+    for (c = 0; c < chains; ++c) {
+        // the sequence of the chain, cut into parts of about equal length
+        int64_t len = 0, at = 0;
+        uint32_t count = part_at[c + 1] - part_at[c], k = member_at[c];
+        int32_t offset = 0;
+        for (x = member_at[c]; x < member_at[c + 1]; ++x) len += graph->nodes[member[x]]->len;
+        char* seq = (char*)malloc(len + 1);
+        for (x = member_at[c]; x < member_at[c + 1]; ++x) {
+            memcpy(seq + at, graph->nodes[member[x]]->seq, graph->nodes[member[x]]->len);
+            at += graph->nodes[member[x]]->len;
+        }
+        for (x = 0, at = 0; x < count; ++x, ++id) {
+            int64_t part = len / count + (x < len % count);
+            char t = seq[at + part];
+            gn->piece_at[id] = p;
+            // the pieces of the members the part covers
+            for (int64_t left = part; left > 0 || (!len && p == gn->piece_at[id]);) {
+                gssw_node* n = graph->nodes[member[k]];
+                int32_t l = n->len - offset < left ? n->len - offset : (int32_t)left;
+                gn->pieces[p].node = n;
+                gn->pieces[p].offset = offset;
+                gn->pieces[p++].len = l;
+                left -= l;
+                offset += l;
+                if (offset == n->len && k + 1 < member_at[c + 1]) {
+                    ++k;
+                    offset = 0;
+                }
+                if (!len) break;
+            }
+            seq[at + part] = 0;
+            gssw_graph_add_node(gn->graph, gssw_node_create(NULL, id, seq + at, nt_table, score_matrix));
+            seq[at + part] = t;
+            if (x) gssw_nodes_add_edge(gn->graph->nodes[id - 1], gn->graph->nodes[id]);
+            at += part;
+        }
+        free(seq);
+    }
+    gn->piece_at[parts] = p;
+
+    // the edges between chains, from the last part of one to the first of the next
+    for (c = 0; c < chains; ++c) {
+        gssw_node* n = graph->nodes[member[member_at[c + 1] - 1]];
+        for (j = 0; j < n->count_next; ++j) {
+            gssw_node_index key = { n->next[j], 0 };
+            q = (gssw_node_index*)bsearch(&key, index, size, sizeof(gssw_node_index), gssw_node_index_cmp);
+            if (q) gssw_nodes_add_edge(gn->graph->nodes[part_at[c + 1] - 1], gn->graph->nodes[part_at[chain_of[q->i]]]);
+        }
+    }
+    free(index);
+    free(chain_of);
+    free(member);
+    free(member_at);
+    free(part_at);
+    return gn;
+}
+
+void gssw_graph_normalized_destroy(gssw_graph_normalized* gn) {
+    if (!gn) return;
+    gssw_graph_destroy(gn->graph);
+    free(gn->pieces);
+    free(gn->piece_at);
+    free(gn);
+}
+
+/* the piece of node id of gn holding position ref of it, and where the piece begins in the node */
+static uint32_t gssw_piece_of (const gssw_graph_normalized* gn, uint32_t id, int32_t ref, int32_t* begin) {
+    uint32_t x = gn->piece_at[id];
+    *begin = 0;
+    while (x + 1 < gn->piece_at[id + 1] && *begin + gn->pieces[x].len <= ref) *begin += gn->pieces[x++].len;
+    return x;
+}
+
+gssw_graph_mapping* gssw_graph_mapping_denormalize(const gssw_graph_normalized* gn, const gssw_graph_mapping* m) {
+    gssw_graph_mapping* o = gssw_graph_mapping_create();
+    gssw_graph_cigar* gc = &o->cigar;
+    uint32_t cap = 0, k;
+    int32_t at = 0, e, begin; // at: where the last element ends in its source node
+    o->score = m->score;
+    o->score2 = m->score2;
+    o->ref_end2 = m->ref_end2;
+    if (m->node2) {
+        const gssw_node_piece* p = &gn->pieces[gssw_piece_of(gn, m->node2->id, m->ref_end2, &begin)];
+        o->node2 = p->node;
+        o->ref_end2 = p->offset + m->ref_end2 - begin;
+    }
+    for (k = 0; k < m->cigar.length; ++k) {
+        const gssw_node_cigar* nc = &m->cigar.elements[k];
+        uint32_t id = nc->node->id;
+        int32_t ref = k ? 0 : m->position;
+        uint32_t x = gssw_piece_of(gn, id, ref, &begin);
+        for (e = 0; e < nc->cigar->length; ++e) {
+            char type = nc->cigar->elements[e].type;
+            uint32_t len = nc->cigar->elements[e].length;
+            int8_t on_ref = type == 'M' || type == 'D' || type == '=' || type == 'X';
+            do {
+                const gssw_node_piece* p;
+                uint32_t n = len;
+                // a step along the reference off the end of a piece goes on in the next one
+                if (on_ref && ref == begin + gn->pieces[x].len && x + 1 < gn->piece_at[id + 1])
+                    begin += gn->pieces[x++].len;
+                p = &gn->pieces[x];
+                if (!gc->length || gc->elements[gc->length - 1].node != p->node || at != p->offset + ref - begin) {
+                    if (gc->length == cap) {
+                        cap = cap ? 2 * cap : 16;
+                        gc->elements = (gssw_node_cigar*)realloc(gc->elements, cap * sizeof(gssw_node_cigar));
+                    }
+                    if (!gc->length) o->position = p->offset + ref - begin;
+                    gc->elements[gc->length].node = p->node;
+                    gc->elements[gc->length++].cigar = (gssw_cigar*)calloc(1, sizeof(gssw_cigar));
+                }
+                if (on_ref && n > (uint32_t)(begin + p->len - ref)) n = begin + p->len - ref;
+                gssw_cigar_push_back(gc->elements[gc->length - 1].cigar, type, n);
+                if (on_ref) ref += n;
+                at = p->offset + ref - begin;
+                len -= n;
+            } while (len);
+        }
+    }
+    return o;
+}
+
 int8_t* gssw_create_num(const char* seq,
                         const int32_t len,
                         const int8_t* nt_table) {
@@ -18,16 +18,95 @@
 #include <stdbool.h>
 #include <smmintrin.h>
 
+/* SIMD instruction set tiers, from narrowest to widest vector */
+#define GSSW_SIMD_AUTO  0	// widest tier supported by the running CPU
+#define GSSW_SIMD_SSE41 1	// 128-bit, 16 x 8-bit, 8 x 16-bit or 4 x 32-bit lanes
+#define GSSW_SIMD_AVX2  2	// 256-bit, 32 x 8-bit, 16 x 16-bit or 8 x 32-bit lanes
+#define GSSW_SIMD_AVX512 3	// 512-bit (AVX-512BW), 64 x 8-bit, 32 x 16-bit or 16 x 32-bit lanes
+
+/* Correction of the vertical (F) gap dependency which the striped kernels leave after each column */
+#define GSSW_FCORR_SCAN 0	// log-step prefix max across the lanes, then a single pass down the column (default)
+#define GSSW_FCORR_LAZY 1	// Farrar's Lazy-F loop, passes down the column until F no longer changes H
+
+/* What the full fills keep of every cell for the traceback */
+#define GSSW_MATRIX_H   0	// the score, in mH (default)
+#define GSSW_MATRIX_DIR 1	// 4 direction bits, in mD: 1/2, 1/4 or 1/8 of the memory of 8-, 16- or 32-bit scores
+#define GSSW_MATRIX_CKPT 2	// every k-th column, in ckpt, mH being recomputed from them (see gssw_checkpoint_set)
+#define GSSW_MATRIX_DELTA 3	// the score, in packed: 4-bit differences down the read, a column decoded at a time
+
 /*!	@typedef	structure of the query profile	*/
 struct gssw_profile;
 typedef struct gssw_profile gssw_profile;
 
+/*!	@typedef	memory handed out in bulk and taken back all at once, see gssw_arena_create	*/
+struct gssw_arena;
+typedef struct gssw_arena gssw_arena;
+
+/*!	@typedef	allocator hook of an arena, for arenas drawing on something else than the heap
+	@field	alloc	returns size bytes aligned to 64 bytes, or NULL; arenas call it for large chunks only
+	@field	free	releases what alloc returned
+	@field	data	passed to both
+*/
+typedef struct {
+    void* (*alloc) (size_t size, void* data);
+    void (*free) (void* p, void* data);
+    void* data;
+} gssw_allocator;
+
+/*!	@typedef	reusable memory for fills, see gssw_workspace_create	*/
+struct gssw_workspace;
+typedef struct gssw_workspace gssw_workspace;
+
+/*!	@typedef	structure of the alignment seed: the E and H vectors of the last column of a node, in the striped layout
+				of the instruction set in use (see gssw_simd_set)	*/
 typedef struct {
-    __m128i* pvE;
-    __m128i* pvHStore;
+    void* pvE;
+    void* pvHStore;
 } gssw_seed;
 
 
+/*!	@typedef	columns kept by a fill under GSSW_MATRIX_CKPT, from which the traceback recomputes mH a block at a time
+	@field	pv	count pairs of striped H and E columns, pair b being those the fill had before reference position b*k;
+				0 if the fill is not checkpointed
+	@field	k	reference positions per block
+	@field	count	blocks
+	@field	len	reference length
+	@field	end	reference positions filled, fewer than len where X-drop stopped the fill
+	@field	ref	what a block is recomputed from: the reference, the profile of the width of the fill and its parameters,
+				which have to outlive the traceback; the traceback refills the blocks into memory of its own
+*/
+typedef struct {
+    void* pv;
+    int32_t k;
+    int32_t count;
+    int32_t len;
+    int32_t end;
+    const int8_t* ref;
+    const void* profile;
+    int32_t readLen;
+    uint8_t gapO;
+    uint8_t gapE;
+    uint8_t bias;
+    int8_t simd;
+} gssw_checkpoints;
+
+/*!	@typedef	H matrix of a fill under GSSW_MATRIX_DELTA: per column the first segment in full, then the difference of
+				every further segment to the one before, lane by lane, as 4 signed bits, 2, 4 or 8 segments to a vector
+				for 8-, 16- or 32-bit scores
+	@field	m	the columns, stride bytes each; 0 if the fill is not packed
+	@field	stride	bytes per column
+	@field	unpack	decodes column m + i*stride into a striped column of mH, by the kernel that packed it; the
+					traceback decodes the columns it reads into memory of its own
+	@field	overflow	1 if a difference did not fit 4 bits after all, and m cannot be decoded: the fill functions fill
+					again keeping mH
+*/
+typedef struct {
+    void* m;
+    int32_t stride;
+    void (*unpack) (const void* in, int32_t segLen, void* out);
+    int8_t overflow;
+} gssw_packed;
+
 /*!	@typedef	structure of the alignment result
 	@field	score1	the best alignment score
 	@field	score2	sub-optimal alignment score
@@ -37,26 +116,68 @@ typedef struct {
 	@field	read_begin1	0-based best alignment beginning position on read; read_begin1 = -1 when the best alignment beginning
 						position is not available
 	@field	read_end1	0-based best alignment ending position on read
-	@field	read_end2	0-based sub-optimal alignment ending position on read
+	@field	ref_end2	0-based sub-optimal alignment ending position on reference, more than maskLen from ref_end1; -1 when
+						there is none or maskLen < 15
 	@field	cigar	best alignment cigar; stored the same as that in BAM format, high 28 bits: length, low 4 bits: M/I/D (0/1/2);
 					cigar = 0 when the best alignment path is not available
 	@field	cigarLen	length of the cigar string; cigarLen = 0 when the best alignment path is not available
+	@field	is_byte	1 if the fill used 8-bit scores (score_width == 1), kept for older callers
+	@field	score_width	bytes per score of the fill and its seed: 1, 2 or 4
+	@field	mH	score matrix of the fill, one column per reference position; cell (i, j) is at gssw_mH_index(a, i, j)
+	@field	mH_stride	mH elements per reference column
+	@field	mH_seg	read positions per segment: read position j is in segment j % mH_seg, lane j / mH_seg
+	@field	mH_lanes	lanes per segment
+	@field	mH_lane	lane offset of this alignment, for matrices shared by the reads of a batch fill (one read per lane)
+	@field	mD	direction bits of the fill instead of mH, under GSSW_MATRIX_DIR (see gssw_matrix_set), striped as mH is;
+				0 otherwise
+	@field	ckpt	the checkpoints of the fill instead of mH, under GSSW_MATRIX_CKPT
+	@field	packed	H of the fill, packed, instead of mH under GSSW_MATRIX_DELTA
+	@field	f_iterations	vector steps the fill spent on the vertical gap correction (see gssw_fcorr_set), for comparing
+						the correction modes on gap-heavy input
+	@field	band_w	0 for a full fill; for a banded fill (gssw_graph_fill_banded) the cells per column of mH and of the
+					seed: column i holds read positions band_lo + i ... band_lo + i + band_w - 1 in order, and reads
+					outside them as 0
+	@field	band_lo	read position of the first cell of column 0 of a banded fill, may be negative
+	@field	max_column	best score of each reference column, kept by fills with maskLen >= 15 for the 2nd best search;
+						0 otherwise
+	@field	in_workspace	1 if mH, seed and max_column live in a gssw_workspace: they are not freed with the alignment, and
+						only valid until the workspace is reset
+	@field	in_mapping	1 if mH, mD or packed.m is mapped memory (see gssw_matrix_backend_set)
 */
 typedef struct {
-	uint16_t score1;
-	uint16_t score2;
+	uint32_t score1;
+	uint32_t score2;
 	int32_t ref_begin1;
 	int32_t ref_end1;
 	int32_t	read_begin1;
 	int32_t read_end1;
 	int32_t ref_end2;
+	uint32_t* cigar;
+	int32_t cigarLen;
     gssw_seed seed;
     uint8_t is_byte;
+    uint8_t score_width;
     void* mH;
+    int32_t mH_stride;
+    int32_t mH_seg;
+    int32_t mH_lanes;
+    int32_t mH_lane;
+    uint8_t* mD;
+    gssw_checkpoints ckpt;
+    gssw_packed packed;
+    uint64_t f_iterations;
+    int32_t band_lo;
+    int32_t band_w;
+    uint32_t* max_column;
+    uint8_t in_workspace;
+    uint8_t in_mapping;
 } gssw_align;
 
+/* offset of cell (reference position i, read position j) in the mH of alignment a, unless it is banded */
+#define gssw_mH_index(a, i, j) ((i) * (a)->mH_stride + ((j) % (a)->mH_seg) * (a)->mH_lanes + (j) / (a)->mH_seg + (a)->mH_lane)
+
 typedef struct {
-	uint16_t score;
+	uint32_t score;
 	int32_t ref;	 //0-based position
 	int32_t read;    //alignment ending position on read, 0-based
 } gssw_alignment_end;
@@ -69,16 +190,20 @@ typedef struct {
 typedef struct {
     int32_t length;
     gssw_cigar_element* elements;
+    int32_t capacity; // elements allocated, 0 meaning just length
 } gssw_cigar;
 
 struct gssw_profile{
-	__m128i* profile_byte;	// 0: none
-	__m128i* profile_word;	// 0: none
+	void* profile_byte;	// 0: none
+	void* profile_word;	// 0: none
+	void* profile_dword;	// 0: none, built on demand when 16-bit scores overflow
+	void* profile_band;	// 0: none, built on demand by the banded fill
 	const int8_t* read;
 	const int8_t* mat;
 	int32_t readLen;
 	int32_t n;
 	uint8_t bias;
+	int8_t simd;	// GSSW_SIMD_* tier the profile is striped for
 };
 
 //struct node;
@@ -95,6 +220,7 @@ typedef struct _gssw_node {
     gssw_node** next;
     int32_t count_next;
     gssw_align* alignment;
+    gssw_arena* arena; // holds the node, its edges and alignment, see gssw_node_create_arena; 0: the heap
 } _gssw_node;
 
 typedef struct {
@@ -111,10 +237,15 @@ typedef struct {
     gssw_alignment_end end;
 } gssw_node_alignment_end;
 
+/* second_best: where the best alignment ending more than maskLen reference positions from the end of the best one
+   (along the edges of the graph) ends, filled when the graph fill is given maskLen >= 15; end.read is not tracked */
 typedef struct {
     uint32_t size;
     gssw_node* max_node;
     gssw_node** nodes;
+    gssw_node_alignment_end second_best;
+    gssw_arena* arena; // owned by the graph, see gssw_graph_create_arena; 0: the heap
+    gssw_profile* profile; // of the last fill if it was checkpointed, for its traceback; 0 otherwise
 } gssw_graph;
 
 typedef struct {
@@ -129,23 +260,136 @@ typedef struct {
 
 typedef struct {
     int32_t position; // position in first node
-    int16_t score;
+    int32_t score;
     gssw_graph_cigar cigar;
+    int32_t score2; // sub-optimal score, see gssw_graph.second_best; 0 if none
+    gssw_node* node2; // node the sub-optimal alignment ends in
+    int32_t ref_end2; // and its end in that node
+    gssw_arena* arena; // holds the mapping, see gssw_graph_trace_back_arena; 0: the heap
 } gssw_graph_mapping;
 
+/* what fills of a graph leave for their traceback, kept apart from the graph; see gssw_graph_context_create */
+typedef struct gssw_graph_context gssw_graph_context;
+
+/* A graph compiled for filling, see gssw_graph_compile: a single block holding the edges as index arrays and the
+   encoded sequences of all nodes back to back, in topological order.  Node i is graph.nodes[i]. */
+typedef struct {
+    gssw_graph graph;	// the nodes of the source graph in compiled order, for contexts and mappings; never filled
+    uint32_t* prev_at;	// predecessors of node i: prev[prev_at[i]] ... prev[prev_at[i + 1] - 1]
+    uint32_t* prev;
+    uint32_t* next_at;	// successors of node i: next[next_at[i]] ... next[next_at[i + 1] - 1]
+    uint32_t* next;
+    uint64_t* num_at;	// encoded sequence of node i: num[num_at[i]] ... num[num_at[i + 1] - 1]
+    int8_t* num;
+    uint32_t max_prev;	// the most predecessors any node has
+} gssw_graph_compiled;
+
+/* len bases of a node of the graph given gssw_graph_normalize, from offset on */
+typedef struct {
+    gssw_node* node;
+    int32_t offset;
+    int32_t len;
+} gssw_node_piece;
+
+/* A graph with its unary chains merged and its long nodes chopped, see gssw_graph_normalize. */
+typedef struct {
+    gssw_graph* graph;	// the normalized graph, node i having id i
+    gssw_node_piece* pieces;	// node i is pieces[piece_at[i]] ... pieces[piece_at[i + 1] - 1] of the source, in order
+    uint32_t* piece_at;
+} gssw_graph_normalized;
+
 
 
 #ifdef __cplusplus
 extern "C" {
 #endif // __cplusplus
 
+/*!	@function	Select the instruction set used by profiles created from now on.
+	@param	level	one of GSSW_SIMD_*; GSSW_SIMD_AUTO, or a tier the CPU does not support, selects the widest supported tier
+	@return	the tier in effect
+	@note	By default the widest tier is detected (via cpuid) once, on first use, so one build runs on SSE4.1-only,
+			AVX2 and AVX-512BW hosts.  Profiles and seeds are striped for one tier, so change it only between alignments.
+*/
+int8_t gssw_simd_set (int8_t level);
+
+/*!	@function	Return the instruction set tier in effect (never GSSW_SIMD_AUTO).	*/
+int8_t gssw_simd_get (void);
+
+/*!	@function	Return a printable name for the given tier (GSSW_SIMD_AUTO: the tier in effect).	*/
+const char* gssw_simd_name (int8_t level);
+
+/*!	@function	Select how the striped kernels correct the vertical gap dependency, GSSW_FCORR_SCAN or GSSW_FCORR_LAZY, by
+				default (see gssw_matrix_set).
+	@return	the mode in effect
+	@note	Both correct every cell that needs it and fold the corrected cells into the column maxima, so they leave the
+			same H and give the same alignments under every matrix mode.  The Lazy-F loop may take up to one pass over
+			the column per lane on gap-heavy reads, the prefix scan takes log2(lanes) steps and at most one pass.
+*/
+int8_t gssw_fcorr_set (int8_t mode);
+
+/*!	@function	Return the vertical gap correction mode in effect.	*/
+int8_t gssw_fcorr_get (void);
+
+/*!	@function	Select what fills from now on keep for the traceback, GSSW_MATRIX_H, GSSW_MATRIX_DIR, GSSW_MATRIX_CKPT or
+				GSSW_MATRIX_DELTA.
+	@return	the mode in effect
+	@discussion	This mode, the checkpoint interval and the vertical gap correction are defaults for the whole process,
+				which any thread may change: a fill reads them once, as it starts.  Fills through a graph context use
+				its own settings instead (see gssw_graph_context_matrix_set), so threads can fill the same graph in
+				different modes.
+	@note	With GSSW_MATRIX_DIR the kernels record where every score came from (the diagonal, an opened or extended
+			gap) and the tracebacks follow that rather than recomputing it from the scores, so the matrix takes 4 bits
+			per cell.  Among equally scoring paths it may pick another than the traceback over mH does.  Banded and batch
+			fills keep mH whatever the mode, and gssw_print_score_matrix has no scores to print from mD.
+			With GSSW_MATRIX_CKPT node and graph fills keep the H and E columns before every k-th reference position
+			(see gssw_checkpoint_set), and the traceback refills the block of k columns it is in from them, with the same
+			results as over mH.  gssw_fill keeps mH.
+			With GSSW_MATRIX_DELTA the kernels keep every column of H as 4-bit differences between neighbouring
+			segments, about 1/2, 1/4 or 1/8 of mH, and the traceback decodes the two columns it is reading at a time,
+			with the same results as over mH.  Fills where a difference may not fit, with a gap open above 8 or the
+			best match and the gap open above 7 together, keep mH; the kernels check every difference as they pack it,
+			and a fill where one did not fit after all is done again keeping mH.
+*/
+int8_t gssw_matrix_set (int8_t mode);
+
+/*!	@function	Return the traceback matrix mode in effect.	*/
+int8_t gssw_matrix_get (void);
+
+/*!	@function	Map the matrices of fills without a workspace from threshold bytes on, rather than taking them from the heap.
+	@param	threshold	bytes of a matrix (mH, mD or packed H, see gssw_matrix_set) from which it is mapped; 0, the
+					default, for never
+	@param	dir	NULL for anonymous memory, with a hint to back it with transparent huge pages; otherwise a directory,
+				preferably on a local disk, for a file holding the matrix (removed at once), which the kernel can page
+				out under memory pressure
+	@return	0, or -1 if dir is not writable, in which case nothing is mapped
+	@discussion	It may be called while fills run on other threads: each matrix is mapped as the backend in effect
+				when it is allocated says.
+	@note	A fill which cannot get the memory for its matrix, mapped or not, fails rather than exiting: gssw_fill and
+			gssw_node_fill return 0, and graph fills 0 with the graph left partly filled.
+*/
+int32_t gssw_matrix_backend_set (size_t threshold, const char* dir);
+
+/*!	@function	Set the default reference positions between checkpoints of fills under GSSW_MATRIX_CKPT, 64 to begin with
+				(see gssw_matrix_set).
+	@return	the interval in effect, at least 1
+	@discussion	A fill keeps 2/k of the memory mH would take, and the traceback holds one block of k columns of mH at a
+				time, refilling every block it crosses once: about one more fill of the columns along the alignment.
+				The profile given gssw_node_fill has to outlive the traceback of the node; graph fills keep theirs in
+				the graph until the next fill.
+*/
+int32_t gssw_checkpoint_set (int32_t k);
+
+/*!	@function	Return the interval between checkpoints in effect.	*/
+int32_t gssw_checkpoint_get (void);
+
 /*!	@function	Create the query profile using the query sequence.
 	@param	read	pointer to the query sequence; the query sequence needs to be numbers
 	@param	readLen	length of the query sequence
 	@param	mat	pointer to the substitution matrix; mat needs to be corresponding to the read sequence
 	@param	n	the square root of the number of elements in mat (mat has n*n elements)
 	@param	score_size	estimated Smith-Waterman score; if your estimated best alignment score is surely < 255 please set 0; if
-						your estimated best alignment score >= 255, please set 1; if you don't know, please set 2
+						your estimated best alignment score >= 255, please set 1; if you don't know, please set 2; scores which
+						overflow 16 bits are recomputed with 32-bit lanes by the fill functions, so no setting is needed for them
 	@return	pointer to the query profile structure
 	@note	example for parameter read and mat:
 			If the query sequence is: ACGTATC, the sequence that read points to can be: 1234142
@@ -199,6 +443,12 @@ gssw_align* gssw_align_create(void);
 			and the optimal alignment ending positions on target and query sequences. If both bit 6 and 7 of the flag are setted
 			while bit 8 is not, the function will return cigar only when both criteria are fulfilled. All returned positions are
 			0-based coordinate.
+	@discussion	Only the rolling columns of the reference are kept: the end is found by a score-only fill, the beginning by
+				one backwards from it, and the cigar by a fill of the window between the two with direction bits
+				(whatever gssw_matrix_set says), so the memory goes with the alignment rather than the reference.  The
+				flag bits 5, 6, 7 and 8 are the values 8, 4, 2 and 1.  The cigar is left out (NULL) if the window cannot be
+				allocated or does not trace back from its corner to its corner, and so are the beginnings (-1) if the
+				backward pass cannot.  prof->read has to be the numbers of the read.
 */
 gssw_align* gssw_ssw_align (const gssw_profile* prof,
                             const int8_t* ref,
@@ -280,9 +530,11 @@ void gssw_graph_print_stderr(gssw_graph* graph);
 /*! @function         Trace back alignment across score matrix stored in alignment structure
     @param alignment  Alignment structure.
     @param end        Alignment ending position.
+    @discussion       Over direction bits (GSSW_MATRIX_DIR) *score is no longer counted down: it is 0 where the alignment
+                      begins inside the matrix, and the score of the alignment where it goes on through column 0.
 */
 gssw_cigar* gssw_alignment_trace_back_byte (gssw_align* alignment,
-                                            uint16_t* score,
+                                            uint32_t* score,
                                             int32_t* refEnd,
                                             int32_t* readEnd,
                                             const char* ref,
@@ -295,7 +547,7 @@ gssw_cigar* gssw_alignment_trace_back_byte (gssw_align* alignment,
                                             int32_t gap_extension);
 
 gssw_cigar* gssw_alignment_trace_back_word (gssw_align* alignment,
-                                            uint16_t* score,
+                                            uint32_t* score,
                                             int32_t* refEnd,
                                             int32_t* readEnd,
                                             const char* ref,
@@ -307,8 +559,25 @@ gssw_cigar* gssw_alignment_trace_back_word (gssw_align* alignment,
                                             int32_t gap_open,
                                             int32_t gap_extension);
 
+gssw_cigar* gssw_alignment_trace_back_dword (gssw_align* alignment,
+                                             uint32_t* score,
+                                             int32_t* refEnd,
+                                             int32_t* readEnd,
+                                             const char* ref,
+                                             int32_t refLen,
+                                             const char* read,
+                                             int32_t readLen,
+                                             int32_t match,
+                                             int32_t mismatch,
+                                             int32_t gap_open,
+                                             int32_t gap_extension);
+
+/*!	@function	Trace alignment back from (*refEnd, *readEnd), leaving there the cell before the first one of the cigar
+				and in score the score left.  NULL if there is no memory for the cigar, or for a block of a
+				checkpointed fill to be recomputed; the same holds for the width specific entry points above.
+*/
 gssw_cigar* gssw_alignment_trace_back (gssw_align* alignment,
-                                       uint16_t* score,
+                                       uint32_t* score,
                                        int32_t* refEnd,
                                        int32_t* readEnd,
                                        const char* ref,
@@ -320,6 +589,10 @@ gssw_cigar* gssw_alignment_trace_back (gssw_align* alignment,
                                        int32_t gap_open,
                                        int32_t gap_extension);
 
+/*!	@function	Trace the last fill of graph back from its best end into a mapping: NULL if memory for the mapping,
+				its cigars or the blocks of a checkpointed fill runs out, the fill being left as it was, and NULL with a
+				message if there is no fill to trace back (none yet, a failed one, or a score-only one).
+*/
 gssw_graph_mapping* gssw_graph_trace_back (gssw_graph* graph,
                                            const char* read,
                                            int32_t readLen,
@@ -327,8 +600,22 @@ gssw_graph_mapping* gssw_graph_trace_back (gssw_graph* graph,
                                            int32_t mismatch,
                                            int32_t gap_open,
                                            int32_t gap_extension);
+
+/*!	@function	gssw_graph_trace_back taking the mapping, its cigars and all they point to from arena.
+	@discussion	The mapping is released with the arena, by gssw_arena_reset once it has been consumed;
+				gssw_graph_mapping_destroy leaves it alone.  No heap calls are made.  NULL if the arena runs out,
+				what was taken of it going with the next reset.
+*/
+gssw_graph_mapping* gssw_graph_trace_back_arena (gssw_graph* graph,
+                                                 const char* read,
+                                                 int32_t readLen,
+                                                 int32_t match,
+                                                 int32_t mismatch,
+                                                 int32_t gap_open,
+                                                 int32_t gap_extension,
+                                                 gssw_arena* arena);
     
-/*! @function         Return 1 if the alignment is in 16/128bit (byte sized) or 0 if word-sized.
+/*! @function         Return 1 if the alignment is in 16/128bit (byte sized) or 0 if word or dword-sized.
     @param alignment  Alignment structure.
 */
 int gssw_is_byte (gssw_align* alignment);
@@ -344,6 +631,7 @@ void gssw_profile_destroy(gssw_profile* prof);
 void gssw_seed_destroy(gssw_seed* seed);
 gssw_seed* gssw_create_seed_byte(int32_t readLen, gssw_node** prev, int32_t count);
 gssw_seed* gssw_create_seed_word(int32_t readLen, gssw_node** prev, int32_t count);
+gssw_seed* gssw_create_seed_dword(int32_t readLen, gssw_node** prev, int32_t count);
 
 void gssw_cigar_push_back(gssw_cigar* c, char type, uint32_t length);
 void gssw_cigar_push_front(gssw_cigar* c, char type, uint32_t length);
@@ -351,11 +639,28 @@ void gssw_reverse_cigar(gssw_cigar* c);
 void gssw_print_cigar(gssw_cigar* c);
 void gssw_cigar_destroy(gssw_cigar* c);
 
+/*!	@function	Pack a cigar into BAM-style operations.
+	@param	c	cigar to pack
+	@param	ops	array of at least c->length operations to write to, or NULL to allocate one (free it with free())
+	@return	ops, each element being length<<4 | op, where op is the index of the type in "MIDNSHP=X"
+*/
+uint32_t* gssw_cigar_to_bam(const gssw_cigar* c, uint32_t* ops);
+
 gssw_node* gssw_node_create(void* data,
                             const uint32_t id,
                             const char* seq,
                             const int8_t* nt_table,
                             const int8_t* score_matrix);
+/*!	@function	gssw_node_create with the node, its sequence and edges taken from arena, normally the arena of the graph
+				it is added to (see gssw_graph_create_arena).  Its alignment is recycled from fill to fill, and the
+				matrices come from the heap or from the workspace of the fill.  NULL if the arena runs out.
+*/
+gssw_node* gssw_node_create_arena(void* data,
+                                  const uint32_t id,
+                                  const char* seq,
+                                  const int8_t* nt_table,
+                                  const int8_t* score_matrix,
+                                  gssw_arena* arena);
 void gssw_node_destroy(gssw_node* n);
 void gssw_node_add_prev(gssw_node* n, gssw_node* m);
 void gssw_node_add_next(gssw_node* n, gssw_node* m);
@@ -375,6 +680,18 @@ gssw_node_fill (gssw_node* node,
                 const int32_t maskLen,
                 const gssw_seed* seed);
 
+/*!	@function	gssw_node_fill taking the matrix and seed of the node from the workspace ws; they stay valid until it is
+				reset.
+*/
+gssw_node*
+gssw_node_fill_ws (gssw_node* node,
+                   const gssw_profile* prof,
+                   const uint8_t weight_gapO,
+                   const uint8_t weight_gapE,
+                   const int32_t maskLen,
+                   const gssw_seed* seed,
+                   gssw_workspace* ws);
+
 gssw_graph*
 gssw_graph_fill (gssw_graph* graph,
                  const char* read_seq,
@@ -385,9 +702,298 @@ gssw_graph_fill (gssw_graph* graph,
                  const int32_t maskLen,
                  const int8_t score_size);
 
+/*!	@function	gssw_graph_fill with X-drop termination, for extending seeds over large graphs.
+	@param	xdrop	a node stops at the first column whose best cell is more than xdrop below the best score seen so far
+					in the fill, and everything after it reads as 0; nodes whose merged seeds cannot get within xdrop of
+					it are skipped without filling.  xdrop < 0 fills everything, as gssw_graph_fill does.
+	@note	Like any X-drop this is a heuristic: local alignments starting afresh inside a dropped region are not found.
+*/
+gssw_graph*
+gssw_graph_fill_xdrop (gssw_graph* graph,
+                       const char* read_seq,
+                       const int8_t* nt_table,
+                       const int8_t* score_matrix,
+                       const uint8_t weight_gapO,
+                       const uint8_t weight_gapE,
+                       const int32_t maskLen,
+                       const int8_t score_size,
+                       const int32_t xdrop);
+
+/*!	@function	gssw_graph_fill on several threads: a node is filled as soon as all its predecessors are, by whichever
+				thread is free, so the nodes of a bubble are filled side by side.
+	@param	threads	threads to fill on, the calling one included; 1 or less fills on the calling thread
+	@discussion	Every thread takes the nodes it made ready first and steals from the others when it runs out.  The results
+				are those of gssw_graph_fill, the best node included.  graph->nodes has to be in topological order,
+				otherwise the nodes are filled one by one in that order as gssw_graph_fill does.  The graph and its nodes
+				must not be touched by anything else until the fill returns.
+*/
+gssw_graph*
+gssw_graph_fill_parallel (gssw_graph* graph,
+                          const char* read_seq,
+                          const int8_t* nt_table,
+                          const int8_t* score_matrix,
+                          const uint8_t weight_gapO,
+                          const uint8_t weight_gapE,
+                          const int32_t maskLen,
+                          const int8_t score_size,
+                          const int32_t threads);
+
+/*!	@function	Create a context for fills of graph: the alignment of every node, the best node and the second best end,
+				which gssw_graph_fill would leave in the nodes and the graph.
+	@discussion	Fills and tracebacks through contexts only read the graph, so threads can align reads against the same
+				graph at once, each with a context of its own, reused from read to read.  The graph must not change
+				(nodes, edges or their order) while it has contexts; nodes outside it which precede its nodes are read
+				as gssw_graph_fill reads them, from their own alignments.
+	@return	the context, released by gssw_graph_context_destroy
+*/
+gssw_graph_context* gssw_graph_context_create (const gssw_graph* graph);
+
+/*!	@function	Set the matrix mode (see gssw_matrix_set), checkpoint interval (see gssw_checkpoint_set) or vertical gap
+				correction (see gssw_fcorr_set) of the fills of ctx, which start out with the defaults in effect when it
+				was created.
+	@return	the setting in effect
+*/
+int8_t gssw_graph_context_matrix_set (gssw_graph_context* ctx, int8_t mode);
+int32_t gssw_graph_context_checkpoint_set (gssw_graph_context* ctx, int32_t k);
+int8_t gssw_graph_context_fcorr_set (gssw_graph_context* ctx, int8_t mode);
+
+/*!	@function	Release the context, the alignments of its last fill included.	*/
+void gssw_graph_context_destroy (gssw_graph_context* ctx);
+
+/*!	@function	gssw_graph_fill of the graph of ctx, leaving the graph untouched and the results in ctx.
+	@return	ctx; 0 if a node could not get its matrix, or was reached before one of its predecessors
+*/
+gssw_graph_context*
+gssw_graph_fill_context (gssw_graph_context* ctx,
+                         const char* read_seq,
+                         const int8_t* nt_table,
+                         const int8_t* score_matrix,
+                         const uint8_t weight_gapO,
+                         const uint8_t weight_gapE,
+                         const int32_t maskLen,
+                         const int8_t score_size);
+
+/*!	@function	gssw_graph_trace_back of the last fill of ctx.	*/
+gssw_graph_mapping* gssw_graph_trace_back_context (gssw_graph_context* ctx,
+                                                   const char* read,
+                                                   int32_t readLen,
+                                                   int32_t match,
+                                                   int32_t mismatch,
+                                                   int32_t gap_open,
+                                                   int32_t gap_extension);
+
+/*!	@function	The node the best alignment of the last fill of ctx ends in; 0 before the first.	*/
+gssw_node* gssw_graph_context_best (const gssw_graph_context* ctx);
+
+/*!	@function	The alignment node got in the last fill of ctx, what gssw_graph_fill leaves in node->alignment.	*/
+const gssw_align* gssw_graph_context_alignment (gssw_graph_context* ctx, const gssw_node* node);
+
+/*!	@function	Compile graph for filling: its edges become index arrays and the encoded sequences of its nodes one
+				buffer, all in a single block, so that fills walk memory in order rather than chase the nodes.
+	@discussion	The nodes are ordered as gssw_graph_sort would order graph->nodes, which is left as it is.  Edges from
+				nodes outside the graph are left out, alignments start afresh in their successors.  The nodes are
+				referred to, not copied: they must outlive the compiled graph and not change.  It is filled and traced
+				back through contexts of gssw_graph_context_compiled.
+	@return	the compiled graph, released by gssw_graph_compiled_destroy; 0 if the graph has a cycle or there is no
+			memory for it
+*/
+gssw_graph_compiled* gssw_graph_compile (const gssw_graph* graph);
+
+/*!	@function	Release a compiled graph; its contexts must be destroyed first.	*/
+void gssw_graph_compiled_destroy (gssw_graph_compiled* cg);
+
+/*!	@function	Create a context for fills of a compiled graph, which gssw_graph_fill_context then runs on the index arrays
+				of cg rather than the nodes; gssw_graph_trace_back_context traces them back as usual.
+*/
+gssw_graph_context* gssw_graph_context_compiled (const gssw_graph_compiled* cg);
+
+/*!	@function	Create an arena: memory handed out in chunks by gssw_arena_alloc, and taken back all at once by
+				gssw_arena_reset or gssw_arena_destroy.  Arenas are not locked, use one per thread.
+	@param	allocator	where the arena gets its chunks from; NULL for the heap
+	@return	the arena, or NULL if the allocator has no memory for it; an allocator failing later makes
+				gssw_arena_alloc return NULL, the arena going on as it was
+*/
+gssw_arena* gssw_arena_create (const gssw_allocator* allocator);
+
+/*!	@function	size bytes, aligned to 64 bytes, valid until the arena is reset; NULL if the allocator has no chunk for
+				them	*/
+void* gssw_arena_alloc (gssw_arena* arena, size_t size);
+
+/*!	@function	Take back all the memory handed out.  An arena which outgrew its chunk merges its chunks into one of the
+				size needed since the previous reset; after that, resets are O(1) and make no allocator calls.
+*/
+void gssw_arena_reset (gssw_arena* arena);
+
+void gssw_arena_destroy (gssw_arena* arena);
+
+/*!	@function	Create a workspace, the memory of the fills given it: one per thread, reused for read after read.
+	@discussion	The workspace grows to the largest fill it has seen and then keeps its memory, so that once warmed up a fill
+				makes no heap calls.  What those fills leave in the nodes (matrices, seeds) lives in the workspace, and is
+				only valid until it is reset, which gssw_graph_fill_ws does first thing.
+	@return	the workspace, release it with gssw_workspace_destroy once no node refers to it anymore
+*/
+gssw_workspace* gssw_workspace_create (void);
+
+/*!	@function	Hand all the memory of the workspace back to it, to be reused; the alignments filled in it become
+				invalid.
+*/
+void gssw_workspace_reset (gssw_workspace* ws);
+
+void gssw_workspace_destroy (gssw_workspace* ws);
+
+/*!	@function	gssw_graph_fill_xdrop using the memory of a workspace (see gssw_workspace_create) rather than the heap.
+	@discussion	The workspace is reset first, so the previous fill in it becomes invalid: trace it back before filling the
+				next read.  The results are the same as those of gssw_graph_fill_xdrop.
+*/
+gssw_graph*
+gssw_graph_fill_ws (gssw_graph* graph,
+                    const char* read_seq,
+                    const int8_t* nt_table,
+                    const int8_t* score_matrix,
+                    const uint8_t weight_gapO,
+                    const uint8_t weight_gapE,
+                    const int32_t maskLen,
+                    const int8_t score_size,
+                    const int32_t xdrop,
+                    gssw_workspace* ws);
+
+/*!	@function	Score-only gssw_graph_fill, for filtering reads before aligning them.
+	@discussion	Only the rolling columns and the per-node seeds are kept, no node allocates its mH.  The best score and
+				where it ends are in graph->max_node->alignment (score1, ref_end1, read_end1); the graph cannot be traced
+				back, fill it again with gssw_graph_fill for the reads which pass.
+*/
+gssw_graph*
+gssw_graph_fill_score (gssw_graph* graph,
+                       const char* read_seq,
+                       const int8_t* nt_table,
+                       const int8_t* score_matrix,
+                       const uint8_t weight_gapO,
+                       const uint8_t weight_gapE,
+                       const int8_t score_size);
+
+/*!	@function	gssw_graph_fill for graphs much larger than the alignments in them: a score-only fill of the whole graph
+				finds the best end, then only the nodes an alignment to it can go through are filled again, with their
+				matrices.
+	@discussion	Ending at read position e with score s, an alignment spans at most e + 1 + ((e + 1) * match - s) / gap
+				reference positions, gap being the smaller gap weight; nodes ending further upstream of the best end, and
+				all those not upstream of it, keep only their seeds.  gssw_graph_trace_back gives the same result as after
+				gssw_graph_fill, for the cost of filling the cone twice.
+*/
+gssw_graph*
+gssw_graph_fill_cone (gssw_graph* graph,
+                      const char* read_seq,
+                      const int8_t* nt_table,
+                      const int8_t* score_matrix,
+                      const uint8_t weight_gapO,
+                      const uint8_t weight_gapE,
+                      const int32_t maskLen,
+                      const int8_t score_size);
+
+/*!	@function	Fill the graph only within a band of diagonals, for reads whose placement is already known from a seed hit.
+	@param	read_offset	read position expected to align to the first base of the source nodes of the graph
+	@param	band_width	cells scored either side of the expected diagonal; the 2 * band_width + 1 cells are rounded up
+						to whole vectors of 16-bit lanes (a multiple of 8, 16 or 32 with SSE4.1, AVX2 or AVX-512), the extra
+						cells past the read positions above the diagonal.  The band follows the graph from the sources, and
+						where paths of different lengths meet it widens to cover the bands of all of them
+	@discussion	Cells outside the band read as 0, so the fill costs and stores O(band_width * graph length) rather than
+				O(read length * graph length).  Scores are 16-bit; if they saturate the graph is filled again by
+				gssw_graph_fill.  No second best alignment is reported.
+				The fill always keeps the scores (mH), whatever gssw_matrix_set, and gssw_graph_trace_back follows them
+				heuristically: the reported score and end are those of the band, but near its edges, or with narrow
+				bands, the cigar may not score the reported value.  Where an exact cigar is needed, fill the graph with
+				gssw_graph_fill under GSSW_MATRIX_DIR instead.
+	@return	graph; 0 if a node could not get its matrix
+*/
+gssw_graph*
+gssw_graph_fill_banded (gssw_graph* graph,
+                        const char* read_seq,
+                        const int8_t* nt_table,
+                        const int8_t* score_matrix,
+                        const uint8_t weight_gapO,
+                        const uint8_t weight_gapE,
+                        const int32_t read_offset,
+                        const int32_t band_width);
+
+/*!	@function	Banded fill of a single node, as done by gssw_graph_fill_banded for each node in order; the band is taken
+				from the (banded) predecessors, or from read_offset and band_width if there are none, widened to whole
+				vectors as there.
+	@return	node, or 0 if its 16-bit scores saturated or its matrix could not be allocated
+*/
+gssw_node*
+gssw_node_fill_banded (gssw_node* node,
+                       gssw_profile* prof,
+                       const uint8_t weight_gapO,
+                       const uint8_t weight_gapE,
+                       const int32_t read_offset,
+                       const int32_t band_width);
+
+/*!	@function	Align many reads against the graph at once, one read per vector lane.
+	@param	read_seqs	the reads; groups of as many reads as there are byte lanes (16 with SSE4.1, 32 with AVX2, 64 with
+						AVX-512BW) are filled together in one walk over the graph
+	@param	count	number of reads
+	@return	array of count graph mappings, in the order of read_seqs; release each with gssw_graph_mapping_destroy and the
+			array with free; a read whose matrices (or those of its group) could not be allocated has none (0)
+	@note	This pays off for many short reads, whose striped fill would be mostly per-column overhead.  The results are the
+			same as gssw_graph_fill followed by gssw_graph_trace_back for every read.  Groups in which some read scores
+			>= 255 are filled again with 16-bit lanes, and reads overflowing those are aligned one by one.  Afterwards
+			the nodes hold the fill of the last read of the last group.
+*/
+gssw_graph_mapping**
+gssw_graph_align_batch (gssw_graph* graph,
+                        const char** read_seqs,
+                        const int32_t count,
+                        const int8_t* nt_table,
+                        const int8_t* score_matrix,
+                        int32_t match,
+                        int32_t mismatch,
+                        int32_t gap_open,
+                        int32_t gap_extension);
+
 gssw_graph* gssw_graph_create(uint32_t size);
+/*!	@function	Create a graph drawing on an arena of its own (graph->arena), from allocator or the heap if it is NULL.
+	@discussion	Create its nodes with gssw_node_create_arena(..., graph->arena): gssw_graph_destroy then releases the graph
+				and all its nodes at once, rather than one allocation at a time.  NULL if the allocator has no memory
+				for the graph.  gssw_graph_add_node returns -1, leaving the graph as it was, when the arena has no room
+				for a larger array of nodes.
+*/
+gssw_graph* gssw_graph_create_arena(uint32_t size, const gssw_allocator* allocator);
 int32_t gssw_graph_add_node(gssw_graph* graph,
                             gssw_node* node);
+
+/*!	@function	Put graph->nodes in topological order, as the fills need them, in time linear in the edges but for
+				the lookup of each edge in a sorted index of the nodes.
+	@discussion	Nodes are taken depth first among those whose predecessors are all placed: the branches of a bubble come
+				one after the other, each in one piece, and the node joining them right after.  Nodes with no
+				predecessors, and the successors of a node, are taken in the order they are listed in.  Edges from and
+				to nodes outside the graph are left out.  The fills return 0, with a message pointing here, when they
+				reach a node before one of its predecessors.
+	@return	0; -1 if the edges within the graph have a cycle, leaving graph->nodes as it was
+*/
+int32_t gssw_graph_sort(gssw_graph* graph);
+
+/*!	@function	Normalize the node sizes of graph into a new graph: chains of nodes with a single successor whose only
+				predecessor they are become one node, and nodes (merged or not) longer than max_len are chopped into
+				nodes of about equal length, none longer than max_len.
+	@param	max_len	the longest node to keep whole; 0 or less to only merge
+	@discussion	Every new node records the pieces of the source nodes it is made of, so alignments to the new graph can be
+				put back in the coordinates of the source with gssw_graph_mapping_denormalize.  The new nodes come in the
+				order of graph->nodes, topological if it was, and have ids 0, 1, ...  Edges from and to nodes outside the
+				graph are left out.  The source graph is not changed and must outlive the normalized one.
+	@return	the normalized graph, released by gssw_graph_normalized_destroy
+*/
+gssw_graph_normalized* gssw_graph_normalize(const gssw_graph* graph,
+                                            const int32_t max_len,
+                                            const int8_t* nt_table,
+                                            const int8_t* score_matrix);
+
+/*!	@function	Release a normalized graph, its nodes included.	*/
+void gssw_graph_normalized_destroy(gssw_graph_normalized* gn);
+
+/*!	@function	The mapping m to the graph of gn, in nodes and offsets of the source graph: the cigar of a new node is cut
+				where its pieces meet, and pieces of one source node which follow each other join up again.
+	@return	a new mapping, released by gssw_graph_mapping_destroy; m is left as it is
+*/
+gssw_graph_mapping* gssw_graph_mapping_denormalize(const gssw_graph_normalized* gn, const gssw_graph_mapping* m);
 void gssw_graph_clear(gssw_graph* graph);
 void gssw_graph_destroy(gssw_graph* graph);
 void gssw_graph_print_score_matrices(gssw_graph* graph,
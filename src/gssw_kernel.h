@@ -0,0 +1,1917 @@
+/*
+ *  gssw_kernel.h
+ *
+ *  Striped Smith-Waterman kernels, written once against a small set of
+ *  vector macros and instantiated by gssw.c for every supported instruction
+ *  set (SSE4.1, AVX2, ...) and score width (byte, word, dword).  This file has no include guard on purpose: it is
+ *  included once per instruction set.
+ *
+ *  The including file must define:
+ *	GSSW_ISA	token appended to the generated function names (sse2, avx2, ...)
+ *	GSSW_TARGET	function attribute enabling the instruction set, may be empty
+ *	gssw_v		the vector type
+ *	GSSW_VSIZE	sizeof(gssw_v)
+ *	and the v* operations used below (see gssw.c).
+ *  All of these are undefined again at the end of this file.
+ */
+
+#define GSSW_LANES8  (GSSW_VSIZE)
+#define GSSW_LANES16 (GSSW_VSIZE / 2)
+#define GSSW_LANES32 (GSSW_VSIZE / 4)
+
+/* Generate query profile rearrange query sequence & calculate the weight of match/mismatch. */
+GSSW_TARGET
+void* GSSW_FN(gssw_qP, byte) (const int8_t* read_num,
+                               const int8_t* mat,
+                               const int32_t readLen,
+                               const int32_t n,	/* the edge length of the squre matrix mat */
+                               uint8_t bias,
+                               gssw_workspace* ws) {
+
+	int32_t segLen = (readLen + GSSW_LANES8 - 1) / GSSW_LANES8; /* Split the register into 8 bit pieces.
+								     Split the read into as many segments.
+								     Calculate the segments in parallel.
+								   */
+	gssw_v* vProfile = (gssw_v*)gssw_ws_alloc(ws, n * segLen * sizeof(gssw_v));
+	if (UNLIKELY(!vProfile)) return NULL;
+	int8_t* t = (int8_t*)vProfile;
+	int32_t nt, i, j, segNum;
+
+	/* Generate query profile rearrange query sequence & calculate the weight of match/mismatch */
+	for (nt = 0; LIKELY(nt < n); nt ++) {
+		for (i = 0; i < segLen; i ++) {
+			j = i;
+			for (segNum = 0; LIKELY(segNum < GSSW_LANES8) ; segNum ++) {
+				*t++ = j>= readLen ? bias : mat[nt * n + read_num[j]] + bias;
+				j += segLen;
+			}
+		}
+	}
+	return vProfile;
+}
+
+GSSW_TARGET
+void* GSSW_FN(gssw_qP, word) (const int8_t* read_num,
+                               const int8_t* mat,
+                               const int32_t readLen,
+                               const int32_t n,
+                               gssw_workspace* ws) {
+
+	int32_t segLen = (readLen + GSSW_LANES16 - 1) / GSSW_LANES16;
+	gssw_v* vProfile = (gssw_v*)gssw_ws_alloc(ws, n * segLen * sizeof(gssw_v));
+	if (UNLIKELY(!vProfile)) return NULL;
+	int16_t* t = (int16_t*)vProfile;
+	int32_t nt, i, j;
+	int32_t segNum;
+
+	/* Generate query profile rearrange query sequence & calculate the weight of match/mismatch */
+	for (nt = 0; LIKELY(nt < n); nt ++) {
+		for (i = 0; i < segLen; i ++) {
+			j = i;
+			for (segNum = 0; LIKELY(segNum < GSSW_LANES16) ; segNum ++) {
+				*t++ = j>= readLen ? 0 : mat[nt * n + read_num[j]];
+				j += segLen;
+			}
+		}
+	}
+	return vProfile;
+}
+
+GSSW_TARGET
+void* GSSW_FN(gssw_qP, dword) (const int8_t* read_num,
+                                const int8_t* mat,
+                                const int32_t readLen,
+                                const int32_t n,
+                                gssw_workspace* ws) {
+
+	int32_t segLen = (readLen + GSSW_LANES32 - 1) / GSSW_LANES32;
+	gssw_v* vProfile = (gssw_v*)gssw_ws_alloc(ws, n * segLen * sizeof(gssw_v));
+	if (UNLIKELY(!vProfile)) return NULL;
+	int32_t* t = (int32_t*)vProfile;
+	int32_t nt, i, j;
+	int32_t segNum;
+
+	for (nt = 0; LIKELY(nt < n); nt ++) {
+		for (i = 0; i < segLen; i ++) {
+			j = i;
+			for (segNum = 0; LIKELY(segNum < GSSW_LANES32) ; segNum ++) {
+				*t++ = j>= readLen ? 0 : mat[nt * n + read_num[j]];
+				j += segLen;
+			}
+		}
+	}
+	return vProfile;
+}
+
+/* Direction bits, kept instead of mH with store_mH == 2 (GSSW_MATRIX_DIR).  Four bit planes per cell, from lane-wide
+   masks:
+	s0 s1	where H came from: 11 nowhere (H = 0), 10 the diagonal, 01 E, 00 F
+	s2	the E leaving the cell for the next column was opened here rather than extended
+	s3	the F of the cell was opened at the read position before rather than extended
+   Every segment of a column keeps them as movemasks of the vector, 4 / w of them for w bytes per score: plane p of
+   lane l is bit l*w + p%w of movemask p/w, so the planes of a wider lane share its bytes and a cell takes 4 bits at
+   every width.  Ties go to the diagonal, then E, as in the traceback over mH. */
+#define GSSW_DIR_MASK (GSSW_VSIZE / 8) // bytes per movemask
+
+GSSW_TARGET
+static inline void GSSW_FN(gssw_dir_put, byte) (uint8_t* d, gssw_v s0, gssw_v s1, gssw_v s2, gssw_v s3) {
+	uint64_t m[4] = { vmovemask(s0), vmovemask(s1), vmovemask(s2), vmovemask(s3) };
+	int32_t p;
+	for (p = 0; p < 4; ++p) memcpy(d + p*GSSW_DIR_MASK, m + p, GSSW_DIR_MASK);
+}
+
+/* The F correction of a segment: where vF, coming down from the lanes below, beats the F the first pass had (*pF), F
+   extends it, or opens as open says for the first segment; where it beats H, H now comes from F. */
+GSSW_TARGET
+static inline void GSSW_FN(gssw_dir_fix, byte) (uint8_t* d, gssw_v vH, gssw_v vF, gssw_v* pF, gssw_v open) {
+	gssw_v f = vload(pF);
+	uint64_t rH = ~vmovemask(vcmpeq8(vsubs8u(vF, vH), vzero()));
+	uint64_t rF = ~vmovemask(vcmpeq8(vsubs8u(vF, f), vzero()));
+	uint64_t m[4] = { 0, 0, 0, 0 };
+	int32_t p;
+	vstore(pF, vmax8u(f, vF));
+	for (p = 0; p < 4; ++p) memcpy(m + p, d + p*GSSW_DIR_MASK, GSSW_DIR_MASK);
+	m[0] &= ~rH;
+	m[1] &= ~rH;
+	m[3] = (m[3] & ~rF) | (vmovemask(open) & rF);
+	for (p = 0; p < 4; ++p) memcpy(d + p*GSSW_DIR_MASK, m + p, GSSW_DIR_MASK);
+}
+
+GSSW_TARGET
+static inline void GSSW_FN(gssw_dir_put, word) (uint8_t* d, gssw_v s0, gssw_v s1, gssw_v s2, gssw_v s3) {
+	gssw_v lo = vset16(0x00ff), hi = vset16(-256);
+	uint64_t m[2] = { vmovemask(vor(vand(s0, lo), vand(s1, hi))), vmovemask(vor(vand(s2, lo), vand(s3, hi))) };
+	memcpy(d, m, GSSW_DIR_MASK);
+	memcpy(d + GSSW_DIR_MASK, m + 1, GSSW_DIR_MASK);
+}
+
+GSSW_TARGET
+static inline void GSSW_FN(gssw_dir_fix, word) (uint8_t* d, gssw_v vH, gssw_v vF, gssw_v* pF, gssw_v open) {
+	gssw_v f = vload(pF);
+	uint64_t rH = vmovemask(vcmpgt16(vF, vH));
+	uint64_t rF = vmovemask(vcmpgt16(vF, f)) & 0xaaaaaaaaaaaaaaaaULL; // high byte: plane 3
+	uint64_t m[2] = { 0, 0 };
+	vstore(pF, vmax16(f, vF));
+	memcpy(m, d, GSSW_DIR_MASK);
+	memcpy(m + 1, d + GSSW_DIR_MASK, GSSW_DIR_MASK);
+	m[0] &= ~rH;
+	m[1] = (m[1] & ~rF) | (vmovemask(open) & rF);
+	memcpy(d, m, GSSW_DIR_MASK);
+	memcpy(d + GSSW_DIR_MASK, m + 1, GSSW_DIR_MASK);
+}
+
+GSSW_TARGET
+static inline void GSSW_FN(gssw_dir_put, dword) (uint8_t* d, gssw_v s0, gssw_v s1, gssw_v s2, gssw_v s3) {
+	uint64_t m = vmovemask(vor(vor(vand(s0, vset32(0xff)), vand(s1, vset32(0xff00))),
+	                           vor(vand(s2, vset32(0xff0000)), vand(s3, vset32(0xff000000)))));
+	memcpy(d, &m, GSSW_DIR_MASK);
+}
+
+GSSW_TARGET
+static inline void GSSW_FN(gssw_dir_fix, dword) (uint8_t* d, gssw_v vH, gssw_v vF, gssw_v* pF, gssw_v open) {
+	gssw_v f = vload(pF);
+	uint64_t rH = vmovemask(vcmpgt32(vF, vH)) & 0x3333333333333333ULL; // bytes 0 and 1: planes 0 and 1
+	uint64_t rF = vmovemask(vcmpgt32(vF, f)) & 0x8888888888888888ULL;
+	uint64_t m = 0;
+	vstore(pF, vmax32(f, vF));
+	memcpy(&m, d, GSSW_DIR_MASK);
+	m = (m & ~rH & ~rF) | (vmovemask(open) & rF);
+	memcpy(d, &m, GSSW_DIR_MASK);
+}
+
+/* Packed H, kept instead of mH with store_mH == 4 (GSSW_MATRIX_DELTA).  A column is its first segment in full, then
+   the difference of segment s to segment s - 1 for s = 1 ... segLen - 1, lane by lane: read positions next to each
+   other, so within -gapO ... max_match + gapO, which the caller has checked fits 4 signed bits.  The differences of
+   GSSW_PACK segments share a vector, that of segment s in bits 4*((s - 1) % GSSW_PACK) of every lane.  The scores
+   wrap around their lanes, which decoding undoes.  Packing returns the lanes with a difference that did not fit after
+   all, for which the fill has to keep mH instead. */
+#define GSSW_PACK_BYTES(segLen, p) (GSSW_VSIZE * (1 + ((segLen) + (p) - 2) / (p))) // bytes per column
+
+GSSW_TARGET
+static inline gssw_v GSSW_FN(gssw_pack, byte) (gssw_v* out, const gssw_v* pvH, int32_t segLen) {
+	gssw_v prev = vload(pvH), acc = vzero(), nibble = vset8(0x0f), bad = vzero();
+	int32_t s;
+	vstore(out, prev);
+	for (s = 1; LIKELY(s < segLen); ++s) {
+		gssw_v h = vload(pvH + s), d = vand(vsub8(h, prev), nibble);
+		gssw_v up = vadds8u(prev, vset8(7)), down = vadds8u(h, vset8(8)); /* h - prev within -8 ... 7, unsigned */
+		bad = vor(bad, vandnot(vand(vcmpeq8(vmax8u(h, up), up), vcmpeq8(vmax8u(prev, down), down)), vset8(-1)));
+		acc = (s - 1) & 1 ? vor(acc, vsll16(d, 4)) : d; /* nothing crosses into the next byte */
+		if ((s - 1) & 1 || s == segLen - 1) vstore(out + 1 + (s - 1) / 2, acc);
+		prev = h;
+	}
+	return bad;
+}
+
+GSSW_TARGET
+static void GSSW_FN(gssw_unpack, byte) (const void* in, int32_t segLen, void* out) {
+	const gssw_v* p = (const gssw_v*)in;
+	gssw_v* o = (gssw_v*)out;
+	gssw_v h = vload(p), x = vzero(), nibble = vset8(0x0f), sign = vset8(0x08);
+	int32_t s;
+	vstore(o, h);
+	for (s = 1; LIKELY(s < segLen); ++s) {
+		if (!((s - 1) & 1)) x = vload(p + 1 + (s - 1) / 2);
+		h = vadd8(h, vsub8(vxor(vand(vsrl16(x, 4 * ((s - 1) & 1)), nibble), sign), sign));
+		vstore(o + s, h);
+	}
+}
+
+GSSW_TARGET
+static inline gssw_v GSSW_FN(gssw_pack, word) (gssw_v* out, const gssw_v* pvH, int32_t segLen) {
+	gssw_v prev = vload(pvH), acc = vzero(), nibble = vset16(0x0f), bad = vzero();
+	int32_t s;
+	vstore(out, prev);
+	for (s = 1; LIKELY(s < segLen); ++s) {
+		gssw_v h = vload(pvH + s), d = vsub16(h, prev);
+		bad = vor(bad, vor(vcmpgt16(d, vset16(7)), vcmpgt16(vset16(-8), d)));
+		d = vand(d, nibble);
+		acc = (s - 1) & 3 ? vor(acc, vsll16(d, 4 * ((s - 1) & 3))) : d;
+		if (((s - 1) & 3) == 3 || s == segLen - 1) vstore(out + 1 + (s - 1) / 4, acc);
+		prev = h;
+	}
+	return bad;
+}
+
+GSSW_TARGET
+static void GSSW_FN(gssw_unpack, word) (const void* in, int32_t segLen, void* out) {
+	const gssw_v* p = (const gssw_v*)in;
+	gssw_v* o = (gssw_v*)out;
+	gssw_v h = vload(p), x = vzero(), nibble = vset16(0x0f), sign = vset16(0x08);
+	int32_t s;
+	vstore(o, h);
+	for (s = 1; LIKELY(s < segLen); ++s) {
+		if (!((s - 1) & 3)) x = vload(p + 1 + (s - 1) / 4);
+		h = vadd16(h, vsub16(vxor(vand(vsrl16(x, 4 * ((s - 1) & 3)), nibble), sign), sign));
+		vstore(o + s, h);
+	}
+}
+
+GSSW_TARGET
+static inline gssw_v GSSW_FN(gssw_pack, dword) (gssw_v* out, const gssw_v* pvH, int32_t segLen) {
+	gssw_v prev = vload(pvH), acc = vzero(), nibble = vset32(0x0f), bad = vzero();
+	int32_t s;
+	vstore(out, prev);
+	for (s = 1; LIKELY(s < segLen); ++s) {
+		gssw_v h = vload(pvH + s), d = vsub32(h, prev);
+		bad = vor(bad, vor(vcmpgt32(d, vset32(7)), vcmpgt32(vset32(-8), d)));
+		d = vand(d, nibble);
+		acc = (s - 1) & 7 ? vor(acc, vsll32(d, 4 * ((s - 1) & 7))) : d;
+		if (((s - 1) & 7) == 7 || s == segLen - 1) vstore(out + 1 + (s - 1) / 8, acc);
+		prev = h;
+	}
+	return bad;
+}
+
+GSSW_TARGET
+static void GSSW_FN(gssw_unpack, dword) (const void* in, int32_t segLen, void* out) {
+	const gssw_v* p = (const gssw_v*)in;
+	gssw_v* o = (gssw_v*)out;
+	gssw_v h = vload(p), x = vzero(), nibble = vset32(0x0f), sign = vset32(0x08);
+	int32_t s;
+	vstore(o, h);
+	for (s = 1; LIKELY(s < segLen); ++s) {
+		if (!((s - 1) & 7)) x = vload(p + 1 + (s - 1) / 8);
+		h = vadd32(h, vsub32(vxor(vand(vsrl32(x, 4 * ((s - 1) & 7)), nibble), sign), sign));
+		vstore(o + s, h);
+	}
+}
+
+/* Striped Smith-Waterman
+   Record the highest score of each reference position.
+   Return the alignment score and ending position of the best alignment, 2nd best alignment, etc.
+   Gap begin and gap extension are different.
+   wight_match > 0, all other weights < 0.
+   The returned positions are 0-based.
+   X-drop (xdrop >= 0, forward only): once no cell of a column is within xdrop of the best score, counting xbest from
+   earlier fills, the remaining columns and the outgoing seed are left at 0, so nothing downstream extends through here.
+   With store_mH == 0 only the rolling columns and the seed are kept: alignment->mH stays NULL and cannot be traced back.
+   With store_mH == 2 alignment->mD gets the direction bits of every cell (see gssw_dir_put) rather than mH its scores,
+   with store_mH == 3 (forward only) alignment->ckpt the H and E columns before every k-th column, with store_mH == 4
+   alignment->packed every column of H packed (see gssw_pack).  Returns NULL if the matrix cannot be allocated.
+ */
+GSSW_TARGET
+gssw_alignment_end* GSSW_FN(gssw_sw, byte) (const int8_t* ref,
+                                            int8_t ref_dir,	// 0: forward ref; 1: reverse ref
+                                            int32_t refLen,
+                                            int32_t readLen,
+                                            const uint8_t weight_gapO, /* will be used as - */
+                                            const uint8_t weight_gapE, /* will be used as - */
+                                            const void* profile,
+                                            uint8_t terminate,	/* the best alignment score: used to terminate
+                                                                   the matrix calculation when locating the
+                                                                   alignment beginning point. If this score
+                                                                   is set to 0, it will not be used */
+                                            uint8_t bias,  /* Shift 0 point to a positive value. */
+                                            int32_t maskLen,
+                                            int32_t xdrop, /* < 0: off, see below */
+                                            uint32_t xbest, /* best score before this fill, for X-drop */
+                                            int8_t store_mH, /* 0: score only, mH is not allocated */
+                                            gssw_fill_settings set, /* vertical gap correction and checkpoints */
+                                            gssw_align* alignment, /* to save seed and matrix */
+                                            const gssw_seed* seed,     /* to seed the alignment */
+                                            gssw_workspace* ws) {       /* memory to reuse, or NULL */
+
+	uint8_t max = 0;		                     /* the max alignment score */
+	int32_t end_read = readLen - 1;
+	int32_t end_ref = -1; /* 0_based best alignment ending point; Initialized as isn't aligned -1. */
+	int32_t segLen = (readLen + GSSW_LANES8 - 1) / GSSW_LANES8; /* number of segment */
+	const gssw_v* vProfile = (const gssw_v*)profile;
+
+    /* Initialize buffers used in alignment */
+	gssw_v* pvHStore;
+    gssw_v* pvHLoad;
+    gssw_v* pvHmax;
+    gssw_v* pvE;
+    uint8_t* mH = NULL; // used to save matrix for external traceback
+    uint8_t* mD = NULL; // or the direction bits, see gssw_dir_put
+    int32_t colD = segLen*GSSW_VSIZE/2; // bytes of mD per column
+    uint8_t* mP = NULL; // or H packed, see gssw_pack
+    gssw_v vPackBad = vzero(); // lanes of mP with a difference which did not fit
+    int32_t colP = GSSW_PACK_BYTES(segLen, 2);
+    gssw_v* pvF = NULL; // F of the column, for the direction bits
+
+    /* The columns come from one scratch block, the seed and mH, which outlive the fill, from the arena of the
+       workspace (all from the heap without one) */
+    gssw_v* pvScratch = (gssw_v*)gssw_ws_scratch(ws, (store_mH == 2 ? 6 : 5)*segLen*sizeof(gssw_v));
+    pvHStore = pvScratch;
+    pvHLoad = pvScratch + segLen;
+    pvHmax = pvScratch + 2*segLen;
+    pvE = pvScratch + 3*segLen;
+    alignment->seed.pvE = (gssw_v*)gssw_ws_alloc(ws, segLen*sizeof(gssw_v));
+    alignment->seed.pvHStore = (gssw_v*)gssw_ws_alloc(ws, segLen*sizeof(gssw_v));
+    if (store_mH == 1) mH = gssw_matrix_alloc(ws, (size_t)segLen*refLen*sizeof(gssw_v), alignment);
+    if (store_mH == 4) mP = (uint8_t*)gssw_matrix_alloc(ws, (size_t)colP*refLen, alignment);
+    if (store_mH == 2) {
+        mD = (uint8_t*)gssw_matrix_alloc(ws, (size_t)colD*refLen, alignment);
+        pvF = pvScratch + 5*segLen;
+    }
+    alignment->in_workspace = ws != NULL;
+    /* Set external H matrix pointer, columns are stored striped just as they are computed */
+    alignment->mH = mH;
+    alignment->mD = mD;
+    alignment->packed.m = mP;
+    if (UNLIKELY(!pvScratch || !alignment->seed.pvE || !alignment->seed.pvHStore
+                 || ((store_mH == 1 || store_mH == 2 || store_mH == 4) && !mH && !mD && !mP))) {
+        gssw_ws_free(ws, pvScratch); /* no memory for the matrix or the seed, what was had goes with the alignment */
+        return NULL;
+    }
+
+    /* Workaround because we don't have an aligned calloc */
+    memset(pvHStore,                 0, segLen*sizeof(gssw_v));
+    memset(pvHLoad,                  0, segLen*sizeof(gssw_v));
+    memset(pvHmax,                   0, segLen*sizeof(gssw_v));
+    memset(pvE,                      0, segLen*sizeof(gssw_v));
+    memset(alignment->seed.pvE,      0, segLen*sizeof(gssw_v));
+    memset(alignment->seed.pvHStore, 0, segLen*sizeof(gssw_v));
+
+    /* if we are running a seeded alignment, copy over the seeds */
+    if (seed) {
+        memcpy(pvE, seed->pvE, segLen*sizeof(gssw_v));
+        memcpy(pvHStore, seed->pvHStore, segLen*sizeof(gssw_v));
+    }
+
+    alignment->packed.stride = colP;
+    alignment->packed.unpack = GSSW_FN(gssw_unpack, byte);
+    gssw_checkpoints* ckpt = NULL; // or the columns before every k-th one, see gssw_ckpt_init
+    if (store_mH == 3) {
+        ckpt = &alignment->ckpt;
+        gssw_ckpt_init(ckpt, set.ckpt, refLen, segLen*sizeof(gssw_v), ws);
+        if (UNLIKELY(!ckpt->pv)) {
+            gssw_ws_free(ws, pvScratch);
+            return NULL;
+        }
+    }
+    alignment->mH_stride = segLen * GSSW_LANES8;
+    alignment->mH_seg = segLen;
+    alignment->mH_lanes = GSSW_LANES8;
+    alignment->mH_lane = 0;
+
+    /* Record that we have done a byte-order alignment */
+    alignment->is_byte = 1;
+    alignment->score_width = 1;
+
+    /* best score of each column, for the 2nd best search (SSW reports none for maskLen < 15).  The lanes past the end
+       of the read carry stale scores along, so pvValid masks them out of the column maxima. */
+    uint32_t* maxColumn = NULL;
+    gssw_v* pvValid = NULL;
+    if (maskLen >= 15) {
+        int32_t r;
+        maxColumn = (uint32_t*)gssw_ws_alloc(ws, refLen*sizeof(uint32_t));
+        if (UNLIKELY(!maxColumn)) {
+            gssw_ws_free(ws, pvScratch);
+            return NULL;
+        }
+        memset(maxColumn, 0, refLen*sizeof(uint32_t));
+        pvValid = pvScratch + 4*segLen;
+        for (r = 0; r < segLen * GSSW_LANES8; ++r)
+            ((uint8_t*)pvValid)[r] = r / GSSW_LANES8 + r % GSSW_LANES8 * segLen < readLen ? -1 : 0;
+    }
+    alignment->max_column = maxColumn;
+
+	/* Define 0 vector. */
+	gssw_v vZero = vzero();
+
+    /* Used for iteration */
+	int32_t i, j, k, s;
+
+    /* insertion begin vector */
+	gssw_v vGapO = vset8(weight_gapO);
+
+	/* insertion extension vector */
+	gssw_v vGapE = vset8(weight_gapE);
+
+	/* bias vector */
+	gssw_v vBias = vset8(bias);
+
+	/* gap extension over k lanes worth of segments, k = 1, 2, 4, ..., for the prefix scan of F */
+	gssw_v vFDecay[8];
+	int8_t fscan = set.fcorr == GSSW_FCORR_SCAN;
+	uint64_t fsteps = 0;
+	for (k = 1, s = 0; k < GSSW_LANES8; k <<= 1, ++s) {
+		int64_t d = (int64_t)k * segLen * weight_gapE;
+		vFDecay[s] = vset8(d > 255 ? 255 : d);
+	}
+
+	gssw_v vMaxScore = vZero; /* Trace the highest score of the whole SW matrix. */
+	gssw_v vMaxMark = vZero; /* Trace the highest score till the previous column. */
+	gssw_v vTemp;
+	int32_t begin = 0, end = refLen, step = 1;
+
+	/* outer loop to process the reference sequence */
+	if (ref_dir == 1) {
+		begin = refLen - 1;
+		end = -1;
+		step = -1;
+	}
+	for (i = begin; LIKELY(i != end); i += step) {
+		if (ckpt && i % ckpt->k == 0) gssw_ckpt_put(ckpt, i / ckpt->k, pvHStore, pvE, segLen*sizeof(gssw_v));
+		gssw_v vFOpen = vZero, vOpen0; /* F opened rather than extended, for the direction bits */
+		gssw_v e = vZero, vF = vZero, vMaxColumn = vZero; /* Initialize F value to 0.
+							   Any errors to vH values will be corrected in the Lazy_F loop.
+							 */
+
+        gssw_v vH = vload (pvHStore + (segLen - 1));
+		vH = vshl8 (vH); /* Shift the value in vH left by 1 byte. */
+		const gssw_v* vP = vProfile + ref[i] * segLen; /* Right part of the vProfile */
+
+		/* Swap the 2 H buffers. */
+		gssw_v* pv = pvHLoad;
+		pvHLoad = pvHStore;
+		pvHStore = pv;
+
+		/* inner loop to process the query sequence */
+		if (LIKELY(!mD)) {
+			for (j = 0; LIKELY(j < segLen); ++j) {
+
+				vH = vadds8u(vH, vload(vP + j));
+				vH = vsubs8u(vH, vBias); /* vH will be always > 0 */
+
+				/* Get max from vH, vE and vF. */
+				e = vload(pvE + j);
+
+				vH = vmax8u(vH, e);
+				vH = vmax8u(vH, vF);
+				vMaxColumn = vmax8u(vMaxColumn, vH);
+
+				/* Save vH values. */
+				vstore(pvHStore + j, vH);
+
+				/* Update vE value. */
+				vH = vsubs8u(vH, vGapO); /* saturation arithmetic, result >= 0 */
+				e = vsubs8u(e, vGapE);
+				e = vmax8u(e, vH);
+
+				/* Update vF value. */
+				vF = vsubs8u(vF, vGapE);
+				vF = vmax8u(vF, vH);
+
+	            /* Save E */
+				vstore(pvE + j, e);
+
+				/* Load the next vH. */
+				vH = vload(pvHLoad + j);
+			}
+		} else {
+			/* the same, also taking down where every score came from */
+			uint8_t* dCol = mD + (size_t)i*colD;
+			vFOpen = vset8(-1);
+			for (j = 0; LIKELY(j < segLen); ++j) {
+				gssw_v vDiag = vsubs8u(vadds8u(vH, vload(vP + j)), vBias);
+				e = vload(pvE + j);
+				vH = vmax8u(vmax8u(vDiag, e), vF);
+				vMaxColumn = vmax8u(vMaxColumn, vH);
+				vstore(pvHStore + j, vH);
+				vstore(pvF + j, vF);
+				gssw_v vNone = vcmpeq8(vH, vZero), vFromDiag = vcmpeq8(vH, vDiag);
+				gssw_v s0 = vor(vNone, vandnot(vFromDiag, vcmpeq8(vH, e)));
+				gssw_v s1 = vor(vNone, vFromDiag);
+				vH = vsubs8u(vH, vGapO);
+				e = vmax8u(vsubs8u(e, vGapE), vH);
+				vF = vmax8u(vsubs8u(vF, vGapE), vH);
+				GSSW_FN(gssw_dir_put, byte)(dCol + j*(GSSW_VSIZE/2), s0, s1, vcmpeq8(e, vH), vFOpen);
+				vFOpen = vcmpeq8(vF, vH);
+				vstore(pvE + j, e);
+				vH = vload(pvHLoad + j);
+			}
+		}
+
+
+		if (LIKELY(fscan)) {
+			/* Prefix scan: vF holds the F leaving each lane, counting only gaps opened inside it.  A lane receives
+			   the best of those of all lanes below it, less the extension across the lanes in between, computed
+			   in log2(lanes) shift-and-max steps.  One pass down the segments then applies it. */
+			vF = vshl8 (vF);
+			vOpen0 = vF; /* the F out of the lane below: it may have been opened there, anything larger extends */
+			for (k = 1, s = 0; k < GSSW_LANES8; k <<= 1, ++s, ++fsteps) {
+				vF = vmax8u (vF, vsubs8u (vshlb (vF, k), vFDecay[s]));
+			}
+			vOpen0 = vand (vshl8 (vFOpen), vcmpeq8 (vF, vOpen0));
+			for (j = 0; LIKELY(j < segLen); ++j, ++fsteps) {
+				vH = vload (pvHStore + j);
+				if (! vanygt8u (vF, vsubs8u (vH, vGapO))) break; /* gaps opened in this column dominate from here */
+				if (mD) GSSW_FN(gssw_dir_fix, byte)(mD + (size_t)i*colD + j*(GSSW_VSIZE/2), vH, vF, pvF + j,
+				                                    j ? vZero : vOpen0);
+				vH = vmax8u (vH, vF);
+				vMaxColumn = vmax8u(vMaxColumn, vH);
+				vstore (pvHStore + j, vH);
+				vF = vsubs8u (vF, vGapE);
+			}
+		} else {
+
+		/* Lazy_F loop: has been revised to disallow adjecent insertion and then deletion, so don't update E(i, j), learn from SWPS3 */
+        /* reset pointers to the start of the saved data */
+        j = 0;
+        vH = vload (pvHStore + j);
+
+        /*  the computed vF value is for the given column.  since */
+        /*  we are at the end, we need to shift the vF value over */
+        /*  to the next column. */
+        vF = vshl8 (vF);
+        vOpen0 = vshl8 (vFOpen);
+
+        /* stop where F is no more than the gap opened from the cell before it was corrected: that gap has been
+           carried down the column already, and everything below it holds */
+        vTemp = vsubs8u (vH, vGapO);
+        while (vanygt8u (vF, vTemp))
+        {
+            if (mD) GSSW_FN(gssw_dir_fix, byte)(mD + (size_t)i*colD + j*(GSSW_VSIZE/2), vH, vF, pvF + j,
+                                                j ? vZero : vOpen0);
+            vH = vmax8u (vH, vF);
+			vMaxColumn = vmax8u(vMaxColumn, vH);
+            vstore (pvHStore + j, vH);
+
+            vF = vsubs8u (vF, vGapE);
+
+            j++;
+            ++fsteps;
+            if (j >= segLen)
+            {
+                j = 0;
+                vF = vshl8 (vF);
+                vOpen0 = vZero;
+            }
+
+            vH = vload (pvHStore + j);
+            vTemp = vsubs8u (vH, vGapO);
+        }
+		}
+
+		vMaxScore = vmax8u(vMaxScore, vMaxColumn);
+		if (!vequal(vMaxMark, vMaxScore)) {
+			uint8_t temp;
+			vMaxMark = vMaxScore;
+			temp = vhmax8u(vMaxScore);
+
+			if (LIKELY(temp > max)) {
+				max = temp;
+				if (max + bias >= 255) break;	//overflow
+				end_ref = i;
+
+				/* Store the column with the highest alignment score in order to trace the alignment ending position on read. */
+				for (j = 0; LIKELY(j < segLen); ++j) pvHmax[j] = pvHStore[j];
+				if (max == terminate) break;	/* the reverse pass has found the beginning */
+			}
+		}
+
+        if (maxColumn) {
+            gssw_v vM = vZero;
+            for (j = 0; LIKELY(j < segLen); ++j) vM = vmax8u(vM, vand(vload(pvHStore + j), vload(pvValid + j)));
+            maxColumn[i] = vhmax8u(vM);
+        }
+
+        // save the current column
+        if (mH) {
+            gssw_v* vCol = (gssw_v*)mH + i*segLen;
+            for (j = 0; LIKELY(j < segLen); ++j) vstore(vCol + j, vload(pvHStore + j));
+        }
+        if (mP) vPackBad = vor(vPackBad, GSSW_FN(gssw_pack, byte)((gssw_v*)(mP + (size_t)i*colP), pvHStore, segLen));
+
+        /* X-drop: drop the rest of the node, clearing what has not been computed */
+        if (xdrop >= 0 && ref_dir == 0) {
+            int32_t t = (int32_t)(max > xbest ? max : xbest) - xdrop;
+            if (t > 0 && !vanygt8u(vMaxColumn, vset8(t > 255 ? 255 : t - 1))) {
+                if (mH) memset((gssw_v*)mH + (i + 1)*segLen, 0, (refLen - i - 1)*segLen*sizeof(gssw_v));
+                if (mP) memset(mP + (size_t)(i + 1)*colP, 0, (size_t)(refLen - i - 1)*colP);
+                if (mD) memset(mD + (size_t)(i + 1)*colD, 0xff, (size_t)(refLen - i - 1)*colD); /* H = 0 */
+                if (ckpt) ckpt->end = i + 1;
+                memset(pvHStore,      0, segLen*sizeof(gssw_v));
+                memset(pvE,           0, segLen*sizeof(gssw_v));
+                break;
+            }
+        }
+
+	}
+
+    // save the last vH
+    memcpy(alignment->seed.pvE,      pvE,      segLen*sizeof(gssw_v));
+    memcpy(alignment->seed.pvHStore, pvHStore, segLen*sizeof(gssw_v));
+
+	/* Trace the alignment ending position on read. */
+	uint8_t *t = (uint8_t*)pvHmax;
+	int32_t column_len = segLen * GSSW_LANES8;
+	for (i = 0; LIKELY(i < column_len); ++i, ++t) {
+		int32_t temp;
+		if (*t == max) {
+			temp = i / GSSW_LANES8 + i % GSSW_LANES8 * segLen;
+			if (temp < end_read) end_read = temp;
+		}
+	}
+
+	gssw_ws_free(ws, pvScratch);
+
+    alignment->f_iterations = fsteps;
+    alignment->packed.overflow = mP && !vequal(vPackBad, vzero());
+
+	gssw_alignment_end* bests = (gssw_alignment_end*)gssw_ws_alloc(ws, 2*sizeof(gssw_alignment_end));
+	if (UNLIKELY(!bests)) return NULL;
+	memset(bests, 0, 2*sizeof(gssw_alignment_end));
+	bests[0].score = max + bias >= 255 ? 255 : max;
+	bests[0].ref = end_ref;
+	bests[0].read = end_read;
+	/* Find the most possible 2nd best alignment. */
+	if (maxColumn) gssw_second_best(maxColumn, refLen, end_ref, maskLen, bests);
+
+
+	return bests;
+}
+
+GSSW_TARGET
+gssw_alignment_end* GSSW_FN(gssw_sw, word) (const int8_t* ref,
+                                            int8_t ref_dir,	// 0: forward ref; 1: reverse ref
+                                            int32_t refLen,
+                                            int32_t readLen,
+                                            const uint8_t weight_gapO, /* will be used as - */
+                                            const uint8_t weight_gapE, /* will be used as - */
+                                            const void* profile,
+                                            uint16_t terminate,
+                                            int32_t maskLen,
+                                            int32_t xdrop,
+                                            uint32_t xbest,
+                                            int8_t store_mH,
+                                            gssw_fill_settings set,
+                                            gssw_align* alignment, /* to save seed and matrix */
+                                            const gssw_seed* seed,     /* to seed the alignment */
+                                            gssw_workspace* ws) {       /* memory to reuse, or NULL */
+
+
+	uint16_t max = 0;		                     /* the max alignment score */
+	int32_t end_read = readLen - 1;
+	int32_t end_ref = 0; /* 1_based best alignment ending point; Initialized as isn't aligned - 0. */
+	int32_t segLen = (readLen + GSSW_LANES16 - 1) / GSSW_LANES16; /* number of segment */
+	const gssw_v* vProfile = (const gssw_v*)profile;
+
+    /* Initialize buffers used in alignment */
+	gssw_v* pvHStore;
+    gssw_v* pvHLoad;
+    gssw_v* pvHmax;
+    gssw_v* pvE;
+    uint16_t* mH = NULL; // used to save matrix for external traceback
+    uint8_t* mD = NULL;
+    int32_t colD = segLen*GSSW_VSIZE/4;
+    uint8_t* mP = NULL; // or H packed, see gssw_pack
+    gssw_v vPackBad = vzero(); // lanes of mP with a difference which did not fit
+    int32_t colP = GSSW_PACK_BYTES(segLen, 4);
+    gssw_v* pvF = NULL;
+
+    /* The columns come from one scratch block, the seed and mH, which outlive the fill, from the arena of the
+       workspace (all from the heap without one) */
+    gssw_v* pvScratch = (gssw_v*)gssw_ws_scratch(ws, (store_mH == 2 ? 6 : 5)*segLen*sizeof(gssw_v));
+    pvHStore = pvScratch;
+    pvHLoad = pvScratch + segLen;
+    pvHmax = pvScratch + 2*segLen;
+    pvE = pvScratch + 3*segLen;
+    alignment->seed.pvE = (gssw_v*)gssw_ws_alloc(ws, segLen*sizeof(gssw_v));
+    alignment->seed.pvHStore = (gssw_v*)gssw_ws_alloc(ws, segLen*sizeof(gssw_v));
+    if (store_mH == 1) mH = gssw_matrix_alloc(ws, (size_t)segLen*refLen*sizeof(gssw_v), alignment);
+    if (store_mH == 4) mP = (uint8_t*)gssw_matrix_alloc(ws, (size_t)colP*refLen, alignment);
+    if (store_mH == 2) {
+        mD = (uint8_t*)gssw_matrix_alloc(ws, (size_t)colD*refLen, alignment);
+        pvF = pvScratch + 5*segLen;
+    }
+    alignment->in_workspace = ws != NULL;
+    /* Set external H matrix pointer, columns are stored striped just as they are computed */
+    alignment->mH = mH;
+    alignment->mD = mD;
+    alignment->packed.m = mP;
+    if (UNLIKELY(!pvScratch || !alignment->seed.pvE || !alignment->seed.pvHStore
+                 || ((store_mH == 1 || store_mH == 2 || store_mH == 4) && !mH && !mD && !mP))) {
+        gssw_ws_free(ws, pvScratch); /* no memory for the matrix or the seed, what was had goes with the alignment */
+        return NULL;
+    }
+
+    /* Workaround because we don't have an aligned calloc */
+    memset(pvHStore,                 0, segLen*sizeof(gssw_v));
+    memset(pvHLoad,                  0, segLen*sizeof(gssw_v));
+    memset(pvHmax,                   0, segLen*sizeof(gssw_v));
+    memset(pvE,                      0, segLen*sizeof(gssw_v));
+    memset(alignment->seed.pvE,      0, segLen*sizeof(gssw_v));
+    memset(alignment->seed.pvHStore, 0, segLen*sizeof(gssw_v));
+
+    /* if we are running a seeded alignment, copy over the seeds */
+    if (seed) {
+        memcpy(pvE, seed->pvE, segLen*sizeof(gssw_v));
+        memcpy(pvHStore, seed->pvHStore, segLen*sizeof(gssw_v));
+    }
+
+    alignment->packed.stride = colP;
+    alignment->packed.unpack = GSSW_FN(gssw_unpack, word);
+    gssw_checkpoints* ckpt = NULL; // or the columns before every k-th one, see gssw_ckpt_init
+    if (store_mH == 3) {
+        ckpt = &alignment->ckpt;
+        gssw_ckpt_init(ckpt, set.ckpt, refLen, segLen*sizeof(gssw_v), ws);
+        if (UNLIKELY(!ckpt->pv)) {
+            gssw_ws_free(ws, pvScratch);
+            return NULL;
+        }
+    }
+    alignment->mH_stride = segLen * GSSW_LANES16;
+    alignment->mH_seg = segLen;
+    alignment->mH_lanes = GSSW_LANES16;
+    alignment->mH_lane = 0;
+
+    /* Record that we have done a word-order alignment */
+    alignment->is_byte = 0;
+    alignment->score_width = 2;
+
+    /* column maxima for the 2nd best search, without the padding lanes, as in the byte kernel */
+    uint32_t* maxColumn = NULL;
+    gssw_v* pvValid = NULL;
+    if (maskLen >= 15) {
+        int32_t r;
+        maxColumn = (uint32_t*)gssw_ws_alloc(ws, refLen*sizeof(uint32_t));
+        if (UNLIKELY(!maxColumn)) {
+            gssw_ws_free(ws, pvScratch);
+            return NULL;
+        }
+        memset(maxColumn, 0, refLen*sizeof(uint32_t));
+        pvValid = pvScratch + 4*segLen;
+        for (r = 0; r < segLen * GSSW_LANES16; ++r)
+            ((uint16_t*)pvValid)[r] = r / GSSW_LANES16 + r % GSSW_LANES16 * segLen < readLen ? -1 : 0;
+    }
+    alignment->max_column = maxColumn;
+
+	/* Define 0 vector. */
+	gssw_v vZero = vzero();
+
+    /* Used for iteration */
+	int32_t i, j, k, s;
+
+	/* insertion begin vector */
+	gssw_v vGapO = vset16(weight_gapO);
+
+	/* insertion extension vector */
+	gssw_v vGapE = vset16(weight_gapE);
+
+	/* gap extension over k lanes worth of segments, k = 1, 2, 4, ..., for the prefix scan of F */
+	gssw_v vFDecay[8];
+	int8_t fscan = set.fcorr == GSSW_FCORR_SCAN;
+	uint64_t fsteps = 0;
+	for (k = 1, s = 0; k < GSSW_LANES16; k <<= 1, ++s) {
+		int64_t d = (int64_t)k * segLen * weight_gapE;
+		vFDecay[s] = vset16(d > 65535 ? 65535 : d);
+	}
+
+	gssw_v vMaxScore = vZero; /* Trace the highest score of the whole SW matrix. */
+	gssw_v vMaxMark = vZero; /* Trace the highest score till the previous column. */
+	int32_t begin = 0, end = refLen, step = 1;
+
+	/* outer loop to process the reference sequence */
+	if (ref_dir == 1) {
+		begin = refLen - 1;
+		end = -1;
+		step = -1;
+	}
+	for (i = begin; LIKELY(i != end); i += step) {
+		if (ckpt && i % ckpt->k == 0) gssw_ckpt_put(ckpt, i / ckpt->k, pvHStore, pvE, segLen*sizeof(gssw_v));
+		gssw_v vFOpen = vZero, vOpen0; /* F opened rather than extended, for the direction bits */
+		gssw_v e = vZero, vF = vZero; /* Initialize F value to 0.
+							   Any errors to vH values will be corrected in the Lazy_F loop.
+							 */
+		gssw_v vH = pvHStore[segLen - 1];
+		vH = vshl16 (vH); /* Shift the value in vH left by 2 byte. */
+
+		/* Swap the 2 H buffers. */
+		gssw_v* pv = pvHLoad;
+
+		gssw_v vMaxColumn = vZero; /* vMaxColumn is used to record the max values of column i. */
+
+		const gssw_v* vP = vProfile + ref[i] * segLen; /* Right part of the vProfile */
+		pvHLoad = pvHStore;
+		pvHStore = pv;
+
+		/* inner loop to process the query sequence */
+		if (LIKELY(!mD)) {
+			for (j = 0; LIKELY(j < segLen); j ++) {
+				vH = vadds16(vH, vload(vP + j));
+
+				/* Get max from vH, vE and vF. */
+				e = vload(pvE + j);
+				vH = vmax16(vH, e);
+				vH = vmax16(vH, vF);
+				vMaxColumn = vmax16(vMaxColumn, vH);
+
+				/* Save vH values. */
+				vstore(pvHStore + j, vH);
+
+				/* Update vE value. */
+				vH = vsubs16u(vH, vGapO); /* saturation arithmetic, result >= 0 */
+				e = vsubs16u(e, vGapE);
+				e = vmax16(e, vH);
+				vstore(pvE + j, e);
+
+				/* Update vF value. */
+				vF = vsubs16u(vF, vGapE);
+				vF = vmax16(vF, vH);
+
+				/* Load the next vH. */
+				vH = vload(pvHLoad + j);
+			}
+		} else {
+			/* the same, also taking down where every score came from, as in the byte kernel */
+			uint8_t* dCol = mD + (size_t)i*colD;
+			vFOpen = vset16(-1);
+			for (j = 0; LIKELY(j < segLen); ++j) {
+				gssw_v vDiag = vadds16(vH, vload(vP + j));
+				e = vload(pvE + j);
+				vH = vmax16(vmax16(vDiag, e), vF);
+				vMaxColumn = vmax16(vMaxColumn, vH);
+				vstore(pvHStore + j, vH);
+				vstore(pvF + j, vF);
+				gssw_v vNone = vcmpeq16(vH, vZero), vFromDiag = vcmpeq16(vH, vDiag);
+				gssw_v s0 = vor(vNone, vandnot(vFromDiag, vcmpeq16(vH, e)));
+				gssw_v s1 = vor(vNone, vFromDiag);
+				vH = vsubs16u(vH, vGapO);
+				e = vmax16(vsubs16u(e, vGapE), vH);
+				vF = vmax16(vsubs16u(vF, vGapE), vH);
+				GSSW_FN(gssw_dir_put, word)(dCol + j*(GSSW_VSIZE/4), s0, s1, vcmpeq16(e, vH), vFOpen);
+				vFOpen = vcmpeq16(vF, vH);
+				vstore(pvE + j, e);
+				vH = vload(pvHLoad + j);
+			}
+		}
+
+		if (LIKELY(fscan)) {
+			/* Prefix scan of the F leaving each lane, as in the byte kernel */
+			vF = vshl16 (vF);
+			vOpen0 = vF;
+			for (k = 1, s = 0; k < GSSW_LANES16; k <<= 1, ++s, ++fsteps) {
+				vF = vmax16 (vF, vsubs16u (vshlb (vF, k * 2), vFDecay[s]));
+			}
+			vOpen0 = vand (vshl16 (vFOpen), vcmpeq16 (vF, vOpen0));
+			for (j = 0; LIKELY(j < segLen); ++j, ++fsteps) {
+				vH = vload(pvHStore + j);
+				if (UNLIKELY(! vanygt16(vF, vsubs16u(vH, vGapO)))) break;
+				if (mD) GSSW_FN(gssw_dir_fix, word)(mD + (size_t)i*colD + j*(GSSW_VSIZE/4), vH, vF, pvF + j,
+				                                    j ? vZero : vOpen0);
+				vH = vmax16(vH, vF);
+				vMaxColumn = vmax16(vMaxColumn, vH);
+				vstore(pvHStore + j, vH);
+				vF = vsubs16u(vF, vGapE);
+			}
+		} else {
+		/* Lazy_F loop: has been revised to disallow adjecent insertion and then deletion, so don't update E(i, j), learn from SWPS3 */
+		vOpen0 = vshl16 (vFOpen);
+		for (k = 0; LIKELY(k < GSSW_LANES16); ++k) {
+			vF = vshl16 (vF);
+			for (j = 0; LIKELY(j < segLen); ++j) {
+				++fsteps;
+				vH = vload(pvHStore + j);
+				if (UNLIKELY(! vanygt16(vF, vsubs16u(vH, vGapO)))) goto end; /* as in the byte kernel */
+				if (mD) GSSW_FN(gssw_dir_fix, word)(mD + (size_t)i*colD + j*(GSSW_VSIZE/4), vH, vF, pvF + j,
+				                                    k || j ? vZero : vOpen0);
+				vH = vmax16(vH, vF);
+				vMaxColumn = vmax16(vMaxColumn, vH);
+				vstore(pvHStore + j, vH);
+				vF = vsubs16u(vF, vGapE);
+			}
+		}
+		}
+
+end:
+		vMaxScore = vmax16(vMaxScore, vMaxColumn);
+		if (!vequal(vMaxMark, vMaxScore)) {
+			uint16_t temp;
+			vMaxMark = vMaxScore;
+			temp = vhmax16(vMaxScore);
+
+			if (LIKELY(temp > max)) {
+				max = temp;
+				if (max == INT16_MAX) break;	//overflow, saturated
+				end_ref = i;
+				for (j = 0; LIKELY(j < segLen); ++j) pvHmax[j] = pvHStore[j];
+				if (max == terminate) break;
+			}
+		}
+
+        if (maxColumn) {
+            gssw_v vM = vZero;
+            for (j = 0; LIKELY(j < segLen); ++j) vM = vmax16(vM, vand(vload(pvHStore + j), vload(pvValid + j)));
+            maxColumn[i] = vhmax16(vM);
+        }
+
+        /* save current column */
+        if (mH) {
+            gssw_v* vCol = (gssw_v*)mH + i*segLen;
+            for (j = 0; LIKELY(j < segLen); ++j) vstore(vCol + j, vload(pvHStore + j));
+        }
+        if (mP) vPackBad = vor(vPackBad, GSSW_FN(gssw_pack, word)((gssw_v*)(mP + (size_t)i*colP), pvHStore, segLen));
+
+        /* X-drop */
+        if (xdrop >= 0 && ref_dir == 0) {
+            int32_t t = (int32_t)(max > xbest ? max : xbest) - xdrop;
+            if (t > 0 && !vanygt16(vMaxColumn, vset16(t > INT16_MAX ? INT16_MAX : t - 1))) {
+                if (mH) memset((gssw_v*)mH + (i + 1)*segLen, 0, (refLen - i - 1)*segLen*sizeof(gssw_v));
+                if (mP) memset(mP + (size_t)(i + 1)*colP, 0, (size_t)(refLen - i - 1)*colP);
+                if (mD) memset(mD + (size_t)(i + 1)*colD, 0xff, (size_t)(refLen - i - 1)*colD); /* H = 0 */
+                if (ckpt) ckpt->end = i + 1;
+                memset(pvHStore,      0, segLen*sizeof(gssw_v));
+                memset(pvE,           0, segLen*sizeof(gssw_v));
+                break;
+            }
+        }
+
+	}
+
+    memcpy(alignment->seed.pvE,      pvE,      segLen*sizeof(gssw_v));
+    memcpy(alignment->seed.pvHStore, pvHStore, segLen*sizeof(gssw_v));
+
+
+	/* Trace the alignment ending position on read. */
+	uint16_t *t = (uint16_t*)pvHmax;
+	int32_t column_len = segLen * GSSW_LANES16;
+	for (i = 0; LIKELY(i < column_len); ++i, ++t) {
+		int32_t temp;
+		if (*t == max) {
+			temp = i / GSSW_LANES16 + i % GSSW_LANES16 * segLen;
+			if (temp < end_read) end_read = temp;
+		}
+	}
+
+	gssw_ws_free(ws, pvScratch);
+
+    alignment->f_iterations = fsteps;
+    alignment->packed.overflow = mP && !vequal(vPackBad, vzero());
+
+	gssw_alignment_end* bests = (gssw_alignment_end*)gssw_ws_alloc(ws, 2*sizeof(gssw_alignment_end));
+	if (UNLIKELY(!bests)) return NULL;
+	memset(bests, 0, 2*sizeof(gssw_alignment_end));
+	bests[0].score = max;
+	bests[0].ref = end_ref;
+	bests[0].read = end_read;
+	/* Find the most possible 2nd best alignment. */
+	if (maxColumn) gssw_second_best(maxColumn, refLen, end_ref, maskLen, bests);
+
+	return bests;
+}
+
+/* 32-bit scores, for alignments whose score does not fit in 16 bits (long reads, large match bonuses).  Nothing
+   saturates at this width, so there is no overflow to report. */
+GSSW_TARGET
+gssw_alignment_end* GSSW_FN(gssw_sw, dword) (const int8_t* ref,
+                                             int8_t ref_dir,	// 0: forward ref; 1: reverse ref
+                                             int32_t refLen,
+                                             int32_t readLen,
+                                             const uint8_t weight_gapO, /* will be used as - */
+                                             const uint8_t weight_gapE, /* will be used as - */
+                                             const void* profile,
+                                             uint32_t terminate,
+                                             int32_t maskLen,
+                                             int32_t xdrop,
+                                             uint32_t xbest,
+                                             int8_t store_mH,
+                                             gssw_fill_settings set,
+                                             gssw_align* alignment, /* to save seed and matrix */
+                                             const gssw_seed* seed,     /* to seed the alignment */
+                                             gssw_workspace* ws) {       /* memory to reuse, or NULL */
+
+	int32_t max = 0;		                     /* the max alignment score */
+	int32_t end_read = readLen - 1;
+	int32_t end_ref = 0;
+	int32_t segLen = (readLen + GSSW_LANES32 - 1) / GSSW_LANES32; /* number of segment */
+	const gssw_v* vProfile = (const gssw_v*)profile;
+
+    /* Initialize buffers used in alignment */
+	gssw_v* pvHStore;
+    gssw_v* pvHLoad;
+    gssw_v* pvHmax;
+    gssw_v* pvE;
+    uint32_t* mH = NULL; // used to save matrix for external traceback
+    uint8_t* mD = NULL;
+    int32_t colD = segLen*GSSW_VSIZE/8;
+    uint8_t* mP = NULL; // or H packed, see gssw_pack
+    gssw_v vPackBad = vzero(); // lanes of mP with a difference which did not fit
+    int32_t colP = GSSW_PACK_BYTES(segLen, 8);
+    gssw_v* pvF = NULL;
+
+    /* The columns come from one scratch block, the seed and mH, which outlive the fill, from the arena of the
+       workspace (all from the heap without one) */
+    gssw_v* pvScratch = (gssw_v*)gssw_ws_scratch(ws, (store_mH == 2 ? 6 : 5)*segLen*sizeof(gssw_v));
+    pvHStore = pvScratch;
+    pvHLoad = pvScratch + segLen;
+    pvHmax = pvScratch + 2*segLen;
+    pvE = pvScratch + 3*segLen;
+    alignment->seed.pvE = (gssw_v*)gssw_ws_alloc(ws, segLen*sizeof(gssw_v));
+    alignment->seed.pvHStore = (gssw_v*)gssw_ws_alloc(ws, segLen*sizeof(gssw_v));
+    if (store_mH == 1) mH = gssw_matrix_alloc(ws, (size_t)segLen*refLen*sizeof(gssw_v), alignment);
+    if (store_mH == 4) mP = (uint8_t*)gssw_matrix_alloc(ws, (size_t)colP*refLen, alignment);
+    if (store_mH == 2) {
+        mD = (uint8_t*)gssw_matrix_alloc(ws, (size_t)colD*refLen, alignment);
+        pvF = pvScratch + 5*segLen;
+    }
+    alignment->in_workspace = ws != NULL;
+    /* Set external H matrix pointer, columns are stored striped just as they are computed */
+    alignment->mH = mH;
+    alignment->mD = mD;
+    alignment->packed.m = mP;
+    if (UNLIKELY(!pvScratch || !alignment->seed.pvE || !alignment->seed.pvHStore
+                 || ((store_mH == 1 || store_mH == 2 || store_mH == 4) && !mH && !mD && !mP))) {
+        gssw_ws_free(ws, pvScratch); /* no memory for the matrix or the seed, what was had goes with the alignment */
+        return NULL;
+    }
+
+    /* Workaround because we don't have an aligned calloc */
+    memset(pvHStore,                 0, segLen*sizeof(gssw_v));
+    memset(pvHLoad,                  0, segLen*sizeof(gssw_v));
+    memset(pvHmax,                   0, segLen*sizeof(gssw_v));
+    memset(pvE,                      0, segLen*sizeof(gssw_v));
+    memset(alignment->seed.pvE,      0, segLen*sizeof(gssw_v));
+    memset(alignment->seed.pvHStore, 0, segLen*sizeof(gssw_v));
+
+    /* if we are running a seeded alignment, copy over the seeds */
+    if (seed) {
+        memcpy(pvE, seed->pvE, segLen*sizeof(gssw_v));
+        memcpy(pvHStore, seed->pvHStore, segLen*sizeof(gssw_v));
+    }
+
+    alignment->packed.stride = colP;
+    alignment->packed.unpack = GSSW_FN(gssw_unpack, dword);
+    gssw_checkpoints* ckpt = NULL; // or the columns before every k-th one, see gssw_ckpt_init
+    if (store_mH == 3) {
+        ckpt = &alignment->ckpt;
+        gssw_ckpt_init(ckpt, set.ckpt, refLen, segLen*sizeof(gssw_v), ws);
+        if (UNLIKELY(!ckpt->pv)) {
+            gssw_ws_free(ws, pvScratch);
+            return NULL;
+        }
+    }
+    alignment->mH_stride = segLen * GSSW_LANES32;
+    alignment->mH_seg = segLen;
+    alignment->mH_lanes = GSSW_LANES32;
+    alignment->mH_lane = 0;
+
+    /* Record that we have done a dword-order alignment */
+    alignment->is_byte = 0;
+    alignment->score_width = 4;
+
+    /* column maxima for the 2nd best search, without the padding lanes, as in the byte kernel */
+    uint32_t* maxColumn = NULL;
+    gssw_v* pvValid = NULL;
+    if (maskLen >= 15) {
+        int32_t r;
+        maxColumn = (uint32_t*)gssw_ws_alloc(ws, refLen*sizeof(uint32_t));
+        if (UNLIKELY(!maxColumn)) {
+            gssw_ws_free(ws, pvScratch);
+            return NULL;
+        }
+        memset(maxColumn, 0, refLen*sizeof(uint32_t));
+        pvValid = pvScratch + 4*segLen;
+        for (r = 0; r < segLen * GSSW_LANES32; ++r)
+            ((uint32_t*)pvValid)[r] = r / GSSW_LANES32 + r % GSSW_LANES32 * segLen < readLen ? -1 : 0;
+    }
+    alignment->max_column = maxColumn;
+
+	/* Define 0 vector. */
+	gssw_v vZero = vzero();
+
+    /* Used for iteration */
+	int32_t i, j, k, s;
+
+	/* insertion begin vector */
+	gssw_v vGapO = vset32(weight_gapO);
+
+	/* insertion extension vector */
+	gssw_v vGapE = vset32(weight_gapE);
+
+	/* gap extension over k lanes worth of segments, k = 1, 2, 4, ..., for the prefix scan of F */
+	gssw_v vFDecay[8];
+	int8_t fscan = set.fcorr == GSSW_FCORR_SCAN;
+	uint64_t fsteps = 0;
+	for (k = 1, s = 0; k < GSSW_LANES32; k <<= 1, ++s) {
+		int64_t d = (int64_t)k * segLen * weight_gapE;
+		vFDecay[s] = vset32(d > INT32_MAX ? INT32_MAX : d);
+	}
+
+	gssw_v vMaxScore = vZero; /* Trace the highest score of the whole SW matrix. */
+	gssw_v vMaxMark = vZero; /* Trace the highest score till the previous column. */
+	int32_t begin = 0, end = refLen, step = 1;
+
+	/* outer loop to process the reference sequence */
+	if (ref_dir == 1) {
+		begin = refLen - 1;
+		end = -1;
+		step = -1;
+	}
+	for (i = begin; LIKELY(i != end); i += step) {
+		if (ckpt && i % ckpt->k == 0) gssw_ckpt_put(ckpt, i / ckpt->k, pvHStore, pvE, segLen*sizeof(gssw_v));
+		gssw_v vFOpen = vZero, vOpen0; /* F opened rather than extended, for the direction bits */
+		gssw_v e = vZero, vF = vZero; /* Initialize F value to 0.
+							   Any errors to vH values will be corrected in the Lazy_F loop.
+							 */
+		gssw_v vH = pvHStore[segLen - 1];
+		vH = vshl32 (vH); /* Shift the value in vH left by 4 byte. */
+
+		/* Swap the 2 H buffers. */
+		gssw_v* pv = pvHLoad;
+
+		gssw_v vMaxColumn = vZero; /* vMaxColumn is used to record the max values of column i. */
+
+		const gssw_v* vP = vProfile + ref[i] * segLen; /* Right part of the vProfile */
+		pvHLoad = pvHStore;
+		pvHStore = pv;
+
+		/* inner loop to process the query sequence */
+		if (LIKELY(!mD)) {
+			for (j = 0; LIKELY(j < segLen); j ++) {
+				vH = vadd32(vH, vload(vP + j));
+
+				/* Get max from vH, vE and vF. */
+				e = vload(pvE + j);
+				vH = vmax32(vH, e);
+				vH = vmax32(vH, vF);
+				vMaxColumn = vmax32(vMaxColumn, vH);
+
+				/* Save vH values. */
+				vstore(pvHStore + j, vH);
+
+				/* Update vE value. */
+				vH = vsubs32u(vH, vGapO); /* clamped, result >= 0 */
+				e = vsubs32u(e, vGapE);
+				e = vmax32(e, vH);
+				vstore(pvE + j, e);
+
+				/* Update vF value. */
+				vF = vsubs32u(vF, vGapE);
+				vF = vmax32(vF, vH);
+
+				/* Load the next vH. */
+				vH = vload(pvHLoad + j);
+			}
+		} else {
+			/* the same, also taking down where every score came from, as in the byte kernel */
+			uint8_t* dCol = mD + (size_t)i*colD;
+			vFOpen = vset32(-1);
+			for (j = 0; LIKELY(j < segLen); ++j) {
+				gssw_v vDiag = vadd32(vH, vload(vP + j));
+				e = vload(pvE + j);
+				vH = vmax32(vmax32(vDiag, e), vF);
+				vMaxColumn = vmax32(vMaxColumn, vH);
+				vstore(pvHStore + j, vH);
+				vstore(pvF + j, vF);
+				gssw_v vNone = vcmpeq32(vH, vZero), vFromDiag = vcmpeq32(vH, vDiag);
+				gssw_v s0 = vor(vNone, vandnot(vFromDiag, vcmpeq32(vH, e)));
+				gssw_v s1 = vor(vNone, vFromDiag);
+				vH = vsubs32u(vH, vGapO);
+				e = vmax32(vsubs32u(e, vGapE), vH);
+				vF = vmax32(vsubs32u(vF, vGapE), vH);
+				GSSW_FN(gssw_dir_put, dword)(dCol + j*(GSSW_VSIZE/8), s0, s1, vcmpeq32(e, vH), vFOpen);
+				vFOpen = vcmpeq32(vF, vH);
+				vstore(pvE + j, e);
+				vH = vload(pvHLoad + j);
+			}
+		}
+
+		if (LIKELY(fscan)) {
+			/* Prefix scan of the F leaving each lane, as in the byte kernel */
+			vF = vshl32 (vF);
+			vOpen0 = vF;
+			for (k = 1, s = 0; k < GSSW_LANES32; k <<= 1, ++s, ++fsteps) {
+				vF = vmax32 (vF, vsubs32u (vshlb (vF, k * 4), vFDecay[s]));
+			}
+			vOpen0 = vand (vshl32 (vFOpen), vcmpeq32 (vF, vOpen0));
+			for (j = 0; LIKELY(j < segLen); ++j, ++fsteps) {
+				vH = vload(pvHStore + j);
+				if (UNLIKELY(! vanygt32(vF, vsubs32u(vH, vGapO)))) break;
+				if (mD) GSSW_FN(gssw_dir_fix, dword)(mD + (size_t)i*colD + j*(GSSW_VSIZE/8), vH, vF, pvF + j,
+				                                     j ? vZero : vOpen0);
+				vH = vmax32(vH, vF);
+				vMaxColumn = vmax32(vMaxColumn, vH);
+				vstore(pvHStore + j, vH);
+				vF = vsubs32u(vF, vGapE);
+			}
+		} else {
+		/* Lazy_F loop: has been revised to disallow adjecent insertion and then deletion, so don't update E(i, j), learn from SWPS3 */
+		vOpen0 = vshl32 (vFOpen);
+		for (k = 0; LIKELY(k < GSSW_LANES32); ++k) {
+			vF = vshl32 (vF);
+			for (j = 0; LIKELY(j < segLen); ++j) {
+				++fsteps;
+				vH = vload(pvHStore + j);
+				if (UNLIKELY(! vanygt32(vF, vsubs32u(vH, vGapO)))) goto end; /* as in the byte kernel */
+				if (mD) GSSW_FN(gssw_dir_fix, dword)(mD + (size_t)i*colD + j*(GSSW_VSIZE/8), vH, vF, pvF + j,
+				                                     k || j ? vZero : vOpen0);
+				vH = vmax32(vH, vF);
+				vMaxColumn = vmax32(vMaxColumn, vH);
+				vstore(pvHStore + j, vH);
+				vF = vsubs32u(vF, vGapE);
+			}
+		}
+		}
+
+end:
+		vMaxScore = vmax32(vMaxScore, vMaxColumn);
+		if (!vequal(vMaxMark, vMaxScore)) {
+			int32_t temp;
+			vMaxMark = vMaxScore;
+			temp = vhmax32(vMaxScore);
+
+			if (LIKELY(temp > max)) {
+				max = temp;
+				end_ref = i;
+				for (j = 0; LIKELY(j < segLen); ++j) pvHmax[j] = pvHStore[j];
+				if (max == terminate) break;
+			}
+		}
+
+        if (maxColumn) {
+            gssw_v vM = vZero;
+            for (j = 0; LIKELY(j < segLen); ++j) vM = vmax32(vM, vand(vload(pvHStore + j), vload(pvValid + j)));
+            maxColumn[i] = vhmax32(vM);
+        }
+
+        /* save current column */
+        if (mH) {
+            gssw_v* vCol = (gssw_v*)mH + i*segLen;
+            for (j = 0; LIKELY(j < segLen); ++j) vstore(vCol + j, vload(pvHStore + j));
+        }
+        if (mP) vPackBad = vor(vPackBad, GSSW_FN(gssw_pack, dword)((gssw_v*)(mP + (size_t)i*colP), pvHStore, segLen));
+
+        /* X-drop */
+        if (xdrop >= 0 && ref_dir == 0) {
+            int32_t t = (int32_t)(max > xbest ? max : xbest) - xdrop;
+            if (t > 0 && !vanygt32(vMaxColumn, vset32(t > INT32_MAX ? INT32_MAX : t - 1))) {
+                if (mH) memset((gssw_v*)mH + (i + 1)*segLen, 0, (refLen - i - 1)*segLen*sizeof(gssw_v));
+                if (mP) memset(mP + (size_t)(i + 1)*colP, 0, (size_t)(refLen - i - 1)*colP);
+                if (mD) memset(mD + (size_t)(i + 1)*colD, 0xff, (size_t)(refLen - i - 1)*colD); /* H = 0 */
+                if (ckpt) ckpt->end = i + 1;
+                memset(pvHStore,      0, segLen*sizeof(gssw_v));
+                memset(pvE,           0, segLen*sizeof(gssw_v));
+                break;
+            }
+        }
+
+	}
+
+    memcpy(alignment->seed.pvE,      pvE,      segLen*sizeof(gssw_v));
+    memcpy(alignment->seed.pvHStore, pvHStore, segLen*sizeof(gssw_v));
+
+	/* Trace the alignment ending position on read. */
+	int32_t *t = (int32_t*)pvHmax;
+	int32_t column_len = segLen * GSSW_LANES32;
+	for (i = 0; LIKELY(i < column_len); ++i, ++t) {
+		int32_t temp;
+		if (*t == max) {
+			temp = i / GSSW_LANES32 + i % GSSW_LANES32 * segLen;
+			if (temp < end_read) end_read = temp;
+		}
+	}
+
+	gssw_ws_free(ws, pvScratch);
+
+    alignment->f_iterations = fsteps;
+    alignment->packed.overflow = mP && !vequal(vPackBad, vzero());
+
+	gssw_alignment_end* bests = (gssw_alignment_end*)gssw_ws_alloc(ws, 2*sizeof(gssw_alignment_end));
+	if (UNLIKELY(!bests)) return NULL;
+	memset(bests, 0, 2*sizeof(gssw_alignment_end));
+	bests[0].score = max;
+	bests[0].ref = end_ref;
+	bests[0].read = end_read;
+	/* Find the most possible 2nd best alignment. */
+	if (maxColumn) gssw_second_best(maxColumn, refLen, end_ref, maskLen, bests);
+
+	return bests;
+}
+
+/* Merge the seeds of the predecessors, given by their alignments: the max of all the inbound H and E vectors. */
+GSSW_TARGET
+gssw_seed* GSSW_FN(gssw_create_seed, byte) (int32_t readLen, gssw_align** prev, int32_t count, gssw_workspace* ws) {
+    int32_t j = 0, k = 0;
+    gssw_v vZero = vzero();
+	int32_t segLen = (readLen + GSSW_LANES8 - 1) / GSSW_LANES8;
+    gssw_seed* seed = gssw_seed_alloc(segLen*sizeof(gssw_v), ws);
+    if (UNLIKELY(!seed)) return NULL;
+    gssw_v* sE = (gssw_v*)seed->pvE;
+    gssw_v* sH = (gssw_v*)seed->pvHStore;
+    // take the max of all inputs
+    gssw_v pvE = vZero, pvH = vZero, ovE = vZero, ovH = vZero;
+    for (j = 0; j < segLen; ++j) {
+        pvE = vZero; pvH = vZero;
+        for (k = 0; k < count; ++k) {
+            if (!prev[k]->seed.pvE) continue; // skipped by X-drop
+            ovE = vload((gssw_v*)prev[k]->seed.pvE + j);
+            ovH = vload((gssw_v*)prev[k]->seed.pvHStore + j);
+            pvE = vmax8u(pvE, ovE);
+            pvH = vmax8u(pvH, ovH);
+        }
+        vstore(sH + j, pvH);
+        vstore(sE + j, pvE);
+    }
+    return seed;
+}
+
+GSSW_TARGET
+gssw_seed* GSSW_FN(gssw_create_seed, word) (int32_t readLen, gssw_align** prev, int32_t count, gssw_workspace* ws) {
+    int32_t j = 0, k = 0;
+    gssw_v vZero = vzero();
+	int32_t segLen = (readLen + GSSW_LANES16 - 1) / GSSW_LANES16;
+    gssw_seed* seed = gssw_seed_alloc(segLen*sizeof(gssw_v), ws);
+    if (UNLIKELY(!seed)) return NULL;
+    gssw_v* sE = (gssw_v*)seed->pvE;
+    gssw_v* sH = (gssw_v*)seed->pvHStore;
+    // take the max of all inputs
+    gssw_v pvE = vZero, pvH = vZero, ovE = vZero, ovH = vZero;
+    for (j = 0; j < segLen; ++j) {
+        pvE = vZero; pvH = vZero;
+        for (k = 0; k < count; ++k) {
+            if (prev[k]->score_width != 2 || !prev[k]->seed.pvE) continue;
+            ovE = vload((gssw_v*)prev[k]->seed.pvE + j);
+            ovH = vload((gssw_v*)prev[k]->seed.pvHStore + j);
+            pvE = vmax16u(pvE, ovE);
+            pvH = vmax16u(pvH, ovH);
+        }
+        vstore(sH + j, pvH);
+        vstore(sE + j, pvE);
+    }
+    // predecessors which did not overflow were filled in byte mode, where a stripe spans twice the lanes:
+    // widen their seeds one read position at a time
+    int32_t segLen8 = (readLen + GSSW_LANES8 - 1) / GSSW_LANES8, r;
+    uint16_t* wE = (uint16_t*)seed->pvE;
+    uint16_t* wH = (uint16_t*)seed->pvHStore;
+    for (k = 0; k < count; ++k) {
+        if (prev[k]->score_width != 1 || !prev[k]->seed.pvE) continue;
+        const uint8_t* bE = (const uint8_t*)prev[k]->seed.pvE;
+        const uint8_t* bH = (const uint8_t*)prev[k]->seed.pvHStore;
+        for (r = 0; r < readLen; ++r) {
+            int32_t b = (r % segLen8) * GSSW_LANES8 + r / segLen8;
+            int32_t w = (r % segLen) * GSSW_LANES16 + r / segLen;
+            if (bE[b] > wE[w]) wE[w] = bE[b];
+            if (bH[b] > wH[w]) wH[w] = bH[b];
+        }
+    }
+    return seed;
+}
+
+GSSW_TARGET
+gssw_seed* GSSW_FN(gssw_create_seed, dword) (int32_t readLen, gssw_align** prev, int32_t count, gssw_workspace* ws) {
+    int32_t j = 0, k = 0;
+    gssw_v vZero = vzero();
+	int32_t segLen = (readLen + GSSW_LANES32 - 1) / GSSW_LANES32;
+    gssw_seed* seed = gssw_seed_alloc(segLen*sizeof(gssw_v), ws);
+    if (UNLIKELY(!seed)) return NULL;
+    gssw_v* sE = (gssw_v*)seed->pvE;
+    gssw_v* sH = (gssw_v*)seed->pvHStore;
+    // take the max of all inputs
+    gssw_v pvE = vZero, pvH = vZero, ovE = vZero, ovH = vZero;
+    for (j = 0; j < segLen; ++j) {
+        pvE = vZero; pvH = vZero;
+        for (k = 0; k < count; ++k) {
+            if (prev[k]->score_width != 4 || !prev[k]->seed.pvE) continue;
+            ovE = vload((gssw_v*)prev[k]->seed.pvE + j);
+            ovH = vload((gssw_v*)prev[k]->seed.pvHStore + j);
+            pvE = vmax32(pvE, ovE);
+            pvH = vmax32(pvH, ovH);
+        }
+        vstore(sH + j, pvH);
+        vstore(sE + j, pvE);
+    }
+    // widen the byte and word seeds of predecessors which did not need 32 bits, as in the word seed above
+    int32_t r;
+    uint32_t* dE = (uint32_t*)seed->pvE;
+    uint32_t* dH = (uint32_t*)seed->pvHStore;
+    for (k = 0; k < count; ++k) {
+        const gssw_align* a = prev[k];
+        if (a->score_width == 4 || !a->seed.pvE) continue;
+        int32_t lanes = GSSW_VSIZE / a->score_width;
+        int32_t seg = (readLen + lanes - 1) / lanes;
+        for (r = 0; r < readLen; ++r) {
+            int32_t s = (r % seg) * lanes + r / seg;
+            int32_t d = (r % segLen) * GSSW_LANES32 + r / segLen;
+            uint32_t e = a->score_width == 1 ? ((const uint8_t*)a->seed.pvE)[s] : ((const uint16_t*)a->seed.pvE)[s];
+            uint32_t h = a->score_width == 1 ? ((const uint8_t*)a->seed.pvHStore)[s]
+                                             : ((const uint16_t*)a->seed.pvHStore)[s];
+            if (e > dE[d]) dE[d] = e;
+            if (h > dH[d]) dH[d] = h;
+        }
+    }
+    return seed;
+}
+
+/* Banded fill with 16-bit scores.  Column i only holds the bandW read positions from bandLo + i on, stored by their
+   distance k from the start of the band: the diagonal predecessor of a cell is then in the same lane of the previous
+   column and the horizontal one a lane further, while the vertical gap runs down the lanes of the column and is
+   resolved exactly with a prefix scan, carried from one vector to the next.  The profile is the linear one of
+   gssw_qP_band, the seed and the matrix left in alignment use the band layout (bandW cells per column, one spare
+   zero vector after the seed).  Returns a score of INT16_MAX on overflow, NULL if the matrix or the seed cannot be had. */
+GSSW_TARGET
+gssw_alignment_end* GSSW_FN(gssw_sw_band, word) (const int8_t* ref,
+                                                 int32_t refLen,
+                                                 int32_t readLen,
+                                                 const uint8_t weight_gapO, /* will be used as - */
+                                                 const uint8_t weight_gapE, /* will be used as - */
+                                                 const int16_t* profile,
+                                                 int32_t bandLo,
+                                                 int32_t bandW,	/* a multiple of the 16-bit lanes */
+                                                 gssw_align* alignment, /* to save seed and matrix */
+                                                 const gssw_seed* seed) {     /* to seed the alignment */
+
+	int32_t max = 0;		                     /* the max alignment score */
+	int32_t end_read = readLen - 1;
+	int32_t end_ref = 0;
+	int32_t segLen = bandW / GSSW_LANES16; /* vectors per column */
+	int32_t rowLen = readLen + 2 * GSSW_BAND_PAD;
+
+    /* Initialize buffers used in alignment, with a zero vector past the band for the shifted E loads */
+	gssw_v* pvHStore;
+    gssw_v* pvHLoad;
+    gssw_v* pvEStore;
+    gssw_v* pvELoad;
+    int16_t* pTemp;
+    uint16_t* mH; // used to save matrix for external traceback
+    size_t bytes = (segLen + 1) * sizeof(gssw_v);
+
+    /* the columns from one block, the seed and mH, which outlive the fill, with the alignment (mH as the matrices
+       of the other kernels, see gssw_matrix_alloc) */
+    gssw_v* pvScratch = (gssw_v*)gssw_aligned_malloc(5 * bytes, sizeof(gssw_v));
+    pvHStore = pvScratch;
+    pvHLoad = (gssw_v*)((char*)pvScratch + bytes);
+    pvEStore = (gssw_v*)((char*)pvScratch + 2 * bytes);
+    pvELoad = (gssw_v*)((char*)pvScratch + 3 * bytes);
+    pTemp = (int16_t*)((char*)pvScratch + 4 * bytes);
+    alignment->seed.pvE = (gssw_v*)gssw_aligned_malloc(bytes, sizeof(gssw_v));
+    alignment->seed.pvHStore = (gssw_v*)gssw_aligned_malloc(bytes, sizeof(gssw_v));
+    mH = (uint16_t*)gssw_matrix_alloc(NULL, (size_t)segLen*refLen*sizeof(gssw_v), alignment);
+    alignment->mH = mH;
+    if (UNLIKELY(!pvScratch || !alignment->seed.pvE || !alignment->seed.pvHStore || !mH)) {
+        free(pvScratch); /* no memory for the matrix or the seed, what was had goes with the alignment */
+        return NULL;
+    }
+
+    memset(pvHStore, 0, bytes);
+    memset(pvHLoad,  0, bytes);
+    memset(pvEStore, 0, bytes);
+    memset(pvELoad,  0, bytes);
+
+    /* if we are running a seeded alignment, copy over the seeds */
+    if (seed) {
+        memcpy(pvEStore, seed->pvE, segLen*sizeof(gssw_v));
+        memcpy(pvHStore, seed->pvHStore, segLen*sizeof(gssw_v));
+    }
+
+    /* External H matrix, see gssw_mH_cell for the band layout */
+    alignment->mH_stride = bandW;
+    alignment->mH_seg = 1;
+    alignment->mH_lanes = 1;
+    alignment->mH_lane = 0;
+    alignment->band_lo = bandLo;
+    alignment->band_w = bandW;
+
+    alignment->is_byte = 0;
+    alignment->score_width = 2;
+
+	/* Define 0 vector. */
+	gssw_v vZero = vzero();
+
+    /* Used for iteration */
+	int32_t i, j, k, s;
+
+	gssw_v vGapO = vset16(weight_gapO);
+	gssw_v vGapE = vset16(weight_gapE);
+
+	/* gap extension over k lanes, k = 1, 2, 4, ..., for the prefix scan of F */
+	gssw_v vFDecay[8];
+	for (k = 1, s = 0; k < GSSW_LANES16; k <<= 1, ++s) vFDecay[s] = vset16(k * weight_gapE);
+
+	for (i = 0; LIKELY(i < refLen); ++i) {
+		int32_t lo = bandLo + i; /* read position of the first cell of the column */
+		gssw_v* vCol = (gssw_v*)mH + i*segLen;
+
+		/* Swap the 2 H and the 2 E buffers. */
+		gssw_v* pv = pvHLoad;
+		pvHLoad = pvHStore;
+		pvHStore = pv;
+		pv = pvELoad;
+		pvELoad = pvEStore;
+		pvEStore = pv;
+
+		if (UNLIKELY(lo >= readLen || lo + bandW <= 0)) {
+			/* the band has left the read (or not reached it yet), no cell to score */
+			memset(pvHStore, 0, segLen*sizeof(gssw_v));
+			memset(pvEStore, 0, segLen*sizeof(gssw_v));
+			memset(vCol,     0, segLen*sizeof(gssw_v));
+			continue;
+		}
+
+		/* scores of the column, read straight from the padded profile unless the band hangs off its ends */
+		const int16_t* pP = profile + ref[i] * rowLen + GSSW_BAND_PAD + lo;
+		if (UNLIKELY(lo < -GSSW_BAND_PAD || lo + bandW > readLen + GSSW_BAND_PAD)) {
+			for (k = 0; k < bandW; ++k) {
+				j = lo + k;
+				pTemp[k] = (j < 0 || j >= readLen) ? INT16_MIN : profile[ref[i] * rowLen + GSSW_BAND_PAD + j];
+			}
+			pP = pTemp;
+		}
+
+		gssw_v vF = vZero; /* its top lane is the F entering the next vector */
+		gssw_v vMaxColumn = vZero;
+
+		for (j = 0; LIKELY(j < segLen); ++j) {
+			gssw_v vH = vadds16(vload(pvHLoad + j), vloadu((const gssw_v*)(pP + j*GSSW_LANES16)));
+			gssw_v e = vloadu((const gssw_v*)((const int16_t*)pvELoad + j*GSSW_LANES16 + 1));
+			vH = vmax16(vH, e);
+
+			/* F from the cells above: the previous lane, or the carry, opened, then extended over the lanes */
+			gssw_v f = vshl16c(vsubs16u(vH, vGapO), vF);
+			for (k = 1, s = 0; k < GSSW_LANES16; k <<= 1, ++s) {
+				f = vmax16(f, vsubs16u(vshlb(f, k * 2), vFDecay[s]));
+			}
+			vH = vmax16(vH, f);
+			vMaxColumn = vmax16(vMaxColumn, vH);
+			vstore(pvHStore + j, vH);
+			vstore(vCol + j, vH);
+
+			vH = vsubs16u(vH, vGapO);
+			vF = vmax16(vsubs16u(f, vGapE), vH);
+			vstore(pvEStore + j, vmax16(vsubs16u(e, vGapE), vH));
+		}
+
+		int32_t temp = vhmax16(vMaxColumn);
+		if (temp > max) {
+			max = temp;
+			end_ref = i;
+			if (max == INT16_MAX) break;	//overflow, saturated
+			/* first read position of the column with the max; the lanes past the read never reach it */
+			const uint16_t* t = (const uint16_t*)pvHStore;
+			for (k = lo < 0 ? -lo : 0; LIKELY(k < bandW && lo + k < readLen); ++k) {
+				if (t[k] == max) {
+					end_read = lo + k;
+					break;
+				}
+			}
+		}
+	}
+
+    memcpy(alignment->seed.pvE,      pvEStore, bytes);
+    memcpy(alignment->seed.pvHStore, pvHStore, bytes);
+
+	free(pvScratch);
+
+	gssw_alignment_end* bests = (gssw_alignment_end*) calloc(2, sizeof(gssw_alignment_end));
+	if (UNLIKELY(!bests)) return NULL;
+	bests[0].score = max;
+	bests[0].ref = end_ref;
+	bests[0].read = end_read;
+
+	return bests;
+}
+
+/* Inter-sequence (batch) kernels: one read per lane instead of one read striped across the lanes.
+   Lane k holds read k, vector j holds read position j of every read, so the vertical (F) dependency
+   is resolved exactly in the sequential loop over j and no Lazy-F correction is needed.  The H matrix
+   is stored as it is computed, one vector per cell: read k's cell (i, j) is byte/word k of vector
+   i*maxLen + j.  Reads shorter than maxLen are padded with the lowest score. */
+
+GSSW_TARGET
+void* GSSW_FN(gssw_qP_batch, byte) (const int8_t** reads,
+                                     const int32_t* readLens,
+                                     const int32_t count,	/* reads in the batch, <= lanes */
+                                     const int32_t maxLen,
+                                     const int8_t* mat,
+                                     const int32_t n,
+                                     uint8_t bias) {
+
+	gssw_v* vProfile = (gssw_v*)gssw_aligned_malloc(n * maxLen * sizeof(gssw_v), sizeof(gssw_v));
+	if (UNLIKELY(!vProfile)) return NULL;
+	uint8_t* t = (uint8_t*)vProfile;
+	int32_t nt, j, k;
+
+	for (nt = 0; LIKELY(nt < n); nt ++) {
+		for (j = 0; j < maxLen; j ++) {
+			for (k = 0; LIKELY(k < GSSW_LANES8); k ++) {
+				*t++ = k < count && j < readLens[k] ? mat[nt * n + reads[k][j]] + bias : 0;
+			}
+		}
+	}
+	return vProfile;
+}
+
+GSSW_TARGET
+void* GSSW_FN(gssw_qP_batch, word) (const int8_t** reads,
+                                     const int32_t* readLens,
+                                     const int32_t count,	/* reads in the batch, <= lanes */
+                                     const int32_t maxLen,
+                                     const int8_t* mat,
+                                     const int32_t n) {
+
+	gssw_v* vProfile = (gssw_v*)gssw_aligned_malloc(n * maxLen * sizeof(gssw_v), sizeof(gssw_v));
+	if (UNLIKELY(!vProfile)) return NULL;
+	int16_t* t = (int16_t*)vProfile;
+	int32_t nt, j, k;
+
+	for (nt = 0; LIKELY(nt < n); nt ++) {
+		for (j = 0; j < maxLen; j ++) {
+			for (k = 0; LIKELY(k < GSSW_LANES16); k ++) {
+				*t++ = k < count && j < readLens[k] ? mat[nt * n + reads[k][j]] : INT16_MIN / 2;
+			}
+		}
+	}
+	return vProfile;
+}
+
+/* Returns one gssw_alignment_end per lane; a lane scoring 255 has overflowed and the batch must be run
+   again with the word kernel.  Likewise a word lane scoring INT16_MAX has saturated.  NULL if the matrix
+   or the seed cannot be had. */
+GSSW_TARGET
+gssw_alignment_end* GSSW_FN(gssw_sw_batch, byte) (const int8_t* ref,
+                                                  int32_t refLen,
+                                                  const int32_t* readLens,
+                                                  const int32_t count,
+                                                  const int32_t maxLen,
+                                                  const uint8_t weight_gapO, /* will be used as - */
+                                                  const uint8_t weight_gapE, /* will be used as - */
+                                                  const void* profile,
+                                                  uint8_t bias,
+                                                  gssw_align* alignment, /* to save seed and matrix */
+                                                  const gssw_seed* seed) {   /* to seed the alignment */
+
+	const gssw_v* vProfile = (const gssw_v*)profile;
+	uint8_t max[GSSW_LANES8];
+	uint8_t maxScore[GSSW_LANES8] __attribute__((aligned(GSSW_VSIZE)));
+	int32_t i, j, k;
+	int8_t overflow = 0;
+
+	/* the seed buffers double as the rolling column, so they hold the last column when we are done; they and mH go
+	   with the alignment, also when the others cannot be had */
+	gssw_v* pvH = (gssw_v*)gssw_aligned_malloc(maxLen*sizeof(gssw_v), sizeof(gssw_v));
+	gssw_v* pvE = (gssw_v*)gssw_aligned_malloc(maxLen*sizeof(gssw_v), sizeof(gssw_v));
+	gssw_v* mH = (gssw_v*)gssw_matrix_alloc(NULL, (size_t)refLen*maxLen*sizeof(gssw_v), alignment);
+	alignment->seed.pvHStore = pvH;
+	alignment->seed.pvE = pvE;
+	alignment->mH = mH;
+	gssw_alignment_end* bests = (gssw_alignment_end*) calloc(GSSW_LANES8, sizeof(gssw_alignment_end));
+	if (UNLIKELY(!pvH || !pvE || !mH || !bests)) {
+		free(bests);
+		return NULL;
+	}
+	for (k = 0; k < GSSW_LANES8; ++k) {
+		max[k] = 0;
+		bests[k].ref = -1;
+		bests[k].read = k < count ? readLens[k] - 1 : 0;
+	}
+
+	if (seed) {
+		memcpy(pvH, seed->pvHStore, maxLen*sizeof(gssw_v));
+		memcpy(pvE, seed->pvE, maxLen*sizeof(gssw_v));
+	} else {
+		memset(pvH, 0, maxLen*sizeof(gssw_v));
+		memset(pvE, 0, maxLen*sizeof(gssw_v));
+	}
+	alignment->mH_stride = maxLen * GSSW_LANES8;
+	alignment->mH_seg = maxLen;
+	alignment->mH_lanes = GSSW_LANES8;
+	alignment->mH_lane = 0;
+	alignment->is_byte = 1;
+	alignment->score_width = 1;
+
+	gssw_v vZero = vzero();
+	gssw_v vGapO = vset8(weight_gapO);
+	gssw_v vGapE = vset8(weight_gapE);
+	gssw_v vBias = vset8(bias);
+	gssw_v vMaxScore = vZero; /* Trace the highest score of every lane. */
+	gssw_v vMaxMark = vZero;  /* The same till the previous column. */
+
+	for (i = 0; LIKELY(i < refLen); ++i) {
+		const gssw_v* vP = vProfile + ref[i] * maxLen;
+		gssw_v* vCol = mH + i * maxLen;
+		gssw_v vDiag = vZero, vF = vZero, vMaxColumn = vZero, vH, e;
+
+		for (j = 0; LIKELY(j < maxLen); ++j) {
+			vH = vsubs8u(vadds8u(vDiag, vload(vP + j)), vBias);
+			vDiag = vload(pvH + j);
+			e = vload(pvE + j);
+			vH = vmax8u(vH, e);
+			vH = vmax8u(vH, vF);
+			vMaxColumn = vmax8u(vMaxColumn, vH);
+			vstore(pvH + j, vH);
+			vstore(vCol + j, vH);
+
+			vH = vsubs8u(vH, vGapO);
+			e = vmax8u(vsubs8u(e, vGapE), vH);
+			vstore(pvE + j, e);
+			vF = vmax8u(vsubs8u(vF, vGapE), vH);
+		}
+
+		vMaxScore = vmax8u(vMaxScore, vMaxColumn);
+		if (!vequal(vMaxMark, vMaxScore)) {
+			vMaxMark = vMaxScore;
+			vstore((gssw_v*)maxScore, vMaxScore);
+			for (k = 0; k < count; ++k) {
+				if (maxScore[k] > max[k]) {
+					max[k] = maxScore[k];
+					bests[k].ref = i;
+					/* first read position reaching the new max */
+					for (j = 0; j < readLens[k] && ((uint8_t*)(vCol + j))[k] != max[k]; ++j);
+					if (j < readLens[k]) bests[k].read = j;
+					if (max[k] + bias >= 255) overflow = 1;
+				}
+			}
+			if (UNLIKELY(overflow)) break;
+		}
+	}
+
+	for (k = 0; k < count; ++k) {
+		bests[k].score = max[k] + bias >= 255 ? 255 : max[k];
+	}
+	return bests;
+}
+
+GSSW_TARGET
+gssw_alignment_end* GSSW_FN(gssw_sw_batch, word) (const int8_t* ref,
+                                                  int32_t refLen,
+                                                  const int32_t* readLens,
+                                                  const int32_t count,
+                                                  const int32_t maxLen,
+                                                  const uint8_t weight_gapO, /* will be used as - */
+                                                  const uint8_t weight_gapE, /* will be used as - */
+                                                  const void* profile,
+                                                  gssw_align* alignment, /* to save seed and matrix */
+                                                  const gssw_seed* seed) {   /* to seed the alignment */
+
+	const gssw_v* vProfile = (const gssw_v*)profile;
+	uint16_t max[GSSW_LANES16];
+	uint16_t maxScore[GSSW_LANES16] __attribute__((aligned(GSSW_VSIZE)));
+	int32_t i, j, k;
+	int8_t overflow = 0;
+
+	/* the seed buffers double as the rolling column, so they hold the last column when we are done; they and mH go
+	   with the alignment, also when the others cannot be had */
+	gssw_v* pvH = (gssw_v*)gssw_aligned_malloc(maxLen*sizeof(gssw_v), sizeof(gssw_v));
+	gssw_v* pvE = (gssw_v*)gssw_aligned_malloc(maxLen*sizeof(gssw_v), sizeof(gssw_v));
+	gssw_v* mH = (gssw_v*)gssw_matrix_alloc(NULL, (size_t)refLen*maxLen*sizeof(gssw_v), alignment);
+	alignment->seed.pvHStore = pvH;
+	alignment->seed.pvE = pvE;
+	alignment->mH = mH;
+	gssw_alignment_end* bests = (gssw_alignment_end*) calloc(GSSW_LANES16, sizeof(gssw_alignment_end));
+	if (UNLIKELY(!pvH || !pvE || !mH || !bests)) {
+		free(bests);
+		return NULL;
+	}
+	for (k = 0; k < GSSW_LANES16; ++k) {
+		max[k] = 0;
+		bests[k].ref = -1;
+		bests[k].read = k < count ? readLens[k] - 1 : 0;
+	}
+
+	if (seed) {
+		memcpy(pvH, seed->pvHStore, maxLen*sizeof(gssw_v));
+		memcpy(pvE, seed->pvE, maxLen*sizeof(gssw_v));
+	} else {
+		memset(pvH, 0, maxLen*sizeof(gssw_v));
+		memset(pvE, 0, maxLen*sizeof(gssw_v));
+	}
+	alignment->mH_stride = maxLen * GSSW_LANES16;
+	alignment->mH_seg = maxLen;
+	alignment->mH_lanes = GSSW_LANES16;
+	alignment->mH_lane = 0;
+	alignment->is_byte = 0;
+	alignment->score_width = 2;
+
+	gssw_v vZero = vzero();
+	gssw_v vGapO = vset16(weight_gapO);
+	gssw_v vGapE = vset16(weight_gapE);
+	gssw_v vMaxScore = vZero; /* Trace the highest score of every lane. */
+	gssw_v vMaxMark = vZero;  /* The same till the previous column. */
+
+	for (i = 0; LIKELY(i < refLen); ++i) {
+		const gssw_v* vP = vProfile + ref[i] * maxLen;
+		gssw_v* vCol = mH + i * maxLen;
+		gssw_v vDiag = vZero, vF = vZero, vMaxColumn = vZero, vH, e;
+
+		for (j = 0; LIKELY(j < maxLen); ++j) {
+			vH = vadds16(vDiag, vload(vP + j));
+			vDiag = vload(pvH + j);
+			e = vload(pvE + j);
+			vH = vmax16(vH, e);
+			vH = vmax16(vH, vF);
+			vMaxColumn = vmax16(vMaxColumn, vH);
+			vstore(pvH + j, vH);
+			vstore(vCol + j, vH);
+
+			vH = vsubs16u(vH, vGapO);
+			e = vmax16(vsubs16u(e, vGapE), vH);
+			vstore(pvE + j, e);
+			vF = vmax16(vsubs16u(vF, vGapE), vH);
+		}
+
+		vMaxScore = vmax16(vMaxScore, vMaxColumn);
+		if (!vequal(vMaxMark, vMaxScore)) {
+			vMaxMark = vMaxScore;
+			vstore((gssw_v*)maxScore, vMaxScore);
+			for (k = 0; k < count; ++k) {
+				if (maxScore[k] > max[k]) {
+					max[k] = maxScore[k];
+					bests[k].ref = i;
+					/* first read position reaching the new max */
+					for (j = 0; j < readLens[k] && ((uint16_t*)(vCol + j))[k] != max[k]; ++j);
+					if (j < readLens[k]) bests[k].read = j;
+					if (max[k] == INT16_MAX) overflow = 1;
+				}
+			}
+			if (UNLIKELY(overflow)) break;
+		}
+	}
+
+	for (k = 0; k < count; ++k) {
+		bests[k].score = max[k];
+	}
+	return bests;
+}
+
+/* consume the instruction set macros, gssw.c defines them afresh for the next one */
+#undef GSSW_DIR_MASK
+#undef GSSW_PACK_BYTES
+#undef GSSW_LANES8
+#undef GSSW_LANES16
+#undef GSSW_LANES32
+#undef GSSW_ISA
+#undef GSSW_TARGET
+#undef GSSW_VSIZE
+#undef gssw_v
+#undef vzero
+#undef vset8
+#undef vset16
+#undef vload
+#undef vloadu
+#undef vstore
+#undef vadds8u
+#undef vsubs8u
+#undef vmax8u
+#undef vadds16
+#undef vsubs16u
+#undef vmax16
+#undef vmax16u
+#undef vset32
+#undef vadd32
+#undef vadd8
+#undef vadd16
+#undef vsub8
+#undef vsub16
+#undef vsub32
+#undef vsll16
+#undef vsrl16
+#undef vsll32
+#undef vsrl32
+#undef vsubs32u
+#undef vmax32
+#undef vand
+#undef vor
+#undef vxor
+#undef vandnot
+#undef vcmpeq8
+#undef vcmpeq16
+#undef vcmpeq32
+#undef vcmpgt16
+#undef vcmpgt32
+#undef vmovemask
+#undef vshl8
+#undef vshl16
+#undef vshl32
+#undef vshl16c
+#undef vshlb
+#undef vequal
+#undef vanygt8u
+#undef vanygt16
+#undef vanygt32
+#undef vhmax8u
+#undef vhmax16
+#undef vhmax32
@@ -0,0 +1,472 @@
+/*	test.c
+ *	Checks the fills and tracebacks of the library against a brute-force affine gap Smith-Waterman over the graph,
+ *	for every SIMD tier the CPU supports, both vertical gap corrections and every matrix mode: the best score, the
+ *	second best, and that the mappings follow the edges, consume the read and score what they report.
+ *	To run it: make test
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "gssw.h"
+
+#define MASK_LEN 15	// the smallest maskLen for which the fills track the second best
+#define MAX_REPORTS 20
+
+typedef struct {
+    int32_t match, mismatch, gapO, gapE;
+} scoring;
+
+/* the last one overflows 16-bit scores on the long cases */
+static const scoring scorings[] = {{2, 2, 3, 1}, {1, 4, 6, 1}, {5, 3, 5, 2}, {120, 60, 120, 20}};
+
+static const int8_t matrix_modes[] = {GSSW_MATRIX_H, GSSW_MATRIX_DIR, GSSW_MATRIX_CKPT, GSSW_MATRIX_DELTA};
+static const char* matrix_names[] = {"H", "DIR", "CKPT", "DELTA"};
+
+static uint64_t rng_state = 88172645463325252ULL;
+static int32_t checks, failures;
+static char config[64];
+
+static uint32_t rnd (void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (uint32_t)(rng_state >> 11);
+}
+
+static char rnd_base (void) {
+    return "ACGT"[rnd() % 4];
+}
+
+static void check (int ok, const char* path, int32_t t, const char* what, int64_t got, int64_t want) {
+    ++checks;
+    if (ok) return;
+    if (failures++ < MAX_REPORTS)
+        fprintf(stderr, "FAIL %s %s case %d: %s (got %lld, want %lld)\n", config, path, t, what, (long long)got, (long long)want);
+}
+
+/* A random DAG of n nodes in topological order, node i having id i: every node but the first has an edge from the
+   one before it (chain) or from a random earlier node, and sometimes a second one. */
+static gssw_graph* random_graph (gssw_node** nodes, int32_t n, int32_t max_len, int chain, const int8_t* nt, const int8_t* mat) {
+    gssw_graph* graph = gssw_graph_create(n);
+    char* seq = (char*)malloc(max_len + 1);
+    int32_t i, k, len;
+    for (i = 0; i < n; ++i) {
+        len = 1 + rnd() % max_len;
+        for (k = 0; k < len; ++k) seq[k] = rnd_base();
+        seq[len] = 0;
+        nodes[i] = gssw_node_create(NULL, i, seq, nt, mat);
+        gssw_graph_add_node(graph, nodes[i]);
+        if (i == 0) continue;
+        gssw_nodes_add_edge(nodes[chain ? i - 1 : rnd() % i], nodes[i]);
+        if (i > 1 && rnd() % 2) gssw_nodes_add_edge(nodes[rnd() % (i - 1)], nodes[i]);
+    }
+    free(seq);
+    return graph;
+}
+
+/* A read of len bases along a random walk of the graph from a random node, with substitutions, insertions and
+   deletions, jumping to a random node at the sinks. */
+static char* random_read (gssw_node** nodes, int32_t n, int32_t len) {
+    char* read = (char*)malloc(len + 1);
+    gssw_node* node = nodes[rnd() % n];
+    int32_t j = 0, i = rnd() % node->len;
+    uint32_t x;
+    while (j < len) {
+        x = rnd() % 24;
+        if (x == 0) read[j++] = rnd_base(), ++i;	// substitution
+        else if (x == 1) ++i;	// deletion
+        else if (x == 2) read[j++] = rnd_base();	// insertion
+        else read[j++] = node->seq[i++];
+        if (i >= node->len) {
+            node = node->count_next ? node->next[rnd() % node->count_next] : nodes[rnd() % n];
+            i = 0;
+        }
+    }
+    read[len] = 0;
+    return read;
+}
+
+/* Best score of the read (as numbers) against the n nodes in topological order, cell by cell: H the best score
+   ending in a cell, E that of those ending in a deletion (a gap along the reference), F in an insertion (down the
+   column), all floored at 0; the last column of H and E is carried over the edges, taking the best of the
+   predecessors.  colmax[i][c] gets the best H of column c of node i. */
+static int32_t brute_fill (gssw_node** nodes, int32_t n, const int8_t* num, int32_t readLen, const int8_t* mat,
+                           int32_t gapO, int32_t gapE, int32_t** colmax) {
+    int32_t** lastH = (int32_t**)calloc(n, sizeof(int32_t*));
+    int32_t** lastE = (int32_t**)calloc(n, sizeof(int32_t*));
+    int32_t* H = (int32_t*)malloc(readLen * sizeof(int32_t));
+    int32_t* Hp = (int32_t*)malloc(readLen * sizeof(int32_t));
+    int32_t* E = (int32_t*)malloc(readLen * sizeof(int32_t));
+    int32_t best = 0, u, k, i, j, p, h, F;
+    for (u = 0; u < n; ++u) {
+        gssw_node* node = nodes[u];
+        memset(Hp, 0, readLen * sizeof(int32_t));
+        memset(E, 0, readLen * sizeof(int32_t));
+        for (k = 0; k < node->count_prev; ++k) {
+            p = node->prev[k]->id;
+            for (j = 0; j < readLen; ++j) {
+                if (lastH[p][j] > Hp[j]) Hp[j] = lastH[p][j];
+                if (lastE[p][j] > E[j]) E[j] = lastE[p][j];
+            }
+        }
+        for (i = 0; i < node->len; ++i) {
+            colmax[u][i] = 0;
+            F = 0;
+            for (j = 0; j < readLen; ++j) {
+                h = (j ? Hp[j - 1] : 0) + mat[node->num[i] * 5 + num[j]];
+                if (E[j] > h) h = E[j];
+                if (F > h) h = F;
+                if (h < 0) h = 0;
+                H[j] = h;
+                if (h > best) best = h;
+                if (h > colmax[u][i]) colmax[u][i] = h;
+                E[j] = E[j] - gapE > h - gapO ? E[j] - gapE : h - gapO;
+                if (E[j] < 0) E[j] = 0;
+                F = F - gapE > h - gapO ? F - gapE : h - gapO;
+                if (F < 0) F = 0;
+            }
+            memcpy(Hp, H, readLen * sizeof(int32_t));
+        }
+        lastH[u] = (int32_t*)malloc(readLen * sizeof(int32_t));
+        lastE[u] = (int32_t*)malloc(readLen * sizeof(int32_t));
+        memcpy(lastH[u], Hp, readLen * sizeof(int32_t));
+        memcpy(lastE[u], E, readLen * sizeof(int32_t));
+    }
+    for (u = 0; u < n; ++u) {
+        free(lastH[u]);
+        free(lastE[u]);
+    }
+    free(lastH); free(lastE); free(H); free(Hp); free(E);
+    return best;
+}
+
+/* Second best score given where the best alignment ends: the best column more than MASK_LEN reference positions
+   from that end along the edges in either direction, the distances being those of the shortest paths. */
+static int32_t brute_second_best (gssw_node** nodes, int32_t n, int32_t** colmax, int32_t best_node, int32_t best_ref) {
+    int32_t** ahead = (int32_t**)malloc(n * sizeof(int32_t*));
+    int32_t** behind = (int32_t**)malloc(n * sizeof(int32_t*));
+    int32_t second = 0, u, c, k, len;
+    for (u = 0; u < n; ++u) {
+        ahead[u] = (int32_t*)malloc(nodes[u]->len * sizeof(int32_t));
+        behind[u] = (int32_t*)malloc(nodes[u]->len * sizeof(int32_t));
+        for (c = 0; c < nodes[u]->len; ++c) ahead[u][c] = behind[u][c] = 1 << 29;
+    }
+    ahead[best_node][best_ref] = behind[best_node][best_ref] = 0;
+    for (u = best_node; u < n; ++u) {
+        for (k = 0; k < nodes[u]->count_prev; ++k) {
+            gssw_node* p = nodes[u]->prev[k];
+            if (ahead[p->id][p->len - 1] + 1 < ahead[u][0]) ahead[u][0] = ahead[p->id][p->len - 1] + 1;
+        }
+        for (c = 1; c < nodes[u]->len; ++c)
+            if (ahead[u][c - 1] + 1 < ahead[u][c]) ahead[u][c] = ahead[u][c - 1] + 1;
+    }
+    for (u = best_node; u >= 0; --u) {
+        len = nodes[u]->len;
+        for (k = 0; k < nodes[u]->count_next; ++k) {
+            gssw_node* x = nodes[u]->next[k];
+            if (behind[x->id][0] + 1 < behind[u][len - 1]) behind[u][len - 1] = behind[x->id][0] + 1;
+        }
+        for (c = len - 2; c >= 0; --c)
+            if (behind[u][c + 1] + 1 < behind[u][c]) behind[u][c] = behind[u][c + 1] + 1;
+    }
+    for (u = 0; u < n; ++u) {
+        for (c = 0; c < nodes[u]->len; ++c)
+            if (ahead[u][c] > MASK_LEN && behind[u][c] > MASK_LEN && colmax[u][c] > second) second = colmax[u][c];
+        free(ahead[u]);
+        free(behind[u]);
+    }
+    free(ahead);
+    free(behind);
+    return second;
+}
+
+/* What is wrong with mapping m of the read, 0 if nothing: its nodes have to follow the edges, each node but the
+   last to be left at its end and each but the first entered at its start, and the whole read has to be consumed.
+   If exact, the operations also have to score m->score (a gap opening where the operation changes, across nodes
+   too): only the traceback over direction bits is, the one over H may take a gap for a run of mismatches. */
+static const char* mapping_error (const gssw_graph_mapping* m, const int8_t* num, int32_t readLen, const int8_t* mat,
+                                  int32_t gapO, int32_t gapE, int exact) {
+    int32_t score = 0, i = 0, j = 0, c, e, k;
+    uint32_t x;
+    char last = 0, type;
+    if (!m) return "no mapping";
+    for (c = 0; c < (int32_t)m->cigar.length; ++c) {
+        const gssw_node* node = m->cigar.elements[c].node;
+        const gssw_cigar* cigar = m->cigar.elements[c].cigar;
+        if (c > 0) {
+            const gssw_node* prev = m->cigar.elements[c - 1].node;
+            if (i != prev->len) return "a node is left before its end";
+            for (k = 0; k < prev->count_next && prev->next[k] != node; ++k);
+            if (k == prev->count_next) return "consecutive nodes have no edge";
+        }
+        i = c ? 0 : m->position;
+        for (e = 0; e < cigar->length; ++e) {
+            type = cigar->elements[e].type;
+            for (x = 0; x < cigar->elements[e].length; ++x) {
+                switch (type) {
+                case 'M':
+                    if (i >= node->len || j >= readLen) return "a match runs past the node or the read";
+                    score += mat[node->num[i++] * 5 + num[j++]];
+                    break;
+                case 'I':
+                    if (j >= readLen) return "an insertion runs past the read";
+                    score -= last == 'I' ? gapE : gapO;
+                    ++j;
+                    break;
+                case 'D':
+                    if (i >= node->len) return "a deletion runs past the node";
+                    score -= last == 'D' ? gapE : gapO;
+                    ++i;
+                    break;
+                case 'S':
+                    ++j;
+                    break;
+                default:
+                    return "unknown cigar operation";
+                }
+                last = type;
+            }
+        }
+    }
+    if (j != readLen) return "the read is not consumed";
+    if (exact && score != m->score) return "the cigar does not score the mapping";
+    return 0;
+}
+
+static void check_mapping (const char* path, int32_t t, const gssw_graph_mapping* m, int32_t best, const int8_t* num,
+                           int32_t readLen, const int8_t* mat, const scoring* s, int8_t mode) {
+    const char* error = mapping_error(m, num, readLen, mat, s->gapO, s->gapE, mode == GSSW_MATRIX_DIR);
+    check(!error, path, t, error ? error : "", m ? m->score : -1, best);
+    if (m) check(m->score == best, path, t, "mapping score", m->score, best);
+}
+
+/* A graph and read of case t, checked through every fill and traceback path under the settings in effect. */
+static void check_case (int32_t t, const int8_t* nt, gssw_workspace* ws) {
+    int is_long = t % 8 == 7;
+    const scoring* s = &scorings[is_long ? 3 : t % 3];
+    int8_t* mat = gssw_create_score_matrix(s->match, s->mismatch);
+    int32_t n = is_long ? 8 : 1 + rnd() % 10;
+    int32_t readLen = is_long ? 900 : 10 + rnd() % 150;
+    gssw_node** nodes = (gssw_node**)malloc(n * sizeof(gssw_node*));
+    int32_t** colmax = (int32_t**)malloc(n * sizeof(int32_t*));
+    gssw_graph* graph = random_graph(nodes, n, is_long ? 200 : 24, is_long || rnd() % 2, nt, mat);
+    char* read = random_read(nodes, n, readLen);
+    int8_t* num = gssw_create_num(read, readLen, nt);
+    int32_t best, second, i, k;
+    int8_t mode;
+    gssw_graph_mapping* m;
+    gssw_node* tmp;
+
+    for (i = 0; i < n; ++i) colmax[i] = (int32_t*)malloc(nodes[i]->len * sizeof(int32_t));
+    best = brute_fill(nodes, n, num, readLen, mat, s->gapO, s->gapE, colmax);
+
+    /* gssw_graph_fill, with the second best */
+    if (gssw_graph_fill(graph, read, nt, mat, s->gapO, s->gapE, MASK_LEN, 2)) {
+        check(graph->max_node->alignment->score1 == best, "fill", t, "score", graph->max_node->alignment->score1, best);
+        second = brute_second_best(nodes, n, colmax, graph->max_node->id, graph->max_node->alignment->ref_end1);
+        check(graph->second_best.end.score == (uint32_t)second, "fill", t, "second best", graph->second_best.end.score, second);
+        m = gssw_graph_trace_back(graph, read, readLen, s->match, s->mismatch, s->gapO, s->gapE);
+        check_mapping("fill", t, m, best, num, readLen, mat, s, gssw_matrix_get());
+        if (m) check(m->score2 == second, "fill", t, "mapping second best", m->score2, second);
+        gssw_graph_mapping_destroy(m);
+    } else check(0, "fill", t, "no fill", 0, 1);
+
+    /* gssw_graph_fill_parallel */
+    if (gssw_graph_fill_parallel(graph, read, nt, mat, s->gapO, s->gapE, MASK_LEN, 2, 4)) {
+        check(graph->max_node->alignment->score1 == best, "parallel", t, "score", graph->max_node->alignment->score1, best);
+        second = brute_second_best(nodes, n, colmax, graph->max_node->id, graph->max_node->alignment->ref_end1);
+        check(graph->second_best.end.score == (uint32_t)second, "parallel", t, "second best", graph->second_best.end.score, second);
+        m = gssw_graph_trace_back(graph, read, readLen, s->match, s->mismatch, s->gapO, s->gapE);
+        check_mapping("parallel", t, m, best, num, readLen, mat, s, gssw_matrix_get());
+        gssw_graph_mapping_destroy(m);
+    } else check(0, "parallel", t, "no fill", 0, 1);
+
+    /* gssw_graph_fill_ws */
+    if (gssw_graph_fill_ws(graph, read, nt, mat, s->gapO, s->gapE, MASK_LEN, 2, -1, ws)) {
+        m = gssw_graph_trace_back(graph, read, readLen, s->match, s->mismatch, s->gapO, s->gapE);
+        check_mapping("ws", t, m, best, num, readLen, mat, s, gssw_matrix_get());
+        gssw_graph_mapping_destroy(m);
+    } else check(0, "ws", t, "no fill", 0, 1);
+
+    /* gssw_graph_fill_cone */
+    if (gssw_graph_fill_cone(graph, read, nt, mat, s->gapO, s->gapE, MASK_LEN, 2)) {
+        m = gssw_graph_trace_back(graph, read, readLen, s->match, s->mismatch, s->gapO, s->gapE);
+        check_mapping("cone", t, m, best, num, readLen, mat, s, gssw_matrix_get());
+        gssw_graph_mapping_destroy(m);
+    } else check(0, "cone", t, "no fill", 0, 1);
+
+    /* gssw_graph_fill_score */
+    if (gssw_graph_fill_score(graph, read, nt, mat, s->gapO, s->gapE, 2))
+        check(graph->max_node->alignment->score1 == best, "score", t, "score", graph->max_node->alignment->score1, best);
+    else check(0, "score", t, "no fill", 0, 1);
+
+    /* contexts, of the graph and compiled, with the next matrix mode to the one in effect */
+    for (k = 0; k < 2; ++k) {
+        const char* path = k ? "compiled" : "ctx";
+        gssw_graph_compiled* cg = k ? gssw_graph_compile(graph) : NULL;
+        gssw_graph_context* ctx = k ? (cg ? gssw_graph_context_compiled(cg) : NULL) : gssw_graph_context_create(graph);
+        if (!ctx) {
+            check(0, path, t, "no context", 0, 1);
+            continue;
+        }
+        mode = gssw_graph_context_matrix_set(ctx, matrix_modes[(gssw_matrix_get() + 1) % 4]);
+        if (gssw_graph_fill_context(ctx, read, nt, mat, s->gapO, s->gapE, MASK_LEN, 2)) {
+            gssw_node* bn = gssw_graph_context_best(ctx);
+            const gssw_align* a = gssw_graph_context_alignment(ctx, bn);
+            check(a->score1 == best, path, t, "score", a->score1, best);
+            second = brute_second_best(nodes, n, colmax, bn->id, a->ref_end1);
+            m = gssw_graph_trace_back_context(ctx, read, readLen, s->match, s->mismatch, s->gapO, s->gapE);
+            check_mapping(path, t, m, best, num, readLen, mat, s, mode);
+            if (m) check(m->score2 == second, path, t, "mapping second best", m->score2, second);
+            gssw_graph_mapping_destroy(m);
+        } else check(0, path, t, "no fill", 0, 1);
+        gssw_graph_context_destroy(ctx);
+        if (cg) gssw_graph_compiled_destroy(cg);
+    }
+
+    /* gssw_graph_normalize, the mapping put back on the source graph */
+    {
+        gssw_graph_normalized* gn = gssw_graph_normalize(graph, 7, nt, mat);
+        if (gssw_graph_fill(gn->graph, read, nt, mat, s->gapO, s->gapE, MASK_LEN, 2)) {
+            gssw_graph_mapping* nm = gssw_graph_trace_back(gn->graph, read, readLen, s->match, s->mismatch, s->gapO, s->gapE);
+            m = nm ? gssw_graph_mapping_denormalize(gn, nm) : NULL;
+            check_mapping("normalize", t, m, best, num, readLen, mat, s, gssw_matrix_get());
+            gssw_graph_mapping_destroy(m);
+            gssw_graph_mapping_destroy(nm);
+        } else check(0, "normalize", t, "no fill", 0, 1);
+        gssw_graph_normalized_destroy(gn);
+    }
+
+    /* gssw_graph_sort of the nodes shuffled */
+    for (i = n - 1; i > 0; --i) {
+        k = rnd() % (i + 1);
+        tmp = graph->nodes[i];
+        graph->nodes[i] = graph->nodes[k];
+        graph->nodes[k] = tmp;
+    }
+    if (gssw_graph_sort(graph) == 0 && gssw_graph_fill(graph, read, nt, mat, s->gapO, s->gapE, MASK_LEN, 2)) {
+        m = gssw_graph_trace_back(graph, read, readLen, s->match, s->mismatch, s->gapO, s->gapE);
+        check_mapping("sort", t, m, best, num, readLen, mat, s, gssw_matrix_get());
+        gssw_graph_mapping_destroy(m);
+    } else check(0, "sort", t, "no fill", 0, 1);
+
+    for (i = 0; i < n; ++i) free(colmax[i]);
+    free(colmax);
+    gssw_graph_destroy(graph);
+    free(nodes); free(read); free(num); free(mat);
+}
+
+/* Reads aligned in batches against a graph, each checked against the brute force. */
+static void check_batch (int32_t t, const int8_t* nt) {
+    const scoring* s = &scorings[t % 3];
+    int8_t* mat = gssw_create_score_matrix(s->match, s->mismatch);
+    int32_t n = 1 + rnd() % 10, count = 70, r, i, best;
+    gssw_node** nodes = (gssw_node**)malloc(n * sizeof(gssw_node*));
+    int32_t** colmax = (int32_t**)malloc(n * sizeof(int32_t*));
+    gssw_graph* graph = random_graph(nodes, n, 24, rnd() % 2, nt, mat);
+    char** reads = (char**)malloc(count * sizeof(char*));
+    int32_t* lens = (int32_t*)malloc(count * sizeof(int32_t));
+    gssw_graph_mapping** ms;
+
+    for (i = 0; i < n; ++i) colmax[i] = (int32_t*)malloc(nodes[i]->len * sizeof(int32_t));
+    for (r = 0; r < count; ++r) {
+        lens[r] = 5 + rnd() % 100;
+        reads[r] = random_read(nodes, n, lens[r]);
+    }
+    ms = gssw_graph_align_batch(graph, (const char**)reads, count, nt, mat, s->match, s->mismatch, s->gapO, s->gapE);
+    for (r = 0; r < count; ++r) {
+        int8_t* num = gssw_create_num(reads[r], lens[r], nt);
+        best = brute_fill(nodes, n, num, lens[r], mat, s->gapO, s->gapE, colmax);
+        check_mapping("batch", t * 1000 + r, ms ? ms[r] : NULL, best, num, lens[r], mat, s, GSSW_MATRIX_H);
+        if (ms) gssw_graph_mapping_destroy(ms[r]);
+        free(num);
+        free(reads[r]);
+    }
+    free(ms);
+    for (i = 0; i < n; ++i) free(colmax[i]);
+    free(colmax);
+    gssw_graph_destroy(graph);
+    free(nodes); free(reads); free(lens); free(mat);
+}
+
+/* gssw_ssw_align of a read against a linear reference: the best score, and the cigar from the beginnings to the ends
+   scoring it. */
+static void check_ssw (int32_t t, const int8_t* nt) {
+    const scoring* s = &scorings[t % 3];
+    int8_t* mat = gssw_create_score_matrix(s->match, s->mismatch);
+    int32_t refLen = 50 + rnd() % 400, readLen = 10 + rnd() % 150, best, i, j, e;
+    uint32_t x;
+    int32_t score = 0;
+    gssw_node* node;
+    gssw_node** nodes = &node;
+    int32_t* colmax;
+    char* ref = (char*)malloc(refLen + 1);
+    char* read;
+    int8_t* num;
+    gssw_profile* prof;
+    gssw_align* a;
+
+    for (i = 0; i < refLen; ++i) ref[i] = rnd_base();
+    ref[refLen] = 0;
+    node = gssw_node_create(NULL, 0, ref, nt, mat);
+    read = random_read(nodes, 1, readLen);
+    num = gssw_create_num(read, readLen, nt);
+    colmax = (int32_t*)malloc(refLen * sizeof(int32_t));
+    best = brute_fill(nodes, 1, num, readLen, mat, s->gapO, s->gapE, &colmax);
+
+    prof = gssw_init(num, readLen, mat, 5, 2);
+    a = gssw_ssw_align(prof, node->num, refLen, s->gapO, s->gapE, 1, 0, 0, MASK_LEN);
+    check(a && a->score1 == (uint32_t)best, "ssw_align", t, "score", a ? a->score1 : -1, best);
+    if (a && a->cigar && a->ref_begin1 >= 0 && a->read_begin1 >= 0) {
+        i = a->ref_begin1;
+        j = a->read_begin1;
+        for (e = 0; e < a->cigarLen; ++e) {
+            for (x = 0; x < a->cigar[e] >> 4; ++x) {
+                switch (a->cigar[e] & 0xf) {
+                case 0: score += mat[node->num[i++] * 5 + num[j++]]; break;
+                case 1: score -= x ? s->gapE : s->gapO; ++j; break;
+                case 2: score -= x ? s->gapE : s->gapO; ++i; break;
+                }
+            }
+        }
+        check(score == best, "ssw_align", t, "cigar score", score, best);
+        check(i - 1 == a->ref_end1 && j - 1 == a->read_end1, "ssw_align", t, "cigar end", i - 1, a->ref_end1);
+    } else check(0, "ssw_align", t, "no cigar", 0, 1);
+
+    gssw_align_destroy(a);
+    gssw_init_destroy(prof);
+    gssw_node_destroy(node);
+    free(colmax); free(ref); free(read); free(num); free(mat);
+}
+
+int main (int argc, char * const argv[]) {
+    int32_t cases = argc > 1 ? atoi(argv[1]) : 24, t, m, f;
+    int8_t top = gssw_simd_set(GSSW_SIMD_AUTO), level;
+    int8_t* nt = gssw_create_nt_table();
+    gssw_workspace* ws = gssw_workspace_create();
+
+    gssw_checkpoint_set(3);
+    for (level = GSSW_SIMD_SSE41; level <= top; ++level) {
+        if (gssw_simd_set(level) != level) continue;
+        for (f = GSSW_FCORR_SCAN; f <= GSSW_FCORR_LAZY; ++f) {
+            gssw_fcorr_set(f);
+            for (m = 0; m < 4; ++m) {
+                int32_t before = failures;
+                gssw_matrix_set(matrix_modes[m]);
+                snprintf(config, sizeof(config), "%s/%s/%s", gssw_simd_name(level), f == GSSW_FCORR_LAZY ? "lazy" : "scan",
+                         matrix_names[m]);
+                for (t = 0; t < cases; ++t) check_case(t, nt, ws);
+                for (t = 0; t < cases / 4; ++t) check_batch(t, nt);
+                for (t = 0; t < cases; ++t) check_ssw(t, nt);
+                fprintf(stdout, "%-24s %s\n", config, failures == before ? "ok" : "FAILED");
+            }
+        }
+    }
+    fprintf(stdout, "%d checks, %d failures\n", checks, failures);
+
+    gssw_workspace_destroy(ws);
+    free(nt);
+    return failures ? 1 : 0;
+}